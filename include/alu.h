@@ -6,9 +6,10 @@
 #include <stdexcept>
 
 #include "constants.h"
+#include "nativealu.hpp"
 
 /**
- * @class ALU
+ * @class GateLevelALU
  * @brief A class representing an Arithmetic Logic Unit (ALU) with various
  * bitwise and arithmetic operations.
  * @details
@@ -34,7 +35,7 @@
  * not entirely clear to me how this should be modelled, but right now
  * it is a boolean check.
  */
-class ALU {
+class GateLevelALU {
 public:
   /**
    * @name Constructors and Destructors
@@ -42,14 +43,14 @@ public:
    */
 
   /**
-   * @brief Default constructor for the ALU class.
+   * @brief Default constructor for the GateLevelALU class.
    */
-  ALU() {}
+  GateLevelALU() {}
 
   /**
-   * @brief Destructor for the ALU class.
+   * @brief Destructor for the GateLevelALU class.
    */
-  ~ALU() {}
+  ~GateLevelALU() {}
 
   /** @} */ // end of Constructors and Destructors
 
@@ -191,4 +192,18 @@ public:
   /** @} */ // end of Arithmetic Operations
 };
 
+/**
+ * @brief The ALU the instructions execute on, fixed at compile time.
+ * @details
+ * Defining RV32SIM_NATIVE_ALU (the CMake option of the same name) swaps the
+ * gate-level model for NativeALU, which has the same interface and results
+ * but computes directly on machine words. Both are used through static
+ * calls, so neither choice costs any dispatch at run time.
+ */
+#ifdef RV32SIM_NATIVE_ALU
+typedef NativeALU ALU;
+#else
+typedef GateLevelALU ALU;
+#endif
+
 #endif // ALU_H
\ No newline at end of file
@@ -0,0 +1,109 @@
+#ifndef AOTENGINE_H
+#define AOTENGINE_H
+
+#include "blockengine.h"
+#include "instructionfile.h"
+#include "memoryfile.h"
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+/// \brief The guest state that code generated by rv32sim_aot works on.
+struct AotState {
+  uint32_t x[32];
+  MemoryFile *p_memory;
+  // Instructions of the running block that completed. The engine sets it to
+  // the block length; a block that stops early lowers it.
+  unsigned int completed;
+  // Set when a store overwrites code, which ends the block after the store
+  bool code_modified;
+};
+
+/// \brief One basic block translated ahead of time.
+struct AotBlock {
+  // Runs the block and returns the next PC; null if there is no block
+  uint32_t (*run)(AotState &state);
+  // The instruction words the block was translated from
+  const uint32_t *words;
+  unsigned int length;
+  // Position among the program's blocks, from 0 to block_count - 1
+  unsigned int index;
+};
+
+/// \brief A guest binary translated ahead of time by rv32sim_aot.
+struct AotProgram {
+  // The binary it was translated from
+  const char *source;
+  unsigned int block_count;
+  // Returns the block starting at \p pc, with a null run if there is none.
+  // This is the dispatch for every jump, including indirect ones.
+  AotBlock (*lookup)(uint32_t pc);
+};
+
+/// \brief An execution engine that runs basic blocks compiled ahead of time
+/// into the host executable.
+///
+/// A translated block is only used once its words have been checked against
+/// guest memory, so a program can run against a binary that differs from the
+/// one it was translated from in its data, or even in its code. Code with
+/// no matching translated block, such as the target of an indirect jump into
+/// the middle of a block, runs a block at a time in a BlockEngine, which
+/// also raises ecall, ebreak and execution errors.
+///
+/// Stores to code that either engine has run end the storing block and
+/// discard what has been checked and decoded.
+class AotEngine : public WriteObserver {
+public:
+  AotEngine(std::shared_ptr<InstructionFile> _p_instruction_file,
+            std::shared_ptr<MemoryFile> _p_data_file,
+            const AotProgram &_program);
+
+  /// \brief Runs from \p pc until \p budget instructions have completed, a
+  /// breakpoint is reached or the guest traps, with the same parameters,
+  /// exceptions and result as BlockEngine::run.
+  bool run(uint32_t &pc, uint32_t *registers, unsigned long &retired,
+           unsigned long budget, bool ignore_breakpoint = false);
+
+  /// \brief Forgets which translated blocks match memory, and discards the
+  /// BlockEngine's blocks.
+  void flush();
+
+  /// \brief Sets the PCs to stop at. Translated blocks with a breakpoint
+  /// after their first instruction run in the BlockEngine instead.
+  void setBreakpoints(const std::set<uint32_t> &_breakpoints);
+
+  /// \brief Classifies the words the BlockEngine decodes through
+  /// \p p_predecode, or directly if it is null.
+  void setPredecodeTable(const PredecodeTable *p_predecode) {
+    interpreter.setPredecodeTable(p_predecode);
+  }
+
+  void onWrite(uint32_t address, unsigned int n) override;
+
+  const AotProgram &program() const { return translated_program; }
+
+private:
+  enum BlockStatus : uint8_t { UNCHECKED, USABLE, UNUSABLE };
+
+  std::shared_ptr<InstructionFile> p_instruction_file;
+  std::shared_ptr<MemoryFile> p_data_file;
+  AotProgram translated_program;
+  BlockEngine interpreter;
+  // By block index
+  std::vector<uint8_t> statuses;
+  // PCs whose BlockEngine blocks are in code_words
+  std::unordered_set<uint32_t> interpreted;
+  std::set<uint32_t> breakpoints;
+  // Addresses / 4 of the words run by either engine
+  std::unordered_set<uint32_t> code_words;
+  AotState state;
+
+  bool usable(uint32_t pc, const AotBlock &block);
+  void interpret(uint32_t &pc, unsigned long &retired, unsigned long budget);
+  void watch(uint32_t begin, uint32_t end);
+};
+
+#endif // AOTENGINE_H
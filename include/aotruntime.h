@@ -0,0 +1,20 @@
+#ifndef AOTRUNTIME_H
+#define AOTRUNTIME_H
+
+#include "aotengine.h"
+
+/// \brief The main function of an executable built from the source
+/// rv32sim_aot writes.
+///
+/// Runs \p program like rv32sim runs a binary: until an ecall, writing the
+/// signature at every ebreak and when the run fails. Takes the options
+/// [--signature=FILE] [--max-instructions=N] [--save-snapshot=FILE]
+/// [--engine=aot|block] and the binary to load, which defaults to the one
+/// the program was translated from. Running against a binary with other
+/// data, or other code, is safe: blocks that do not match memory are
+/// interpreted.
+///
+/// \returns The process exit code.
+int aotMain(int argc, char **argv, const AotProgram &program);
+
+#endif // AOTRUNTIME_H
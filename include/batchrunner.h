@@ -0,0 +1,73 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include "controlunit.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// \brief Settings shared by every test of a batch.
+struct BatchOptions {
+  // Worker threads; 0 uses one per hardware thread
+  unsigned int jobs = 0;
+  Engine engine = Engine::Interpreter;
+  MemoryBackend backend = MemoryBackend::Paged;
+  bool decode_cache = true;
+  unsigned long max_instructions = ControlUnit::UNLIMITED;
+  // Seconds of wall-clock time per test; 0 for no limit
+  double timeout = 0;
+  // Directory for signatures, created if missing, with each binary's path
+  // flattened into the file name ('/' as %2F); empty to write each next to
+  // its binary
+  std::string signature_dir;
+};
+
+/// \brief The outcome of one test of a batch.
+struct TestResult {
+  std::string binary;
+  std::string signature;
+  // The test reached ecall
+  bool passed;
+  StopReason reason;
+  std::string message;
+  unsigned long retired;
+  double seconds;
+};
+
+/// \brief Runs many program binaries in parallel, one ControlUnit per test.
+///
+/// A fixed set of worker threads takes tests from a shared queue until it is
+/// empty. Tests share nothing but the queue and the result slots, so each
+/// runs exactly as it would in its own rv32sim process: it stops at ecall,
+/// writes its signature on ebreak, and writes it and fails on an error, the
+/// instruction limit or the timeout. A test whose signature cannot be
+/// written fails too.
+class BatchRunner {
+public:
+  explicit BatchRunner(const BatchOptions &_options) : options(_options) {}
+
+  /// \brief Runs \p binaries and returns their results, in the same order.
+  std::vector<TestResult> run(const std::vector<std::string> &binaries);
+
+  /// \brief Expands directories in \p paths into the .bin and .elf files
+  /// below them, in sorted order. Other paths are kept as they are.
+  static std::vector<std::string>
+  collectBinaries(const std::vector<std::string> &paths);
+
+  /// \brief Prints one line per test and a summary.
+  static void printReport(const std::vector<TestResult> &results,
+                          double seconds, std::ostream &out);
+
+  /// \brief Writes the results as a JSON object.
+  static void writeJson(const std::vector<TestResult> &results,
+                        double seconds, std::ostream &out);
+
+private:
+  BatchOptions options;
+
+  TestResult runTest(const std::string &binary) const;
+  std::string signaturePath(const std::string &binary) const;
+};
+
+#endif // BATCHRUNNER_H
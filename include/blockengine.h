@@ -0,0 +1,146 @@
+#ifndef BLOCKENGINE_H
+#define BLOCKENGINE_H
+
+#include "decoder.h"
+#include "instructionfile.h"
+#include "memoryfile.h"
+#include "predecodetable.h"
+#include "statistics.h"
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// \brief A basic-block execution engine using direct-threaded dispatch.
+///
+/// Straight-line code is decoded once into a block: an array of operations,
+/// each carrying a pointer to the handler that executes it along with its
+/// pre-decoded operands. A block ends at the first branch, jump, ecall, ebreak
+/// or undecodable word. Each handler finishes by jumping straight to the
+/// handler of the next operation, so running a block involves no central
+/// dispatch loop and no virtual calls.
+///
+/// Blocks remember the blocks that followed them, so a hot loop runs from one
+/// block to the next without looking up the target PC.
+///
+/// The engine keeps its own copy of the registers as plain 32-bit words and
+/// implements the instruction semantics natively, producing the same
+/// architectural results as the staged RISC::Instruction model.
+class BlockEngine : public WriteObserver {
+public:
+  /// Register index that instructions targeting x0 write to instead, so that
+  /// x0 stays zero without a check on every write.
+  static const unsigned int SINK_REGISTER = 32;
+
+  BlockEngine(std::shared_ptr<InstructionFile> _p_instruction_file,
+              std::shared_ptr<MemoryFile> _p_data_file);
+
+  /// \brief Runs blocks from \p pc until \p budget instructions have
+  /// completed, a breakpoint is reached or the guest traps.
+  ///
+  /// Ecall, ebreak and execution errors propagate as the same exceptions the
+  /// staged model throws, with \p pc and \p registers describing the state
+  /// at the trap exactly as the staged model would leave it.
+  ///
+  /// \param pc The PC to start at; updated as execution proceeds.
+  /// \param registers The 32 architectural registers, read and updated in
+  /// place.
+  /// \param retired Incremented by the number of instructions that complete.
+  /// \param budget The maximum number of instructions to complete.
+  /// \param ignore_breakpoint Do not stop at a breakpoint on the starting
+  /// PC, so that a run can resume from the breakpoint it stopped at.
+  /// \returns True if execution stopped before a breakpoint.
+  bool run(uint32_t &pc, uint32_t *registers, unsigned long &retired,
+           unsigned long budget, bool ignore_breakpoint = false);
+
+  /// \brief Discards all decoded blocks.
+  void flush();
+
+  /// \brief Sets the PCs to stop at. Blocks are split so that every
+  /// breakpoint starts a block.
+  void setBreakpoints(const std::set<uint32_t> &_breakpoints);
+
+  /// \brief Reports retired instructions to \p _p_statistics, or to nothing
+  /// if it is null.
+  void setStatistics(Statistics *_p_statistics) {
+    p_statistics = _p_statistics;
+  }
+
+  /// \brief Classifies the words of new blocks through \p _p_predecode, or
+  /// directly if it is null. Blocks already decoded are kept.
+  void setPredecodeTable(const PredecodeTable *_p_predecode) {
+    p_predecode = _p_predecode;
+  }
+
+  void onWrite(uint32_t address, unsigned int n) override;
+
+  size_t blockCount() const { return blocks.size(); }
+
+  struct State;
+  struct Op;
+  typedef void (*Handler)(State &state, const Op *op);
+
+  struct Op {
+    Handler handler;
+    uint32_t pc;
+    uint32_t imm;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+  };
+
+  struct Block {
+    std::vector<Op> ops;
+    // Opcodes of the guest instructions, for statistics
+    std::vector<RISC::Opcode> opcodes;
+    // Number of guest instructions in the block
+    unsigned int length;
+    // Most recently seen successors, for chaining
+    uint32_t successor_pc[2];
+    Block *p_successor[2];
+    // Trap message for blocks ending in an undecodable or unreadable word
+    std::string error;
+  };
+
+  /// \returns The block at \p pc, decoding it if needed.
+  const Block &block(uint32_t pc) { return *lookup(pc); }
+
+  struct State {
+    uint32_t x[SINK_REGISTER + 1];
+    // Next PC, set by the operation that leaves the block
+    uint32_t pc;
+    // Instructions of the current block that completed
+    unsigned int completed;
+    // Outcome of the conditional branch that ended the block, if any
+    bool taken;
+    const Block *p_block;
+    MemoryFile *p_data_file;
+    // Set when a store overwrites decoded code
+    bool code_modified;
+  };
+
+private:
+  static const unsigned int MAX_BLOCK_LENGTH = 64;
+
+  std::shared_ptr<InstructionFile> p_instruction_file;
+  std::shared_ptr<MemoryFile> p_data_file;
+  std::unordered_map<uint32_t, std::unique_ptr<Block>> blocks;
+  // Word addresses (address / 4) of the decoded code
+  std::unordered_set<uint32_t> code_words;
+  std::set<uint32_t> breakpoints;
+  Statistics *p_statistics;
+  const PredecodeTable *p_predecode;
+  State state;
+
+  void execute(const Block *p_block, unsigned long &retired);
+  void retire(unsigned long &retired);
+  Block *follow(Block *p_previous, uint32_t pc);
+  Block *lookup(uint32_t pc);
+  std::unique_ptr<Block> build(uint32_t pc, unsigned int max_length);
+};
+
+#endif // BLOCKENGINE_H
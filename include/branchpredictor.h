@@ -0,0 +1,123 @@
+#ifndef BRANCHPREDICTOR_H
+#define BRANCHPREDICTOR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// \brief Predicts the direction of conditional branches for the pipeline
+/// timing model.
+///
+/// The model asks for a prediction when a branch retires and then reports
+/// the outcome, so implementations only ever see the committed path.
+class BranchPredictor {
+public:
+  virtual ~BranchPredictor() {}
+
+  /// \returns Whether the conditional branch at \p pc is predicted taken.
+  virtual bool predict(uint32_t pc) = 0;
+
+  /// \brief Trains the predictor with the outcome of the branch at \p pc.
+  virtual void update(uint32_t pc, bool taken) = 0;
+
+  /// \brief Forgets everything learnt so far.
+  virtual void reset() = 0;
+
+  /// \returns A short description for reports.
+  virtual std::string name() const = 0;
+};
+
+/// \brief The built-in predictors.
+enum class PredictorKind {
+  // Static: every branch falls through
+  NotTaken,
+  // A table of two-bit counters indexed by PC
+  Bimodal,
+  // A table of two-bit counters indexed by PC xor global history
+  GShare
+};
+
+/// \brief The largest index_bits of a dynamic predictor. Larger tables stop
+/// paying off long before they run out of memory.
+const unsigned int MAX_PREDICTOR_INDEX_BITS = 24;
+
+/// \brief Creates a built-in predictor. \p index_bits sets the table size of
+/// the dynamic predictors to 2^index_bits counters, and the length of the
+/// gshare history; it must be from 1 to MAX_PREDICTOR_INDEX_BITS.
+std::shared_ptr<BranchPredictor> makeBranchPredictor(PredictorKind kind,
+                                                     unsigned int index_bits);
+
+class NotTakenPredictor : public BranchPredictor {
+public:
+  bool predict(uint32_t) override { return false; }
+  void update(uint32_t, bool) override {}
+  void reset() override {}
+  std::string name() const override { return "not-taken"; }
+};
+
+class BimodalPredictor : public BranchPredictor {
+public:
+  explicit BimodalPredictor(unsigned int index_bits);
+
+  bool predict(uint32_t pc) override { return counters[index(pc)] >= 2; }
+  void update(uint32_t pc, bool taken) override;
+  void reset() override;
+  std::string name() const override;
+
+protected:
+  uint32_t mask;
+  // Saturating counters, 0 and 1 predicting not taken
+  std::vector<uint8_t> counters;
+
+  virtual uint32_t index(uint32_t pc) const { return (pc >> 2) & mask; }
+  void train(uint32_t slot, bool taken);
+};
+
+class GSharePredictor : public BimodalPredictor {
+public:
+  explicit GSharePredictor(unsigned int index_bits);
+
+  void update(uint32_t pc, bool taken) override;
+  void reset() override;
+  std::string name() const override;
+
+private:
+  // Outcomes of the most recent branches, the latest in bit 0
+  uint32_t history;
+
+  uint32_t index(uint32_t pc) const override {
+    return ((pc >> 2) ^ history) & mask;
+  }
+};
+
+/// \brief Predicts the targets of returns from the addresses of the calls
+/// that preceded them.
+///
+/// Calls and returns are recognised by the link registers x1 and x5 as the
+/// RISC-V specification recommends. When the stack is full, a call
+/// overwrites the oldest entry.
+class ReturnAddressStack {
+public:
+  // Far deeper than any call chain a hardware stack is sized for
+  static const unsigned int MAX_DEPTH = 1024;
+
+  /// \throws std::runtime_error if \p _depth is above MAX_DEPTH.
+  explicit ReturnAddressStack(unsigned int _depth = 0);
+
+  unsigned int depth() const {
+    return static_cast<unsigned int>(entries.size());
+  }
+  void push(uint32_t address);
+  /// \returns Whether there was an address to pop into \p address.
+  bool pop(uint32_t &address);
+  void clear() { count = 0; }
+
+private:
+  std::vector<uint32_t> entries;
+  // Index of the next push, and the number of valid entries
+  unsigned int top;
+  unsigned int count;
+};
+
+#endif // BRANCHPREDICTOR_H
@@ -0,0 +1,210 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// \brief Which line of a set a miss replaces.
+enum class ReplacementPolicy {
+  // Least recently used
+  LRU,
+  // Tree pseudo-LRU, one bit per node of a binary tree over the ways
+  PLRU,
+  Random
+};
+
+/// \brief What a store does.
+enum class WritePolicy {
+  // Stores allocate on a miss and dirty the line, which is written to the
+  // next level when it is evicted
+  WriteBack,
+  // Stores are passed on to the next level and do not allocate on a miss
+  WriteThrough
+};
+
+/// \brief The geometry and policies of one cache.
+struct CacheConfig {
+  // Bytes; size / (line_size * associativity) must be a power of two
+  uint32_t size = 16 * 1024;
+  uint32_t associativity = 4;
+  // Bytes; a power of two of at least 4
+  uint32_t line_size = 64;
+  ReplacementPolicy replacement = ReplacementPolicy::LRU;
+  WritePolicy write_policy = WritePolicy::WriteBack;
+  // Cycles to serve a hit to the level above; 0 for a first-level cache
+  // whose hits fit in the pipeline stage
+  unsigned int latency = 0;
+
+  /// \brief Parses SIZE:WAYS:LINE followed by any of lru, plru, random,
+  /// wb, wt and latency=N, separated by colons. Sizes take a k or m suffix.
+  /// Settings the text leaves out are taken from \p defaults.
+  static CacheConfig parse(const std::string &text,
+                           const CacheConfig &defaults);
+
+  /// \returns A description such as "16 KiB, 4-way, 64 B lines, LRU,
+  /// write-back".
+  std::string describe() const;
+};
+
+/// \brief A tag-only model of a set-associative cache.
+///
+/// Only tags, valid and dirty bits and replacement state are kept; the data
+/// stays in MemoryFile, so a lookup touches a few words of one set.
+class Cache {
+public:
+  struct Counts {
+    unsigned long reads = 0;
+    unsigned long writes = 0;
+    unsigned long misses = 0;
+    // Valid lines replaced by a miss, and those of them that were dirty
+    unsigned long evictions = 0;
+    unsigned long writebacks = 0;
+  };
+
+  /// \brief The outcome of one access.
+  struct Access {
+    bool hit;
+    // A dirty line was evicted and must be written to the next level
+    bool writeback;
+    uint32_t writeback_address;
+  };
+
+  Cache(const std::string &_name, const CacheConfig &_config);
+
+  /// \brief Looks up the line holding \p address, filling it on a miss
+  /// unless it is a store to a write-through cache.
+  Access access(uint32_t address, bool is_write);
+
+  /// \brief Empties the cache and clears the counts.
+  void reset();
+
+  const std::string &name() const { return cache_name; }
+  const CacheConfig &config() const { return configuration; }
+  const Counts &counts() const { return access_counts; }
+  uint32_t lineAddress(uint32_t address) const {
+    return address >> line_bits;
+  }
+
+private:
+  static const uint32_t INVALID = 0xFFFFFFFF;
+
+  std::string cache_name;
+  CacheConfig configuration;
+  unsigned int line_bits;
+  uint32_t set_mask;
+  uint32_t ways;
+
+  // Line addresses, by set and then way, INVALID when empty
+  std::vector<uint32_t> tags;
+  std::vector<uint8_t> dirty;
+  // LRU: the access number each line was last used at
+  std::vector<uint64_t> last_used;
+  uint64_t clock;
+  // PLRU: per set, the tree bits, each pointing away from the most recent
+  // access below it
+  std::vector<uint64_t> tree;
+  unsigned int tree_levels;
+  uint32_t random_state;
+
+  // The line hit or filled by the last access, so that runs of accesses to
+  // one line skip the search and the replacement update
+  uint32_t last_line;
+  uint32_t last_slot;
+
+  Counts access_counts;
+
+  void touch(uint32_t set, uint32_t way);
+  uint32_t victim(uint32_t set);
+};
+
+/// \brief Settings of the cache hierarchy.
+struct CacheHierarchyConfig {
+  CacheConfig l1i;
+  CacheConfig l1d;
+  // A unified second level behind both first-level caches
+  bool has_l2 = false;
+  CacheConfig l2;
+  // Cycles to serve a miss in the last level
+  unsigned int memory_latency = 100;
+  // Count misses by the PC of the instruction that accessed
+  bool per_pc = false;
+
+  CacheHierarchyConfig() {
+    l2.size = 256 * 1024;
+    l2.associativity = 8;
+    l2.latency = 10;
+  }
+};
+
+/// \brief Separate first-level instruction and data caches, with an
+/// optional unified second level, that turn each access into the cycles the
+/// pipeline waits for it.
+///
+/// Hits in the first level cost nothing. A miss costs the latency of the
+/// level that has the line, plus the memory latency if none has. Write-backs
+/// of dirty lines and stores to a write-through cache are assumed to be
+/// absorbed by a write buffer, so they update the next level without
+/// stalling.
+class CacheHierarchy {
+public:
+  struct PcCounts {
+    unsigned long fetch_misses = 0;
+    // Loads and stores, and those that missed
+    unsigned long accesses = 0;
+    unsigned long misses = 0;
+    // Valid first-level lines replaced by the fetch and data misses, and
+    // the dirty ones among them written to the next level
+    unsigned long evictions = 0;
+    unsigned long writebacks = 0;
+  };
+
+  explicit CacheHierarchy(const CacheHierarchyConfig &_config);
+
+  /// \returns The stall cycles of fetching the instruction at \p pc.
+  unsigned int fetch(uint32_t pc);
+
+  /// \returns The stall cycles of the \p size byte load or store at
+  /// \p address by the instruction at \p pc.
+  unsigned int access(uint32_t pc, uint32_t address, unsigned int size,
+                      bool is_write);
+
+  /// \brief Empties the caches and clears the counts.
+  void reset();
+
+  const CacheHierarchyConfig &config() const { return configuration; }
+  const Cache &l1i() const { return instruction_cache; }
+  const Cache &l1d() const { return data_cache; }
+  const Cache &l2() const { return unified_cache; }
+  unsigned long fetchStallCycles() const { return fetch_stalls; }
+  unsigned long dataStallCycles() const { return data_stalls; }
+  const std::unordered_map<uint32_t, PcCounts> &pcCounts() const {
+    return pc_counts;
+  }
+
+  /// \brief Prints the counts of each cache and the PCs with the most
+  /// misses.
+  void print(std::ostream &out) const;
+
+  /// \brief Writes the counts as a JSON object.
+  void writeJson(std::ostream &out) const;
+
+private:
+  CacheHierarchyConfig configuration;
+  Cache instruction_cache;
+  Cache data_cache;
+  Cache unified_cache;
+
+  unsigned long fetch_stalls;
+  unsigned long data_stalls;
+  std::unordered_map<uint32_t, PcCounts> pc_counts;
+
+  // Serves a first-level access and returns its stall cycles
+  unsigned int lookup(Cache &cache, uint32_t address, bool is_write);
+  // Stall cycles of a first-level miss on the line at \p address
+  unsigned int fill(uint32_t address);
+};
+
+#endif // CACHE_H
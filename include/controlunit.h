@@ -2,25 +2,84 @@
 #define CONTROLUNIT_H
 
 #include "alu.h"
+#include "aotengine.h"
+#include "blockengine.h"
+#include "cache.h"
 #include "constants.h"
+#include "decodecache.h"
+#include "decoder.h"
+#include "elffile.h"
 #include "exceptions.h"
 #include "immgenunit.h"
 #include "instructionfile.h"
+#include "jitengine.h"
 #include "maskingunit.hpp"
 #include "memoryfile.h"
+#include "pipeline.h"
+#include "predecodetable.h"
 #include "registerfile.h"
 #include "riscinstructions.h"
+#include "snapshot.h"
+#include "statistics.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <set>
 #include <sstream>
 
+/// \brief Selects how ControlUnit executes guest code.
+///
+/// \c Interpreter runs every instruction through the fetch, decode, execute,
+/// memory access and write back stages of its RISC::Instruction. \c Block
+/// runs pre-decoded basic blocks through the BlockEngine. \c Jit translates
+/// hot blocks to native code through the JitEngine, and runs as \c Block
+/// on hosts it cannot generate code for and while statistics are on. \c Aot
+/// runs blocks compiled ahead of time by rv32sim_aot through the AotEngine;
+/// it is selected by ControlUnit::setAotProgram, and runs as \c Block while
+/// statistics are on.
+enum class Engine { Interpreter, Block, Jit, Aot };
+
+/// \brief Why ControlUnit::run returned.
+enum class StopReason {
+  // The requested number of instructions completed
+  Budget,
+  Ecall,
+  Ebreak,
+  // The next instruction is at a PC in the breakpoint set
+  Breakpoint,
+  // The total number of completed instructions reached the cycle limit
+  CycleLimit,
+  // The wall-clock deadline passed
+  Deadline,
+  // Fetching, decoding or executing an instruction failed
+  Error
+};
+
+/// \brief The outcome of ControlUnit::run.
+struct RunResult {
+  StopReason reason;
+  // Instructions completed by this call
+  unsigned long retired;
+  // Description of the failure for StopReason::Error
+  std::string message;
+};
+
 class ControlUnit {
 protected:
   unsigned long cycles;
 
   std::bitset<32> pc;
-  std::shared_ptr<RISC::Instruction> p_current_instruction;
+  // Point into current_slot and current_decoded, or into the decode cache
+  // when it is enabled
+  RISC::Instruction *p_current_instruction;
+  const RISC::DecodedInstruction *p_current_decoded;
+  RISC::InstructionSlot current_slot;
+  RISC::DecodedInstruction current_decoded;
 
   std::shared_ptr<MaskingUnit> p_mu;
   std::shared_ptr<InstructionFile> p_instruction_file;
@@ -28,25 +87,248 @@ protected:
   std::shared_ptr<RegisterFile> p_reg_file;
   std::shared_ptr<ALU> p_alu;
   std::shared_ptr<MemoryFile> p_data_file;
+  // The mapped program file, which may not be open
+  std::shared_ptr<const MappedFile> p_image;
+  // Null unless the program is an ELF file
+  std::shared_ptr<const ElfFile> p_elf;
+  // Null until predecode() is called
+  std::shared_ptr<PredecodeTable> p_predecode;
+
+  std::shared_ptr<DecodeCache> p_decode_cache;
+  std::shared_ptr<Statistics> p_statistics;
+  std::shared_ptr<PipelineModel> p_pipeline;
+  std::shared_ptr<CacheHierarchy> p_caches;
+  std::shared_ptr<TraceWriter> p_trace;
+
+  Engine engine;
+  std::shared_ptr<BlockEngine> p_block_engine;
+  std::shared_ptr<JitEngine> p_jit_engine;
+  std::shared_ptr<AotEngine> p_aot_engine;
+
+  std::set<uint32_t> breakpoints;
+  // Set by setSignatureRange(), overriding the symbols and canaries
+  bool has_explicit_signature_range;
+  TraceRange explicit_signature_range;
+  unsigned long cycle_limit;
+  bool has_deadline;
+  std::chrono::steady_clock::time_point deadline;
 
 public:
-  ControlUnit(std::string bin_file);
-  ~ControlUnit() {}
+  static const unsigned long UNLIMITED =
+      std::numeric_limits<unsigned long>::max();
+
+  /// Number of instructions run between checks of the wall-clock deadline
+  static const unsigned long DEADLINE_CHECK_INTERVAL = 1 << 16;
+
+  /// \brief Loads \p bin_file, either a flat binary that is loaded at
+  /// address 0 and started there, or an ELF32 executable whose PT_LOAD
+  /// segments are loaded and which starts at its entry point.
+  ///
+  /// The signature of an ELF file with begin_signature and end_signature
+  /// symbols is the range between them.
+  ControlUnit(std::string bin_file,
+              MemoryBackend backend = MemoryBackend::Paged);
+  ~ControlUnit();
 
+  /// \brief Executes one instruction. Traps propagate as exceptions.
   void step();
 
+  /// \brief Executes up to \p budget instructions, stopping early at an
+  /// ecall, an ebreak, a breakpoint, the cycle limit, the deadline or an
+  /// error.
+  ///
+  /// Traps are reported through the result rather than thrown, with the PC
+  /// and registers left as step() would leave them. A breakpoint on the PC
+  /// the run starts at is ignored, so calling run() again resumes from it.
+  RunResult run(unsigned long budget = UNLIMITED);
+
+  /// \brief Runs the program the way the command-line front ends do: until
+  /// an ecall, writing the signature to \p signature_file at every ebreak
+  /// and when the run fails. \p on_ebreak, if set, is called after each
+  /// ebreak's signature is written. Breakpoints are stepped over. A
+  /// signature that cannot be written ends the run with an Error.
+  ///
+  /// \returns Ecall, CycleLimit, Deadline or Error, with the instructions
+  /// completed by this call; or Budget once \p budget instructions
+  /// completed, in which case calling runProgram() again resumes the run.
+  RunResult runProgram(const std::string &signature_file,
+                       unsigned long budget = UNLIMITED,
+                       const std::function<void()> &on_ebreak = nullptr);
+
+  /// \brief Reports how a run by runProgram() ended to \p out.
+  ///
+  /// \returns The process exit code: 0 after an ecall, 1 after a failure,
+  /// or -1 if the run stopped at its budget and has not ended.
+  int exitCode(const RunResult &result, std::ostream &out) const;
+
+  void addBreakpoint(uint32_t address);
+  void removeBreakpoint(uint32_t address);
+  void clearBreakpoints();
+
+  /// \brief Stops run() once \p limit instructions have completed in
+  /// total, counting from construction or from the start of the run a
+  /// restored snapshot was taken in.
+  void setCycleLimit(unsigned long limit) { cycle_limit = limit; }
+
+  /// \brief Stops run() once \p time has passed. The clock is checked every
+  /// DEADLINE_CHECK_INTERVAL instructions.
+  void setDeadline(std::chrono::steady_clock::time_point time);
+  void clearDeadline() { has_deadline = false; }
+
+  /// \returns The ELF file the program was loaded from, or nullptr for a
+  /// flat binary.
+  std::shared_ptr<const ElfFile> elf() const { return p_elf; }
+
+  unsigned long cycleCount() const { return cycles; }
+  uint32_t programCounter() const { return pc.to_ulong(); }
+
+  void setEngine(Engine _engine);
+
+  /// \brief Runs \p program, translated ahead of time from the binary
+  /// being run or one with the same code, and selects Engine::Aot.
+  void setAotProgram(const AotProgram &program);
+
+  /// \brief Turns the PC-indexed decoded-instruction cache on or off. It is
+  /// on by default.
+  void setDecodeCacheEnabled(bool enabled);
+
+  /// \returns The decode cache, or nullptr if it is disabled.
+  std::shared_ptr<const DecodeCache> decodeCache() const {
+    return p_decode_cache;
+  }
+
+  /// \brief Classifies every word of the program's code up front, for
+  /// all engines to decode from. The code is the executable segments of an
+  /// ELF file, or the whole of a flat binary.
+  ///
+  /// Those regions may also hold data, so illegal words are only rejected
+  /// when execution from the current PC can reach them (see
+  /// PredecodeTable::firstReachableIllegal). Others are recorded in the
+  /// table and trap if they are ever run.
+  ///
+  /// \throws std::runtime_error naming the lowest reachable illegal word.
+  void predecode();
+
+  /// \returns The predecoded code, or nullptr if predecode() was not called.
+  std::shared_ptr<const PredecodeTable> predecodeTable() const {
+    return p_predecode;
+  }
+
+  /// \brief Turns execution statistics on or off. They are off by default;
+  /// enabling them starts a fresh set of counts.
+  void setStatisticsEnabled(bool enabled);
+
+  /// \returns The statistics, or nullptr if they are disabled.
+  std::shared_ptr<const Statistics> statistics() const { return p_statistics; }
+
+  /// \brief Turns the pipeline timing model on or off. It is off by
+  /// default; enabling it starts from an empty pipeline.
+  ///
+  /// The model needs every instruction to retire on its own, so it runs the
+  /// interpreter whatever the engine.
+  void setPipelineEnabled(bool enabled,
+                          const PipelineConfig &config = PipelineConfig());
+
+  /// \returns The pipeline timing model, or nullptr if it is disabled.
+  std::shared_ptr<const PipelineModel> pipeline() const { return p_pipeline; }
+
+  /// \brief Turns the cache model on or off. It is off by default; enabling
+  /// it starts from empty caches.
+  ///
+  /// Every fetch, load and store of a retired instruction is looked up, and
+  /// with the pipeline model on, miss cycles stall the pipeline. Like the
+  /// pipeline model, it runs the interpreter whatever the engine.
+  void setCachesEnabled(bool enabled, const CacheHierarchyConfig &config =
+                                           CacheHierarchyConfig());
+
+  /// \returns The cache model, or nullptr if it is disabled.
+  std::shared_ptr<const CacheHierarchy> caches() const { return p_caches; }
+
+  /// \brief Records the instructions retired at a PC inside one of
+  /// \p ranges, or all of them if \p ranges is empty, to \p filename.
+  ///
+  /// Tracing needs every instruction to retire on its own, so it runs the
+  /// interpreter whatever the engine.
+  void startTrace(const std::string &filename,
+                  const std::vector<TraceRange> &ranges = {});
+
+  /// \brief Writes out the rest of the trace and stops tracing.
+  void stopTrace();
+
+  /// \returns The registers as of the last instruction that completed.
+  std::shared_ptr<const RegisterFile> registers() const { return p_reg_file; }
+
+  /// \brief Captures the PC, cycle count, registers and memory.
+  Snapshot snapshot();
+
+  /// \brief Continues from \p snapshot, discarding the current state.
+  ///
+  /// Settings (engine, breakpoints, limits and statistics) are kept. Code
+  /// decoded from the memory being replaced is dropped, along with the
+  /// predecoded code, so call predecode() again to use it. The pipeline
+  /// and cache models start empty, and the signature range is found again
+  /// in the restored memory.
+  void restore(const Snapshot &snapshot);
+
   // For verification only
-  void signature();
+  /// \brief Writes the memory signature to \p filename.
+  /// \throws std::runtime_error if the file cannot be written.
+  void signature(const std::string &filename);
+
+  /// \brief Writes the words in [\p begin, \p end) as the signature, rather
+  /// than the words between the canaries.
+  /// \throws std::runtime_error unless the bounds are word aligned and in
+  /// order.
+  void setSignatureRange(uint32_t begin, uint32_t end);
 
 private:
+  void loadElf();
+
+  /// \brief Finds the signature range as the program is loaded: the one set
+  /// by setSignatureRange(), else the begin_signature and end_signature
+  /// symbols of an ELF file, else the canaries in memory.
+  void resolveSignatureRange();
+
+  /// \brief Hands \p p_table, which may be null, to every engine.
+  void setPredecodeTable(std::shared_ptr<PredecodeTable> p_table);
+  bool runInstructions(unsigned long count, bool ignore_breakpoint);
+  bool runBlocks(unsigned long count, bool ignore_breakpoint);
+  bool usesBlocks() const {
+    return engine != Engine::Interpreter && !p_trace && !p_pipeline &&
+           !p_caches;
+  }
+  bool usesJit() const {
+    return usesBlocks() && engine == Engine::Jit && p_jit_engine->isNative() &&
+           !p_statistics;
+  }
+  bool usesAot() const {
+    return usesBlocks() && engine == Engine::Aot && p_aot_engine &&
+           !p_statistics;
+  }
+  void updateWriteObserver();
+  void updateBreakpoints();
+
+  /// \returns The address the current instruction will access, or 0 if it
+  /// does not access memory. Must be called before it executes.
+  uint32_t memoryAddress();
+  void traceRetired(uint32_t instruction_pc, uint32_t address);
+  // Feeds the current instruction to the cache and pipeline models
+  void timeRetired(uint32_t instruction_pc, uint32_t address);
+  // Whether the current instruction is a conditional branch that was taken.
+  // Must be called after it executes.
+  bool branchTaken() const;
+
   void fetch();
   void decode();
   void execute();
   void memoryAccess();
   void writeBack();
 
-  std::shared_ptr<RISC::Instruction>
-  createInstruction(std::bitset<32> instruction);
+  /// \brief Decodes \p instruction into \p decoded and constructs the
+  /// instruction in \p slot, with its fields and immediate generated.
+  RISC::Instruction *createInstruction(std::bitset<32> instruction,
+                                       RISC::DecodedInstruction &decoded,
+                                       RISC::InstructionSlot &slot);
 };
 
 #endif // CONTROLUNIT_H
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef DECODECACHE_H
+#define DECODECACHE_H
+
+#include "memoryfile.h"
+#include "riscinstructions.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// \brief Caches fetched and decoded instructions by PC.
+///
+/// Each entry holds an instruction whose register indices and immediates have
+/// already been extracted and generated, so re-executing it only reads the
+/// register file and runs the later stages. The cache is direct mapped on the
+/// word address, with the full PC kept as the tag.
+///
+/// The cache watches the range of addresses it holds instructions for, and
+/// drops entries when a store overwrites any of their bytes.
+///
+/// Instructions live inside the entries, so filling the cache allocates
+/// nothing. Dropping an entry only marks it invalid; its instruction stays
+/// alive until the entry is refilled, so a store may safely invalidate the
+/// instruction that is executing it.
+class DecodeCache : public WriteObserver {
+public:
+  struct Entry {
+    bool valid = false;
+    uint32_t pc = 0;
+    RISC::DecodedInstruction decoded;
+    RISC::InstructionSlot slot;
+  };
+
+  explicit DecodeCache(unsigned int index_bits = 13);
+
+  /// \brief Returns the entry caching the instruction at \p pc, or nullptr
+  /// on a miss.
+  const Entry *lookup(uint32_t pc);
+
+  /// \brief Returns the entry to decode the instruction at \p pc into. The
+  /// entry is invalid until insert() is called for \p pc.
+  Entry &entryFor(uint32_t pc);
+
+  /// \brief Marks the instruction decoded into entryFor(\p pc) as the
+  /// cached instruction at \p pc.
+  void insert(uint32_t pc);
+
+  /// \brief Drops every entry whose instruction overlaps the \p n bytes
+  /// starting at \p address.
+  void invalidate(uint32_t address, unsigned int n);
+
+  /// \brief Drops every entry.
+  void clear();
+
+  void onWrite(uint32_t address, unsigned int n) override {
+    invalidate(address, n);
+  }
+
+  unsigned long hits() const { return hit_count; }
+  unsigned long misses() const { return miss_count; }
+  unsigned long invalidations() const { return invalidation_count; }
+
+private:
+  std::unique_ptr<Entry[]> entries;
+  unsigned int entry_count;
+  uint32_t index_mask;
+
+  unsigned long hit_count;
+  unsigned long miss_count;
+  unsigned long invalidation_count;
+};
+
+inline const DecodeCache::Entry *DecodeCache::lookup(uint32_t pc) {
+  const Entry &entry = entries[(pc >> 2) & index_mask];
+  if (entry.valid && entry.pc == pc) {
+    hit_count++;
+    return &entry;
+  }
+  miss_count++;
+  return nullptr;
+}
+
+#endif // DECODECACHE_H
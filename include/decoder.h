@@ -0,0 +1,155 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace RISC {
+
+/// \brief Every RV32I instruction the simulator implements, plus a single
+/// entry for encodings it does not recognise.
+enum class Opcode : uint8_t {
+  Illegal,
+  // RType
+  Add,
+  Sub,
+  Xor,
+  Or,
+  And,
+  ShiftLeftLogi,
+  ShiftRightLogi,
+  ShiftRightArith,
+  SetLessThan,
+  SetLessThanUnsigned,
+  // IType
+  AddImm,
+  XorImm,
+  OrImm,
+  AndImm,
+  ShiftLeftLogiImm,
+  ShiftRightLogiImm,
+  ShiftRightArithImm,
+  SetLessThanImm,
+  SetLessThanImmUnsigned,
+  LoadWord,
+  LoadHalfWord,
+  LoadByte,
+  LoadUnsignedHalfWord,
+  LoadUnsignedByte,
+  JumpAndLinkReg,
+  Ecall,
+  Ebreak,
+  Fence,
+  // SType
+  SaveWord,
+  SaveHalfWord,
+  SaveByte,
+  // BType
+  BranchEqual,
+  BranchNotEqual,
+  BranchLessThan,
+  BranchGreaterThanEqual,
+  BranchLessThanUnsigned,
+  BranchGreaterThanEqualUnsigned,
+  // UType
+  LoadUpperImmediate,
+  AddUpperImmedateToPC,
+  // JType
+  JumpAndLink,
+  Count
+};
+
+/// \brief The RV32I base instruction formats.
+enum class Format : uint8_t { R, I, S, B, U, J };
+
+/// \brief How an instruction's operands are written in assembly.
+enum class Syntax : uint8_t {
+  // ecall, ebreak, fence
+  None,
+  // add rd, rs1, rs2
+  Register,
+  // addi rd, rs1, imm
+  Immediate,
+  // slli rd, rs1, shamt
+  Shift,
+  // lw rd, imm(rs1) and jalr rd, imm(rs1)
+  Load,
+  // sw rs2, imm(rs1)
+  Store,
+  // beq rs1, rs2, target
+  Branch,
+  // lui rd, imm
+  Upper,
+  // jal rd, target
+  Jump
+};
+
+/// \brief One row of the decoder's instruction table.
+///
+/// An instruction word encodes this instruction when the bits selected by
+/// \c mask equal \c match. Everything else that needs to know about an
+/// instruction, from the disassembler to the execution engines, reads it
+/// from this table, so supporting a new instruction starts with a new row.
+struct InstructionInfo {
+  Opcode opcode;
+  const char *mnemonic;
+  Format format;
+  Syntax syntax;
+  uint32_t mask;
+  uint32_t match;
+  // Bytes read or written by loads and stores, otherwise 0
+  uint8_t access_size;
+  // Execution may not continue at the next sequential address
+  bool ends_block;
+};
+
+/// \brief An instruction word split into its operation and operands.
+///
+/// \c imm holds the final immediate operand: sign-extended for I, S, B and J
+/// formats, with the implicit low zero bit already applied to branch and jump
+/// offsets, and shifted into the upper 20 bits for U formats.
+struct DecodedInstruction {
+  uint32_t raw;
+  Opcode opcode;
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  uint32_t imm;
+};
+
+/// \brief Returns the table row describing \p opcode.
+const InstructionInfo &instructionInfo(Opcode opcode);
+
+/// \brief Classifies a 32-bit instruction word, returning Opcode::Illegal
+/// for encodings that match no row of the instruction table.
+Opcode classifyInstruction(uint32_t raw);
+
+/// \brief Classifies the \p count words at \p words into \p opcodes, with
+/// the same results as classifyInstruction.
+///
+/// On x86-64 hosts with AVX2 eight words are classified at a time, looking
+/// up the decode table with vector gathers; elsewhere one at a time.
+void classifyInstructions(const uint32_t *words, size_t count,
+                          Opcode *opcodes);
+
+/// \brief Classifies and splits a 32-bit instruction word.
+DecodedInstruction decodeInstruction(uint32_t raw);
+
+/// \brief Splits \p raw, already classified as \p opcode.
+DecodedInstruction decodeInstruction(uint32_t raw, Opcode opcode);
+
+/// \brief Returns true for instructions after which execution may not
+/// continue at the next sequential address: branches, jumps, ecall, ebreak
+/// and illegal encodings.
+inline bool endsBlock(Opcode opcode) {
+  return instructionInfo(opcode).ends_block;
+}
+
+/// \brief Renders \p raw as assembly, with branch and jump targets resolved
+/// against \p pc. Illegal encodings are rendered as a .word directive.
+std::string disassemble(uint32_t raw, uint32_t pc);
+
+} // namespace RISC
+
+#endif // DECODER_H
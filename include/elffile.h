@@ -0,0 +1,74 @@
+#ifndef ELFFILE_H
+#define ELFFILE_H
+
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// \brief A symbol of an ELF file's symbol table.
+struct ElfSymbol {
+  uint32_t address;
+  uint32_t size;
+  std::string name;
+};
+
+/// \brief A PT_LOAD segment: \c file_size bytes at \c file_offset in the file
+/// are loaded at \c address, and the rest of its \c memory_size bytes are
+/// zero.
+struct ElfSegment {
+  uint32_t address;
+  uint32_t file_offset;
+  uint32_t file_size;
+  uint32_t memory_size;
+  bool executable;
+};
+
+/// \brief A little-endian ELF32 RISC-V executable.
+///
+/// Only what the simulator needs is read: the entry point, the PT_LOAD
+/// segments and the symbols of the .symtab section. The file stays mapped
+/// and its segments are loaded straight from the mapping.
+class ElfFile {
+public:
+  /// \brief Parses \p p_image, which was mapped from \p filename. Throws if
+  /// it is not a RISC-V ELF32 executable.
+  ElfFile(const std::string &filename,
+          std::shared_ptr<const MappedFile> p_image);
+
+  /// \returns True if \p image starts with the ELF magic number.
+  static bool isElf(const MappedFile &image);
+
+  uint32_t entry() const { return entry_point; }
+  const std::vector<ElfSegment> &segments() const { return load_segments; }
+  std::shared_ptr<const MappedFile> image() const { return p_image; }
+
+  /// \brief The symbols, sorted by address and then name.
+  const std::vector<ElfSymbol> &symbols() const { return symbol_table; }
+
+  /// \returns The symbol called \p name, or nullptr if there is none.
+  const ElfSymbol *symbol(const std::string &name) const;
+
+  /// \returns The symbol \p address lies in, or else the closest symbol
+  /// below it, or nullptr if there is none.
+  const ElfSymbol *symbolAt(uint32_t address) const;
+
+private:
+  std::string filename;
+  std::shared_ptr<const MappedFile> p_image;
+  uint32_t entry_point;
+  std::vector<ElfSegment> load_segments;
+  std::vector<ElfSymbol> symbol_table;
+  // Indices into symbol_table, sorted by name
+  std::vector<size_t> by_name;
+
+  uint32_t read32(size_t offset) const;
+  uint16_t read16(size_t offset) const;
+  void check(size_t offset, size_t size) const;
+  void readSegments(uint32_t offset, uint16_t entry_size, uint16_t count);
+  void readSymbols(uint32_t offset, uint16_t entry_size, uint16_t count);
+};
+
+#endif // ELFFILE_H
@@ -1,6 +1,8 @@
 #ifndef FILE_HPP
 #define FILE_HPP
 
+#include "mappedfile.h"
+
 #include <bitset>
 #include <fstream>
 #include <functional>
@@ -19,7 +21,7 @@ protected:
       data;
 
 public:
-  File(std::string _memory_file = "");
+  File(std::string _memory_file = "", bool load_file = true);
 
   void load(std::string save_file);
   void
@@ -27,68 +29,47 @@ public:
   void print(std::string prefix = "");
   void dump(std::streamsize size, std::string filename = "");
   std::bitset<V> read(std::bitset<K> address);
+
+protected:
+  void insertImage(const MappedFile &image);
 };
 
 template <unsigned int K, unsigned int V>
-File<K, V>::File(std::string _memory_file)
+File<K, V>::File(std::string _memory_file, bool load_file)
     : memory_file(_memory_file),
       data([](const std::bitset<K> &lhs, const std::bitset<K> &rhs) {
         return lhs.to_ulong() < rhs.to_ulong();
       }) {
-  std::ifstream file(memory_file, std::ios::binary);
-
-  bool should_load = true;
-  if (!file.is_open()) {
-    should_load = false;
+  if (!load_file) {
+    return;
   }
 
-  if (should_load) {
-    u_int32_t address = 0;
-    char val;
-    while (file.read(reinterpret_cast<char *>(&val), 1)) {
-      try {
-        std::bitset<K> address_bitset = std::bitset<K>(address);
-        std::bitset<V> data_byte_bitset = std::bitset<V>(val);
-        data.insert({address_bitset, data_byte_bitset});
-        address++;
-      } catch (const std::invalid_argument &e) {
-        throw std::runtime_error("Invalid address or value at address: " +
-                                 std::to_string(address));
-      } catch (const std::out_of_range &e) {
-        throw std::runtime_error("Address or value out of range at address: " +
-                                 std::to_string(address));
-      }
-    }
+  MappedFile image(memory_file);
+  if (image.isOpen()) {
+    insertImage(image);
   }
 }
 
 template <unsigned int K, unsigned int V>
 void File<K, V>::load(std::string save_file) {
-  std::ifstream file(save_file, std::ios::binary);
+  MappedFile image(save_file);
 
-  if (!file.is_open()) {
-    throw std::runtime_error("Could not open memory file: " + memory_file);
+  if (!image.isOpen()) {
+    throw std::runtime_error("Could not open memory file: " + save_file);
   }
 
-  std::vector<std::pair<std::bitset<K>, std::bitset<V>>> new_data;
-  u_int32_t address = 0;
-  char val;
-  while (file.read(reinterpret_cast<char *>(&val), 1)) {
-    try {
-      std::bitset<K> address_bitset = std::bitset<K>(address);
-      std::bitset<V> data_byte_bitset = std::bitset<V>(val);
-      new_data.insert({address_bitset, data_byte_bitset});
-      address++;
-    } catch (const std::invalid_argument &e) {
-      throw std::runtime_error("Invalid address or value at address: " +
-                               std::to_string(address));
-    } catch (const std::out_of_range &e) {
-      throw std::runtime_error("Address or value out of range at address: " +
-                               std::to_string(address));
-    }
-  }
+  data.clear();
+  insertImage(image);
+}
 
-  set_data(new_data);
+template <unsigned int K, unsigned int V>
+void File<K, V>::insertImage(const MappedFile &image) {
+  const uint8_t *p_bytes = image.data();
+  for (u_int32_t address = 0; address < image.size(); address++) {
+    // Addresses ascend, so every insertion lands at the end of the map
+    data.emplace_hint(data.end(), std::bitset<K>(address),
+                      std::bitset<V>(p_bytes[address]));
+  }
 }
 
 template <unsigned int K, unsigned int V>
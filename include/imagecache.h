@@ -0,0 +1,78 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+/// \brief A process-wide cache of the program images mapped so far.
+///
+/// Every ControlUnit of a process that runs the same binary gets the same
+/// read-only mapping, which PagedMemory borrows pages from and copies only on
+/// their first write. Memory for N runs of one binary then grows with the
+/// pages they dirty rather than with N copies of the image, and opening an
+/// image that is already cached costs a stat() and a map lookup.
+///
+/// Entries are keyed by path and validated against the file's device, inode,
+/// size and modification time, so a binary rebuilt between runs is mapped
+/// again. Images are also keyed by that identity alone, so different paths
+/// to one file, such as links or relative and absolute paths, share one
+/// mapping. The contents are never read here: only the pages a run touches
+/// are.
+///
+/// The cache is safe to use from several threads at once.
+class ImageCache {
+public:
+  /// \brief The cache shared by the whole process.
+  static ImageCache &instance();
+
+  /// \brief Returns the mapped image of \p filename, mapping it if it is not
+  /// cached yet. The result is not open if the file could not be mapped.
+  std::shared_ptr<const MappedFile> open(const std::string &filename);
+
+  /// \brief Drops every cached image. Images still in use stay mapped until
+  /// their last user releases them.
+  void clear();
+
+  /// \returns The number of distinct images held by the cache.
+  size_t size();
+
+private:
+  // Identifies one version of a file on disk
+  struct FileIdentity {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t modified_ns = 0;
+
+    bool operator==(const FileIdentity &other) const {
+      return device == other.device && inode == other.inode &&
+             size == other.size && modified_ns == other.modified_ns;
+    }
+    bool operator<(const FileIdentity &other) const {
+      return std::tie(device, inode, size, modified_ns) <
+             std::tie(other.device, other.inode, other.size,
+                      other.modified_ns);
+    }
+  };
+  struct PathEntry {
+    FileIdentity identity;
+    std::shared_ptr<const MappedFile> p_image;
+  };
+
+  std::mutex mutex;
+  std::map<std::string, PathEntry> paths;
+  // Keyed by file identity; the path entries keep the images alive
+  std::map<FileIdentity, std::weak_ptr<const MappedFile>> files;
+
+  ImageCache() = default;
+
+  static bool identify(const std::string &filename, FileIdentity &identity);
+};
+
+#endif // IMAGECACHE_H
@@ -1,20 +1,29 @@
 #ifndef INSTRUCTIONFILE_H
 #define INSTRUCTIONFILE_H
 
-#include "file.hpp"
+#include "memoryfile.h"
 
 #include <bitset>
-#include <fstream>
-#include <iostream>
-#include <map>
-#include <sstream>
+#include <memory>
 #include <string>
 
-class InstructionFile : public File<32, 8> {
+/// \brief The instruction fetch port of a guest memory.
+///
+/// Instructions are fetched from the same MemoryFile that loads and stores
+/// use, so the program image is loaded and held once, and code written by
+/// the guest is fetched as written. Components that cache decoded code stay
+/// coherent by watching the MemoryFile's stores through a WriteObserver.
+class InstructionFile {
+protected:
+  std::shared_ptr<MemoryFile> p_memory;
+
 public:
-  InstructionFile(std::string _memory_file);
+  explicit InstructionFile(std::shared_ptr<MemoryFile> _p_memory);
 
+  /// \brief Fetches the 32-bit instruction word at \p address.
+  /// \throws std::runtime_error if any of its bytes lie outside the image
+  /// and everything the guest has stored.
   std::bitset<32> read(std::bitset<32> address);
 };
 
-#endif // INSTRUCTIONFILE_H
\ No newline at end of file
+#endif // INSTRUCTIONFILE_H
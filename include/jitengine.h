@@ -0,0 +1,136 @@
+#ifndef JITENGINE_H
+#define JITENGINE_H
+
+#include "blockengine.h"
+#include "instructionfile.h"
+#include "memoryfile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+/// \brief A dynamic binary translator that compiles hot basic blocks to
+/// x86-64 machine code.
+///
+/// Code starts out running one block at a time in a BlockEngine, and the
+/// engine counts how often each block is entered. A block entered
+/// HOT_THRESHOLD times is translated into native code in an executable code
+/// cache. Translated code keeps the guest registers in a fixed State
+/// structure addressed through a host register, and its loads and stores
+/// call into the MemoryFile. An exit from one translated block to another
+/// is patched into a direct jump, so a hot loop runs without coming back to
+/// the engine.
+///
+/// Ecall, ebreak, undecodable words and breakpoints are never translated: a
+/// translated block ends before them and the BlockEngine runs them, raising
+/// the same traps as the other engines. A store to decoded code ends the
+/// block that made it and then discards all translations.
+///
+/// Native code is only generated on x86-64 Linux hosts; elsewhere
+/// everything runs in the BlockEngine. Translated code does not report to
+/// Statistics.
+class JitEngine : public WriteObserver {
+public:
+  /// Number of times a block is entered before it is translated
+  static const unsigned int HOT_THRESHOLD = 32;
+
+  /// Size of the executable code cache. All translations are discarded when
+  /// it fills up.
+  static const size_t CODE_CACHE_SIZE = 16 << 20;
+
+  JitEngine(std::shared_ptr<InstructionFile> _p_instruction_file,
+            std::shared_ptr<MemoryFile> _p_data_file);
+  ~JitEngine();
+
+  JitEngine(const JitEngine &) = delete;
+  JitEngine &operator=(const JitEngine &) = delete;
+
+  /// \brief Runs from \p pc until \p budget instructions have completed, a
+  /// breakpoint is reached or the guest traps, with the same parameters,
+  /// exceptions and result as BlockEngine::run.
+  bool run(uint32_t &pc, uint32_t *registers, unsigned long &retired,
+           unsigned long budget, bool ignore_breakpoint = false);
+
+  /// \brief Discards all translated and decoded code.
+  void flush();
+
+  /// \brief Sets the PCs to stop at. Translated blocks end before them and
+  /// are never linked to them.
+  void setBreakpoints(const std::set<uint32_t> &_breakpoints);
+
+  /// \brief Classifies the words of new blocks and translations through
+  /// \p _p_predecode, or directly if it is null.
+  void setPredecodeTable(const PredecodeTable *_p_predecode);
+
+  void onWrite(uint32_t address, unsigned int n) override;
+
+  /// \returns Whether this host runs translated code.
+  bool isNative() const { return p_code_cache != nullptr; }
+
+  size_t translationCount() const { return translated; }
+  size_t codeSize() const { return code_used - code_start; }
+
+  /// \brief The guest state translated code works on.
+  struct State {
+    uint32_t x[32];
+    // Next PC, set by the exit that leaves translated code
+    uint32_t pc;
+    // Instructions left to run; translated code keeps it in a host register
+    int64_t budget;
+    // The exit jump that left translated code, to be patched into a direct
+    // jump to the next block, or null if the exit cannot be linked
+    uint8_t *p_exit;
+    MemoryFile *p_data_file;
+    // Set when a store overwrites decoded code
+    bool code_modified;
+  };
+
+private:
+  struct Translation {
+    // Times the block was entered before it was translated
+    unsigned int count;
+    // Null until translated
+    uint8_t *p_code;
+    // Number of guest instructions translated
+    unsigned int length;
+    // The first instruction cannot be translated, so the block always runs
+    // in the BlockEngine
+    bool interpret_only;
+    // Its words are in code_words
+    bool watched;
+  };
+
+  typedef void (*Entry)(State *state, const uint8_t *p_code);
+
+  static const unsigned int MAX_BLOCK_LENGTH = 64;
+  // Upper bound on the native code of one block
+  static const size_t MAX_TRANSLATION_SIZE = MAX_BLOCK_LENGTH * 128;
+
+  std::shared_ptr<InstructionFile> p_instruction_file;
+  std::shared_ptr<MemoryFile> p_data_file;
+  BlockEngine interpreter;
+  std::unordered_map<uint32_t, Translation> translations;
+  size_t translated;
+  std::set<uint32_t> breakpoints;
+  const PredecodeTable *p_predecode;
+  // Addresses / 4 of the words decoded by either engine
+  std::unordered_set<uint32_t> code_words;
+  State state;
+
+  uint8_t *p_code_cache;
+  // The entry and exit routines sit at the start of the cache, before
+  // code_start
+  Entry p_enter;
+  uint8_t *p_leave;
+  size_t code_start;
+  size_t code_used;
+
+  void interpret(unsigned long &retired, unsigned long budget);
+  void translate(uint32_t pc, Translation &translation);
+  void watch(uint32_t pc);
+};
+
+#endif // JITENGINE_H
@@ -0,0 +1,33 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// \brief A read-only memory mapping of a whole file.
+///
+/// The file is mapped privately and never written through, so the mapping can
+/// serve directly as the backing store for guest pages that are only ever
+/// read. The operating system pages the contents in lazily, so parts of the
+/// image that the guest never touches are never read from disk.
+class MappedFile {
+public:
+  /// \brief Maps \p filename. Use isOpen() to check whether it succeeded.
+  explicit MappedFile(const std::string &filename);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool isOpen() const { return is_open; }
+  const uint8_t *data() const { return p_data; }
+  size_t size() const { return length; }
+
+private:
+  bool is_open;
+  const uint8_t *p_data;
+  size_t length;
+};
+
+#endif // MAPPEDFILE_H
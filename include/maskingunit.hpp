@@ -2,6 +2,57 @@
 #define MASKINGUNIT_HPP
 
 #include <bitset>
+#include <cstdint>
+
+/// \brief Describes a bit field of a 32-bit word at compile time.
+///
+/// The field is the \p WIDTH bits starting at bit \p OFFSET. When it is
+/// extracted it is placed at bit \p POSITION of the result, which lets an
+/// immediate scattered over several fields be gathered in one expression.
+///
+/// \tparam OFFSET The index of the field's least significant bit.
+/// \tparam WIDTH The number of bits in the field.
+/// \tparam POSITION Where the field's least significant bit is placed.
+template <unsigned int OFFSET, unsigned int WIDTH, unsigned int POSITION = 0>
+struct BitField {
+  static_assert(WIDTH > 0 && OFFSET + WIDTH <= 32 && POSITION + WIDTH <= 32,
+                "BitField must lie within a 32-bit word");
+
+  static const unsigned int offset = OFFSET;
+  static const unsigned int width = WIDTH;
+  static const unsigned int position = POSITION;
+  static const uint32_t mask = WIDTH == 32 ? ~0u : (1u << WIDTH) - 1;
+
+  /// \returns The field of \p word, moved to bit \p POSITION.
+  static constexpr uint32_t extract(uint32_t word) {
+    return ((word >> OFFSET) & mask) << POSITION;
+  }
+};
+
+/// \brief The fields of the RISC-V instruction formats.
+namespace Fields {
+typedef BitField<7, 5> Rd;
+typedef BitField<15, 5> Rs1;
+typedef BitField<20, 5> Rs2;
+typedef BitField<20, 12> ImmI;
+typedef BitField<12, 20> ImmU;
+
+/// imm[11:0] of an S-type instruction
+typedef BitField<7, 5, 0> ImmS0;
+typedef BitField<25, 7, 5> ImmS1;
+
+/// imm[12:1] of a B-type instruction
+typedef BitField<8, 4, 0> ImmB0;
+typedef BitField<25, 6, 4> ImmB1;
+typedef BitField<7, 1, 10> ImmB2;
+typedef BitField<31, 1, 11> ImmB3;
+
+/// imm[20:1] of a J-type instruction
+typedef BitField<21, 10, 0> ImmJ0;
+typedef BitField<20, 1, 10> ImmJ1;
+typedef BitField<12, 8, 11> ImmJ2;
+typedef BitField<31, 1, 19> ImmJ3;
+} // namespace Fields
 
 /// \brief Provides bit masking and concatenation utilities.
 ///
@@ -26,12 +77,20 @@ public:
   /// \returns A bitset of size \c M containing the extracted bits.
   template <size_t M, size_t N>
   static std::bitset<M> hardwareMaskBits(std::bitset<N> bits, size_t index, size_t length) {
+#ifdef RV32SIM_BIT_SERIAL_MASKING
     std::bitset<M> masked_bits = 0;
     size_t j = 0;
     for (size_t i = index; i < index + length && i < N && j < M; i++, j++) {
       masked_bits.set(j, bits.test(i));
     }
     return masked_bits;
+#else
+    static_assert(M <= 64 && N <= 64, "Bitsets wider than 64 bits");
+    if (index >= N) {
+      return 0;
+    }
+    return (bits.to_ullong() >> index) & lowMask(length);
+#endif
   }
 
   /// \brief Concatenates two bitsets into a single bitset.
@@ -48,6 +107,7 @@ public:
   template <size_t M, size_t N>
   static std::bitset<M + N> concatBits(std::bitset<M> low_bits,
                                 std::bitset<N> high_bits) {
+#ifdef RV32SIM_BIT_SERIAL_MASKING
     std::bitset<M + N> concatted_bits = 0;
     size_t j = 0;
     for (size_t i = 0; i < M && j < M + N; i++, j++) {
@@ -57,6 +117,54 @@ public:
       concatted_bits.set(j, high_bits.test(i));
     }
     return concatted_bits;
+#else
+    static_assert(M + N <= 64, "Bitsets wider than 64 bits");
+    return low_bits.to_ullong() | high_bits.to_ullong() << M;
+#endif
+  }
+
+  /// \brief Extracts the bit fields \p Fields of \p bits and combines them
+  /// into one value.
+  ///
+  /// Each field is placed at its own position, so an immediate scattered
+  /// across an instruction is gathered with one shift and mask per field.
+  ///
+  /// \tparam M The size of the output bitset.
+  /// \tparam Fields The BitField descriptors to gather.
+  /// \param bits The instruction word to extract from.
+  /// \returns A bitset of size \c M containing the gathered fields.
+  template <size_t M, typename... Fields>
+  static std::bitset<M> extract(std::bitset<32> bits) {
+#ifdef RV32SIM_BIT_SERIAL_MASKING
+    std::bitset<M> gathered = 0;
+    int expand[] = {0, (copyField<Fields>(bits, gathered), 0)...};
+    (void)expand;
+    return gathered;
+#else
+    return Gather<Fields...>::extract(static_cast<uint32_t>(bits.to_ulong()));
+#endif
+  }
+
+private:
+  template <typename... Fields> struct Gather {
+    static constexpr uint32_t extract(uint32_t) { return 0; }
+  };
+
+  template <typename Field, typename... Rest> struct Gather<Field, Rest...> {
+    static constexpr uint32_t extract(uint32_t word) {
+      return Field::extract(word) | Gather<Rest...>::extract(word);
+    }
+  };
+
+  static unsigned long long lowMask(size_t length) {
+    return length >= 64 ? ~0ull : (1ull << length) - 1;
+  }
+
+  template <typename Field, size_t M>
+  static void copyField(std::bitset<32> bits, std::bitset<M> &gathered) {
+    for (size_t i = 0; i < Field::width && Field::position + i < M; i++) {
+      gathered.set(Field::position + i, bits.test(Field::offset + i));
+    }
   }
 };
 
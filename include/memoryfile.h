@@ -2,6 +2,7 @@
 #define MEMORYFILE_H
 
 #include "file.hpp"
+#include "pagedmemory.h"
 
 #include <bitset>
 #include <fstream>
@@ -11,9 +12,38 @@
 #include <string>
 #include <vector>
 
+/// \brief Receives the stores that land inside a watched address range.
+///
+/// The range is public so that MemoryFile can test it inline on every store
+/// and only pay for a virtual call when a write actually hits it.
+class WriteObserver {
+public:
+  uint32_t watch_begin = ~0u;
+  uint32_t watch_end = 0;
+
+  virtual ~WriteObserver() {}
+  virtual void onWrite(uint32_t address, unsigned int n) = 0;
+};
+
 class MemoryFile : public File<32, 8> {
+protected:
+  MemoryBackend backend;
+  PagedMemory pages;
+  WriteObserver *p_write_observer;
+
+  // Words [signature_begin, signature_end) form the signature, once known
+  bool has_signature_range;
+  uint32_t signature_begin;
+  uint32_t signature_end;
+
 public:
-  MemoryFile(std::string _memory_file = "mem");
+  MemoryFile(std::string _memory_file = "mem",
+             MemoryBackend _backend = MemoryBackend::Paged);
+
+  /// \brief Loads \p size bytes at \p offset in \p p_image at \p address.
+  /// Memory past them reads as zero without being loaded.
+  void loadSegment(std::shared_ptr<const MappedFile> p_image, size_t offset,
+                   size_t size, uint32_t address);
 
   std::bitset<32> readBytes(std::bitset<32> address, unsigned int N,
                             bool sign_extend = false);
@@ -21,7 +51,57 @@ public:
   void writeBytes(std::bitset<32> address, std::bitset<32> _value,
                   unsigned int N);
 
+  /// \returns True if the byte at \p address holds image or stored data.
+  bool isMapped(uint32_t address);
+
+  /// \brief Formats the signature, one 8-digit hex word per line.
+  ///
+  /// The signature is the range set by setSignatureRange() or found by
+  /// findSignatureRange(), dumped directly. Without one, it runs from the
+  /// first 0x6f5ca309 canary word through the second, as the guest has
+  /// written them: if both are found the range is kept for later calls,
+  /// and if the closing canary is missing, every word from the first canary
+  /// to the end of memory is dumped and the search is repeated next time.
   std::string signature();
+
+  /// \brief Uses the words in [\p begin, \p end) as the signature instead
+  /// of searching for the canaries.
+  /// \throws std::runtime_error unless \p begin and \p end are word
+  /// aligned and \p begin is not above \p end.
+  void setSignatureRange(uint32_t begin, uint32_t end);
+
+  /// \returns True if setSignatureRange() accepts [\p begin, \p end).
+  static bool isValidSignatureRange(uint32_t begin, uint32_t end) {
+    return begin <= end && begin % 4 == 0 && end % 4 == 0;
+  }
+
+  /// \brief Searches memory for the two canaries and uses the words from
+  /// the first through the second as the signature.
+  /// \returns False, leaving no range set, if they are not both found.
+  bool findSignatureRange();
+
+  /// \brief Forgets the signature range, so that the next signature()
+  /// searches for the canaries.
+  void clearSignatureRange() { has_signature_range = false; }
+
+  /// \brief Captures the contents of memory. See PagedMemory::snapshot().
+  std::vector<PagedMemory::SharedPage> snapshot();
+
+  /// \brief Replaces the contents of memory with \p pages. Stores are not
+  /// reported to the write observer.
+  void restore(const std::vector<PagedMemory::SharedPage> &pages);
+
+  /// \brief Reports stores overlapping \p p_observer's range to it. Pass
+  /// nullptr to stop watching.
+  void setWriteObserver(WriteObserver *p_observer);
+
+private:
+  /// \brief Calls \p visit(address, word) for the aligned words of memory
+  /// in ascending order, stopping early if it returns false.
+  template <typename F> void forEachWord(F visit);
+
+  /// \brief Reads the word at \p address without mapping anything.
+  uint32_t peekWord(uint32_t address);
 };
 
-#endif // MEMORYFILE_H
\ No newline at end of file
+#endif // MEMORYFILE_H
@@ -0,0 +1,170 @@
+#ifndef NATIVEALU_HPP
+#define NATIVEALU_HPP
+
+#include <bitset>
+#include <cstdint>
+
+/**
+ * @class NativeALU
+ * @brief An ALU computing directly on 32-bit machine words.
+ * @details
+ * NativeALU has the same static interface as GateLevelALU and produces the
+ * same results, including the argument order of the greaterThanEqual
+ * comparisons, so either can be used as the instruction set's ALU. Every
+ * operation is a single inline expression over uint32_t, for builds where
+ * throughput matters more than modelling the hardware.
+ *
+ * The uint32_t overloads are shared with the engines that keep registers as
+ * plain words.
+ */
+class NativeALU {
+public:
+  /**
+   * @name Word Operations
+   * @{
+   */
+
+  static uint32_t add(uint32_t val1, uint32_t val2) { return val1 + val2; }
+
+  static uint32_t leftShift(uint32_t val, uint32_t shamt) {
+    return shamt < 32 ? val << shamt : 0;
+  }
+
+  static uint32_t rightShift(uint32_t val, uint32_t shamt) {
+    return shamt < 32 ? val >> shamt : 0;
+  }
+
+  /**
+   * @brief Shifts right, filling with copies of the sign bit. Shift amounts
+   * of 32 or more shift by 31.
+   */
+  static uint32_t arithmeticRightShift(uint32_t val, uint32_t shamt) {
+    shamt = shamt < 32 ? shamt : 31;
+    return (val & 0x80000000) ? ~(~val >> shamt) : val >> shamt;
+  }
+
+  static bool lessThanSigned(uint32_t val1, uint32_t val2) {
+    // Flipping the sign bits maps two's complement order onto unsigned order
+    return (val1 ^ 0x80000000) < (val2 ^ 0x80000000);
+  }
+
+  /** @} */ // end of Word Operations
+
+  /**
+   * @name Hardware Operations
+   * @{
+   */
+
+  static std::bitset<32> hardwareNor(std::bitset<32> val1,
+                                     std::bitset<32> val2) {
+    return ~(val1.to_ulong() | val2.to_ulong());
+  }
+
+  static std::bitset<32> hardwareLeftShift(std::bitset<32> val,
+                                           std::bitset<32> shamt) {
+    return leftShift(val.to_ulong(), shamt.to_ulong());
+  }
+
+  static std::bitset<32> hardwareRightShift(std::bitset<32> val,
+                                            std::bitset<32> shamt) {
+    return rightShift(val.to_ulong(), shamt.to_ulong());
+  }
+
+  static bool hardwareIsEqual(std::bitset<32> val1, std::bitset<32> val2) {
+    return val1.to_ulong() == val2.to_ulong();
+  }
+
+  /** @} */ // end of Hardware Operations
+
+  /**
+   * @name Bitwise Operations
+   * @{
+   */
+
+  static std::bitset<32> bitwiseNot(std::bitset<32> val1) {
+    return ~val1.to_ulong();
+  }
+
+  static std::bitset<32> bitwiseOr(std::bitset<32> val1,
+                                   std::bitset<32> val2) {
+    return val1.to_ulong() | val2.to_ulong();
+  }
+
+  static std::bitset<32> bitwiseAnd(std::bitset<32> val1,
+                                    std::bitset<32> val2) {
+    return val1.to_ulong() & val2.to_ulong();
+  }
+
+  static std::bitset<32> bitwiseNand(std::bitset<32> val1,
+                                     std::bitset<32> val2) {
+    return ~(val1.to_ulong() & val2.to_ulong());
+  }
+
+  static std::bitset<32> bitwiseXor(std::bitset<32> val1,
+                                    std::bitset<32> val2) {
+    return val1.to_ulong() ^ val2.to_ulong();
+  }
+
+  static std::bitset<32> bitwiseXnor(std::bitset<32> val1,
+                                     std::bitset<32> val2) {
+    return ~(val1.to_ulong() ^ val2.to_ulong());
+  }
+
+  /** @} */ // end of Bitwise Operations
+
+  /**
+   * @name Arithmetic Operations
+   * @{
+   */
+
+  static std::bitset<32> negate(std::bitset<32> val) {
+    return 0u - static_cast<uint32_t>(val.to_ulong());
+  }
+
+  static std::bitset<32> add(std::bitset<32> val1, std::bitset<32> val2) {
+    return add(static_cast<uint32_t>(val1.to_ulong()),
+               static_cast<uint32_t>(val2.to_ulong()));
+  }
+
+  static bool lessThanUnsigned(std::bitset<32> val1, std::bitset<32> val2) {
+    return val1.to_ulong() < val2.to_ulong();
+  }
+
+  static bool lessThanSigned(std::bitset<32> val1, std::bitset<32> val2) {
+    return lessThanSigned(static_cast<uint32_t>(val1.to_ulong()),
+                          static_cast<uint32_t>(val2.to_ulong()));
+  }
+
+  /**
+   * @brief True when \p val2 is greater than or equal to \p val1, matching
+   * GateLevelALU; callers pass the operands as (rs2, rs1).
+   */
+  static bool greaterThanEqualUnsigned(std::bitset<32> val1,
+                                       std::bitset<32> val2) {
+    return val2.to_ulong() >= val1.to_ulong();
+  }
+
+  /**
+   * @brief True when \p val2 is greater than or equal to \p val1 as signed
+   * values, matching GateLevelALU; callers pass the operands as (rs2, rs1).
+   */
+  static bool greaterThanEqualSigned(std::bitset<32> val1,
+                                     std::bitset<32> val2) {
+    return !lessThanSigned(static_cast<uint32_t>(val2.to_ulong()),
+                           static_cast<uint32_t>(val1.to_ulong()));
+  }
+
+  static std::bitset<32> arithmeticRightShift(std::bitset<32> val,
+                                              std::bitset<32> shamt) {
+    return arithmeticRightShift(static_cast<uint32_t>(val.to_ulong()),
+                                static_cast<uint32_t>(shamt.to_ulong()));
+  }
+
+  static std::bitset<32> maskLowFive(std::bitset<32> val) {
+    return val.to_ulong() & 0x1F;
+  }
+
+  /** @} */ // end of Arithmetic Operations
+};
+
+#endif // NATIVEALU_HPP
@@ -0,0 +1,23 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+/// \brief Parses the value of a command-line option that counts something:
+/// decimal digits only, no larger than \p max.
+/// \returns False, leaving \p value unchanged, if \p text is not such a
+/// count.
+bool parseCount(const std::string &text, unsigned long &value,
+                unsigned long max = std::numeric_limits<unsigned long>::max());
+
+/// \brief Parses a finite, non-negative number of seconds.
+/// \returns False, leaving \p seconds unchanged, if \p text is not one.
+bool parseSeconds(const std::string &text, double &seconds);
+
+/// \brief Parses a 32-bit address in decimal or 0x-prefixed hex.
+/// \returns False, leaving \p address unchanged, if \p text is not one.
+bool parseAddress(const std::string &text, uint32_t &address);
+
+#endif // OPTIONS_H
@@ -0,0 +1,210 @@
+#ifndef PAGEDMEMORY_H
+#define PAGEDMEMORY_H
+
+#include "mappedfile.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// \brief Selects the storage used behind MemoryFile.
+///
+/// \c Paged is the default flat-array backend. \c Map keeps the original
+/// ordered byte map of File<32, 8>, which is slow but convenient to inspect
+/// while debugging.
+enum class MemoryBackend { Paged, Map };
+
+/// \brief A sparse, page-granular 32-bit guest address space.
+///
+/// Guest memory is split into 4 KiB pages held in a two-level table: the top
+/// 10 address bits select a page table, the next 10 bits select a page within
+/// it and the low 12 bits are the offset into the page. Tables and pages are
+/// only allocated when first written, so reading an address that was never
+/// written returns zero without allocating anything.
+///
+/// A page is either private to this memory, or shared read-only with a
+/// mapped program image or a snapshot. Shared pages are copied on their first
+/// write.
+///
+/// The pages of the most recent read and write are remembered, so consecutive
+/// accesses to the same page (the common case for both fetch and the stack)
+/// skip the table walk entirely.
+class PagedMemory {
+public:
+  static const unsigned int PAGE_BITS = 12;
+  static const uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+  static const uint32_t PAGE_MASK = PAGE_SIZE - 1;
+  static const unsigned int TABLE_BITS = 10;
+  static const uint32_t TABLE_SIZE = 1u << TABLE_BITS;
+  static const uint32_t TABLE_MASK = TABLE_SIZE - 1;
+
+  /// \brief One page of a snapshot. The bytes are never written again, so
+  /// any number of memories and snapshots can share them.
+  struct SharedPage {
+    uint32_t number;
+    std::shared_ptr<const uint8_t> p_bytes;
+  };
+
+  PagedMemory();
+
+  /// \brief Reads \p n (1..4) little-endian bytes starting at \p address.
+  uint32_t read(uint32_t address, unsigned int n);
+
+  /// \brief Writes the low \p n (1..4) bytes of \p value little-endian,
+  /// starting at \p address.
+  void write(uint32_t address, uint32_t value, unsigned int n);
+
+  /// \brief Copies \p size bytes from \p bytes into memory at \p base.
+  void load(const uint8_t *bytes, size_t size, uint32_t base = 0);
+
+  /// \brief Uses the pages of a mapped image as read-only backing store,
+  /// starting at the page-aligned address \p base.
+  void attach(std::shared_ptr<const MappedFile> p_image, uint32_t base = 0);
+
+  /// \brief Loads the \p size bytes at \p offset in a mapped image into
+  /// memory at \p address. Whole pages that line up with pages of the image
+  /// are shared read-only, and the rest is copied.
+  void attach(std::shared_ptr<const MappedFile> p_image, size_t offset,
+              size_t size, uint32_t address);
+
+  /// \brief Maps a binary file into memory at \p base.
+  ///
+  /// The file's mapping is taken from the ImageCache and attached when
+  /// possible, so loading costs nothing per byte and every memory of the
+  /// process that loads the same file shares its unwritten pages; otherwise
+  /// it is copied in.
+  /// \returns The number of bytes loaded, or 0 if the file could not be
+  /// opened.
+  size_t loadFile(const std::string &filename, uint32_t base = 0);
+
+  /// \brief Returns true if the page containing \p address is present.
+  bool isMapped(uint32_t address);
+
+  /// \brief Returns every present page, in ascending order.
+  ///
+  /// Private pages are handed over to the snapshot and shared from then on,
+  /// so taking a snapshot copies nothing, and later writes copy only the
+  /// pages they touch.
+  std::vector<SharedPage> snapshot();
+
+  /// \brief Replaces the whole contents of memory with \p pages, sharing
+  /// them rather than copying them.
+  void restore(const std::vector<SharedPage> &pages);
+
+  /// \brief Calls \p visit(base_address, bytes) for every present page in
+  /// ascending address order, stopping early if it returns false.
+  template <typename F> void forEachPage(F visit) const;
+
+private:
+  struct Page {
+    uint8_t bytes[PAGE_SIZE];
+  };
+  struct PageEntry {
+    // Points either into p_owned or into p_shared
+    uint8_t *p_bytes = nullptr;
+    std::unique_ptr<Page> p_owned;
+    // A read-only page of a mapped image or of a snapshot
+    std::shared_ptr<const uint8_t> p_shared;
+  };
+  struct PageTable {
+    std::array<PageEntry, TABLE_SIZE> pages;
+  };
+
+  std::array<std::unique_ptr<PageTable>, TABLE_SIZE> directory;
+
+  // One-entry caches of the last page read and written. The page number is at
+  // most 20 bits wide, so an all-ones value never matches.
+  uint32_t last_read_number;
+  uint8_t *p_last_read;
+  uint32_t last_write_number;
+  uint8_t *p_last_write;
+
+  uint8_t *findPage(uint32_t address);
+  uint8_t *findWritablePage(uint32_t address);
+  uint8_t *makeWritable(uint32_t page_number);
+  PageEntry *lookup(uint32_t page_number) const;
+  PageEntry &entry(uint32_t page_number);
+  void share(uint32_t page_number, std::shared_ptr<const uint8_t> p_bytes);
+};
+
+inline uint8_t *PagedMemory::findPage(uint32_t address) {
+  uint32_t page_number = address >> PAGE_BITS;
+  if (page_number == last_read_number) {
+    return p_last_read;
+  }
+  PageEntry *p_entry = lookup(page_number);
+  if (p_entry == nullptr || p_entry->p_bytes == nullptr) {
+    return nullptr;
+  }
+  last_read_number = page_number;
+  p_last_read = p_entry->p_bytes;
+  return p_last_read;
+}
+
+inline uint8_t *PagedMemory::findWritablePage(uint32_t address) {
+  uint32_t page_number = address >> PAGE_BITS;
+  if (page_number == last_write_number) {
+    return p_last_write;
+  }
+  return makeWritable(page_number);
+}
+
+inline uint32_t PagedMemory::read(uint32_t address, unsigned int n) {
+  uint32_t offset = address & PAGE_MASK;
+  uint32_t value = 0;
+  if (offset + n <= PAGE_SIZE) {
+    const uint8_t *p_page = findPage(address);
+    if (p_page == nullptr) {
+      return 0;
+    }
+    for (unsigned int i = 0; i < n; i++) {
+      value |= static_cast<uint32_t>(p_page[offset + i]) << (i * 8);
+    }
+    return value;
+  }
+
+  // Access straddles a page boundary
+  for (unsigned int i = 0; i < n; i++) {
+    value |= read(address + i, 1) << (i * 8);
+  }
+  return value;
+}
+
+inline void PagedMemory::write(uint32_t address, uint32_t value,
+                               unsigned int n) {
+  uint32_t offset = address & PAGE_MASK;
+  if (offset + n <= PAGE_SIZE) {
+    uint8_t *p_page = findWritablePage(address);
+    for (unsigned int i = 0; i < n; i++) {
+      p_page[offset + i] = (value >> (i * 8)) & 0xFF;
+    }
+    return;
+  }
+
+  // Access straddles a page boundary
+  for (unsigned int i = 0; i < n; i++) {
+    write(address + i, value >> (i * 8), 1);
+  }
+}
+
+template <typename F> void PagedMemory::forEachPage(F visit) const {
+  for (uint32_t i = 0; i < TABLE_SIZE; i++) {
+    if (!directory[i]) {
+      continue;
+    }
+    for (uint32_t j = 0; j < TABLE_SIZE; j++) {
+      const PageEntry &page = directory[i]->pages[j];
+      if (page.p_bytes == nullptr) {
+        continue;
+      }
+      uint32_t base = ((i << TABLE_BITS) | j) << PAGE_BITS;
+      if (!visit(base, static_cast<const uint8_t *>(page.p_bytes))) {
+        return;
+      }
+    }
+  }
+}
+
+#endif // PAGEDMEMORY_H
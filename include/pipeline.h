@@ -0,0 +1,178 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "branchpredictor.h"
+#include "decoder.h"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+
+/// \brief Why an instruction entered the execute stage later than one cycle
+/// after the instruction before it.
+enum class StallCause {
+  // The instruction uses the result of the load right before it
+  LoadUse,
+  // Without forwarding, a source register is not yet written back
+  DataHazard,
+  // A conditional branch was mispredicted, or predicted taken
+  Branch,
+  // jal, whose target is known in decode
+  Jump,
+  // jalr, unless the return address stack predicted its target
+  IndirectJump,
+  // The instruction missed in the instruction cache
+  InstructionCache,
+  // The instruction before it held memory access after a data cache miss
+  DataCache,
+  Count
+};
+
+/// \brief Settings of the modelled pipeline.
+struct PipelineConfig {
+  // Results are forwarded from the EX/MEM and MEM/WB latches to the ALU
+  // inputs; without it, operands are read from the register file in decode
+  bool forwarding = true;
+  PredictorKind predictor = PredictorKind::NotTaken;
+  // log2 of the number of counters of a dynamic predictor
+  unsigned int predictor_bits = 12;
+  // Entries of the return address stack; 0 to leave returns unpredicted
+  unsigned int return_stack_depth = 0;
+};
+
+/// \brief Times the retired instruction stream on a classic in-order
+/// five-stage pipeline: fetch, decode, execute, memory access and write
+/// back.
+///
+/// The functional simulation is unchanged; the model is fed each
+/// instruction as it retires and works out the cycle it would enter the
+/// execute stage. Everything else follows from that cycle, because a
+/// single-issue in-order pipeline keeps its instructions in lock step.
+///
+/// Branches are resolved in execute, so a mispredicted branch flushes the
+/// two instructions behind it. There is no branch target buffer: a target
+/// is known in decode at the earliest, so a branch correctly predicted
+/// taken, a jal and a return predicted by the return address stack flush
+/// one instruction, and any other jalr two.
+///
+/// With forwarding, only a load followed by a use of its result stalls, for
+/// one cycle. Without forwarding, the register file is written in the first
+/// half of write back and read in the second half of decode, so a use
+/// stalls until two cycles after its producer left execute.
+class PipelineModel {
+public:
+  struct BranchCounts {
+    unsigned long executed = 0;
+    unsigned long mispredicted = 0;
+  };
+
+  struct Forwards {
+    // From the instruction right before, out of the EX/MEM latch
+    unsigned long ex_mem = 0;
+    // From two instructions before, or a load right before, out of MEM/WB
+    unsigned long mem_wb = 0;
+  };
+
+  static const unsigned int STAGES = 5;
+
+  explicit PipelineModel(const PipelineConfig &_config = PipelineConfig());
+
+  /// \brief Times one instruction that retired at \p pc, continuing at
+  /// \p next_pc, whose fetch and memory access were held up by the given
+  /// cache miss cycles. \p taken is the outcome of a conditional branch and
+  /// is ignored for other instructions; a branch to pc + 4 may go either way.
+  void retire(const RISC::DecodedInstruction &decoded, uint32_t pc,
+              uint32_t next_pc, bool taken, unsigned int fetch_stall = 0,
+              unsigned int memory_stall = 0);
+
+  /// \brief Empties the pipeline, resets the predictors and clears the
+  /// counts.
+  void reset();
+
+  /// \brief Replaces the conditional branch predictor, for predictors other
+  /// than the built-in ones. It is reset along with the pipeline.
+  void setBranchPredictor(std::shared_ptr<BranchPredictor> predictor);
+
+  const PipelineConfig &config() const { return configuration; }
+  unsigned long instructions() const { return retired; }
+
+  /// \returns Cycles from the first fetch to the last write back.
+  unsigned long cycles() const;
+  double cpi() const;
+  unsigned long stallCycles(StallCause cause) const {
+    return stall_cycles[static_cast<unsigned int>(cause)];
+  }
+  unsigned long stallEvents(StallCause cause) const {
+    return stall_events[static_cast<unsigned int>(cause)];
+  }
+  const Forwards &forwards() const { return forward_counts; }
+
+  /// \returns Conditional branches and their mispredictions, in total and
+  /// by PC.
+  const BranchCounts &branchTotals() const { return branch_totals; }
+  const std::unordered_map<uint32_t, BranchCounts> &branchCounts() const {
+    return branches;
+  }
+  /// \returns Returns whose target the return address stack predicted, or
+  /// failed to.
+  const BranchCounts &returnTotals() const { return return_totals; }
+
+  /// \brief Prints the CPI, the stalls by cause and the branch prediction
+  /// accuracy.
+  void print(std::ostream &out) const;
+
+  /// \brief Writes the timing as a JSON object.
+  void writeJson(std::ostream &out) const;
+
+private:
+  static const unsigned int CAUSES =
+      static_cast<unsigned int>(StallCause::Count);
+
+  // Which fields of an instruction name registers, and what it costs later
+  // instructions, by opcode
+  struct Timing {
+    bool reads_rs1;
+    bool reads_rs2;
+    bool writes_rd;
+    bool is_load;
+    bool is_branch;
+  };
+
+  PipelineConfig configuration;
+  Timing timings[static_cast<unsigned int>(RISC::Opcode::Count)];
+
+  unsigned long retired;
+  // Cycle the last instruction entered execute
+  unsigned long execute_cycle;
+  // Bubbles the last instruction leaves behind it, and why
+  unsigned int flush_cycles;
+  StallCause flush_cause;
+  // Cycles the last instruction spent in memory access beyond the first
+  unsigned int memory_cycles;
+  // Bit n is set once xn has been written
+  uint32_t written;
+  // Cycle each register was produced in execute, the earliest cycle a
+  // reader of it can enter execute, and whether a load produced it
+  unsigned long produced[32];
+  unsigned long ready[32];
+  bool produced_by_load[32];
+
+  std::shared_ptr<BranchPredictor> p_predictor;
+  ReturnAddressStack return_stack;
+
+  unsigned long stall_cycles[CAUSES];
+  unsigned long stall_events[CAUSES];
+  Forwards forward_counts;
+  BranchCounts branch_totals;
+  std::unordered_map<uint32_t, BranchCounts> branches;
+  BranchCounts return_totals;
+
+  // Counts the path the operand in \p reg takes into execute at \p cycle
+  void countForward(uint8_t reg, unsigned long cycle);
+  // Bubbles behind the jalr at \p pc that continued at \p next_pc
+  unsigned int predictJumpRegister(const RISC::DecodedInstruction &decoded,
+                                   uint32_t pc, uint32_t next_pc);
+};
+
+#endif // PIPELINE_H
@@ -0,0 +1,86 @@
+#ifndef PREDECODETABLE_H
+#define PREDECODETABLE_H
+
+#include "decoder.h"
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/// \brief The opcode of every aligned word of a program's code, classified
+/// in one pass before the program runs.
+///
+/// The table holds one byte per word, its Opcode. Its format, whether it is
+/// legal and whether it ends a block follow from the instruction table.
+/// Regions are classified with RISC::classifyInstructions, so the decoders
+/// and static analyses that consult the table never classify those words
+/// again.
+///
+/// The table describes the image as loaded. Guest stores go to memory rather
+/// than to the read-only image, so opcode() compares the word the caller
+/// fetched with the image word, and classifies the word itself when code has
+/// been overwritten.
+class PredecodeTable {
+public:
+  /// \brief A run of code loaded at \c address from an image.
+  struct Region {
+    uint32_t address;
+    // Little-endian instruction words, borrowed from the image
+    const uint8_t *p_bytes;
+    std::vector<RISC::Opcode> opcodes;
+
+    uint32_t end() const {
+      return address + 4 * static_cast<uint32_t>(opcodes.size());
+    }
+    uint32_t word(size_t index) const {
+      uint32_t raw;
+      std::memcpy(&raw, p_bytes + 4 * index, 4);
+      return raw;
+    }
+  };
+
+  /// \brief Classifies the whole words among the \p size bytes at
+  /// \p offset in \p p_image, which are loaded at \p address.
+  void addRegion(std::shared_ptr<const MappedFile> p_image, size_t offset,
+                 size_t size, uint32_t address);
+
+  /// \returns The opcode of \p raw, the word fetched from \p pc.
+  RISC::Opcode opcode(uint32_t pc, uint32_t raw) const;
+
+  /// \brief Finds the lowest illegal word that execution from \p entry can
+  /// reach through fall-through, branches, direct jumps and returns from
+  /// calls, and past ebreak but not ecall, which ends a run. Data mixed into
+  /// the regions, such as literals and padding, is never reached and so
+  /// never reported.
+  /// \returns False if every reachable word is legal, otherwise true with
+  /// its address in \p address and the word in \p raw.
+  bool firstReachableIllegal(uint32_t entry, uint32_t &address,
+                             uint32_t &raw) const;
+
+  const std::vector<Region> &regions() const { return code_regions; }
+
+  size_t wordCount() const;
+
+private:
+  std::vector<std::shared_ptr<const MappedFile>> images;
+
+  // The region holding the word at \p pc, or null
+  const Region *regionOf(uint32_t pc) const;
+
+  std::vector<Region> code_regions;
+};
+
+inline RISC::Opcode PredecodeTable::opcode(uint32_t pc, uint32_t raw) const {
+  for (const Region &region : code_regions) {
+    uint32_t offset = pc - region.address;
+    if (offset < 4 * region.opcodes.size() && (offset & 3) == 0 &&
+        region.word(offset >> 2) == raw) {
+      return region.opcodes[offset >> 2];
+    }
+  }
+  return RISC::classifyInstruction(raw);
+}
+
+#endif // PREDECODETABLE_H
@@ -1,20 +1,53 @@
 #ifndef REGISTERFILE_H
 #define REGISTERFILE_H
 
-#include "file.hpp"
-
 #include <bitset>
+#include <cstdint>
 #include <iostream>
-#include <map>
+#include <string>
 
-class RegisterFile : public File<5, 32> {
+/// \brief The 32 integer registers, held in a flat array indexed by register
+/// number.
+///
+/// x0 reads as zero: a write stores into the array and then clears x0, so
+/// the write path has no branch.
+class RegisterFile {
 public:
+  static const unsigned int REGISTER_COUNT = 32;
+
+  /// \brief Starts with every register zero, or with register i set to byte
+  /// i of \p _memory_file if it exists.
   RegisterFile(std::string _memory_file = "reg");
 
   std::pair<std::bitset<32>, std::bitset<32>> read(std::bitset<5> reg1,
-                                                   std::bitset<5> reg2);
+                                                   std::bitset<5> reg2) {
+    return {values[reg1.to_ulong()], values[reg2.to_ulong()]};
+  }
+
+  std::bitset<32> read(std::bitset<5> reg) { return values[reg.to_ulong()]; }
+
+  void write(std::bitset<5> reg, std::bitset<32> value) {
+    values[reg.to_ulong()] = static_cast<uint32_t>(value.to_ulong());
+    values[0] = 0;
+  }
+
+  /// \returns All 32 registers, indexed by register number.
+  const uint32_t *data() const { return values; }
+
+  // Bulk transfer of all 32 registers, for engines that keep their own copy
+  void copyTo(uint32_t *_values) const;
+  void copyFrom(const uint32_t *_values);
+
+  /// \brief Prints each register number and value on its own line.
+  void print(std::string prefix = "") const;
+
+  /// \brief Appends the registers in order, \p size bytes each, to
+  /// \p filename, or to the file the registers were loaded from.
+  void dump(std::streamsize size, std::string filename = "") const;
 
-  void write(std::bitset<5> reg, std::bitset<32> value);
+private:
+  std::string memory_file;
+  uint32_t values[REGISTER_COUNT];
 };
 
-#endif // REGISTERFILE_H
\ No newline at end of file
+#endif // REGISTERFILE_H
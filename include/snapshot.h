@@ -0,0 +1,40 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "pagedmemory.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// \brief The architectural state of a ControlUnit at one point in time.
+///
+/// Memory is held as shared, immutable pages, so taking a snapshot and
+/// restoring it in memory cost a pointer per present page rather than a copy
+/// of its bytes, and the memory that restores it copies only the pages it
+/// writes afterwards.
+///
+/// On disk a snapshot is a little-endian file made of:
+///   - the magic "RV32SNAP" and a 32-bit format VERSION,
+///   - the 32-bit PC, the 64-bit cycle count and the 32 registers,
+///   - a 32-bit page count, then for each page its 32-bit page number, the
+///     32-bit length of its contents without trailing zero bytes, and that
+///     many bytes.
+/// All-zero pages cost 8 bytes and never-touched pages cost nothing. The
+/// program image is stored too, so restoring does not need the binary.
+struct Snapshot {
+  static const uint32_t VERSION = 1;
+
+  uint32_t pc = 0;
+  unsigned long cycles = 0;
+  uint32_t registers[32] = {};
+  std::vector<PagedMemory::SharedPage> pages;
+
+  /// \brief Writes the snapshot to \p filename.
+  void save(const std::string &filename) const;
+
+  /// \brief Reads a snapshot written by save().
+  static Snapshot load(const std::string &filename);
+};
+
+#endif // SNAPSHOT_H
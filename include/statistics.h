@@ -0,0 +1,89 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include "decoder.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+
+/// \brief Counts what the guest executed.
+///
+/// Engines report each retired instruction by opcode, and the outcome of each
+/// conditional branch by PC. Load and store byte counts are derived from the
+/// opcode counts and the access sizes in the instruction table, so retiring
+/// an instruction costs a single increment.
+///
+/// Statistics are optional: engines hold a pointer that is null when they are
+/// disabled, so the disabled cost is one well-predicted branch.
+class Statistics {
+public:
+  struct BranchCounts {
+    unsigned long taken = 0;
+    unsigned long not_taken = 0;
+  };
+
+  Statistics();
+
+  /// \brief Records one retired instruction.
+  void retire(RISC::Opcode opcode) {
+    opcode_counts[static_cast<unsigned int>(opcode)]++;
+  }
+
+  /// \brief Records the outcome of the conditional branch at \p pc.
+  void branch(uint32_t pc, bool taken) {
+    BranchCounts &counts = branches[pc];
+    if (taken) {
+      counts.taken++;
+    } else {
+      counts.not_taken++;
+    }
+  }
+
+  /// \brief Records an instruction that retired at \p pc. \p taken is the
+  /// outcome of a conditional branch and is ignored for other instructions.
+  void retire(RISC::Opcode opcode, uint32_t pc, bool taken) {
+    retire(opcode);
+    if (is_branch[static_cast<unsigned int>(opcode)]) {
+      branch(pc, taken);
+    }
+  }
+
+  /// \brief Records \p count instructions retired in sequence, the last at
+  /// \p last_pc with branch outcome \p taken.
+  void retire(const RISC::Opcode *opcodes, unsigned int count,
+              uint32_t last_pc, bool taken);
+
+  /// \brief Restarts the wall clock and clears the counts.
+  void reset();
+
+  unsigned long retired() const;
+  unsigned long count(RISC::Opcode opcode) const {
+    return opcode_counts[static_cast<unsigned int>(opcode)];
+  }
+  const std::unordered_map<uint32_t, BranchCounts> &branchCounts() const {
+    return branches;
+  }
+
+  /// \brief Seconds of host time since construction or reset().
+  double wallTime() const;
+
+  /// \brief Prints the statistics as a human-readable report.
+  void print(std::ostream &out) const;
+
+  /// \brief Writes the statistics as a JSON object.
+  void writeJson(std::ostream &out) const;
+
+private:
+  unsigned long opcode_counts[static_cast<unsigned int>(RISC::Opcode::Count)];
+  bool is_branch[static_cast<unsigned int>(RISC::Opcode::Count)];
+  std::unordered_map<uint32_t, BranchCounts> branches;
+  std::chrono::steady_clock::time_point start;
+
+  // Counts and bytes of the loads, or of the stores
+  void memoryTotals(bool stores, unsigned long &count,
+                    unsigned long &bytes) const;
+};
+
+#endif // STATISTICS_H
@@ -0,0 +1,175 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// \brief What one retired instruction did.
+struct TraceRecord {
+  uint32_t pc;
+  uint32_t raw;
+  // The value written to rd; only meaningful when rd is not 0
+  uint32_t rd_value;
+  uint32_t mem_address;
+  // The bytes loaded or stored, zero-extended
+  uint32_t mem_value;
+  // 0 when the instruction writes no register
+  uint8_t rd;
+  // Bytes accessed, or 0 when the instruction does not access memory
+  uint8_t mem_size;
+  bool is_store;
+};
+
+/// \brief A half-open range [begin, end) of PCs to trace.
+struct TraceRange {
+  uint32_t begin;
+  uint32_t end;
+};
+
+/// \brief A lock-free ring of trace records between exactly one producer
+/// thread and one consumer thread.
+///
+/// Each side keeps a private copy of the other side's index and only reloads
+/// the shared one when its copy says the ring is full or empty, so in the
+/// steady state a push is a store of the record and a release store of the
+/// head.
+class TraceBuffer {
+public:
+  /// \brief Creates a ring of 2^\p capacity_bits records.
+  explicit TraceBuffer(unsigned int capacity_bits = 16);
+
+  /// \returns False if the ring is full.
+  bool tryPush(const TraceRecord &record) {
+    size_t current = head.load(std::memory_order_relaxed);
+    if (current - cached_tail > mask) {
+      cached_tail = tail.load(std::memory_order_acquire);
+      if (current - cached_tail > mask) {
+        return false;
+      }
+    }
+    records[current & mask] = record;
+    head.store(current + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// \brief Moves up to \p max records into \p out.
+  /// \returns The number of records moved.
+  size_t pop(TraceRecord *out, size_t max);
+
+private:
+  std::unique_ptr<TraceRecord[]> records;
+  size_t mask;
+
+  // Written by the producer. The padding keeps the two sides' indices on
+  // separate cache lines.
+  std::atomic<size_t> head;
+  size_t cached_tail;
+  char producer_padding[64];
+  // Written by the consumer
+  std::atomic<size_t> tail;
+  size_t cached_head;
+};
+
+// Compresses and decompresses the encoded records
+class TraceDeflater;
+class TraceInflater;
+
+/// \brief Records retired instructions to a trace file.
+///
+/// The simulation thread only filters by PC and pushes fixed-size records
+/// into a TraceBuffer. A background thread drains the buffer, encodes the
+/// records and writes them out, so the cost on the simulation thread does not
+/// depend on the file. If the writer falls behind, the simulation waits for
+/// it rather than dropping records.
+///
+/// Records are delta-encoded against the previous record: the PC is only
+/// stored when it is not the previous PC plus 4, the instruction word only
+/// when it differs from the last word seen at that PC, register values as
+/// the difference from the register's previous value, and memory addresses
+/// as the difference from the previous access, all as variable-length
+/// integers. When rv32sim is built with zlib, the encoded stream is then
+/// compressed, which finds the repetition in loops that the deltas leave; a
+/// byte after the version says whether it was. TraceReader reverses both
+/// steps, and also reads the uncompressed version 1 files.
+class TraceWriter {
+public:
+  static const uint32_t VERSION = 2;
+
+  /// \brief Traces to \p filename the instructions retired at a PC inside
+  /// one of \p ranges, or all of them if \p ranges is empty.
+  TraceWriter(const std::string &filename,
+              const std::vector<TraceRange> &ranges = {});
+  ~TraceWriter();
+
+  TraceWriter(const TraceWriter &) = delete;
+  TraceWriter &operator=(const TraceWriter &) = delete;
+
+  /// \returns True if instructions at \p pc should be traced.
+  bool covers(uint32_t pc) const {
+    if (ranges.empty()) {
+      return true;
+    }
+    for (const TraceRange &range : ranges) {
+      if (pc >= range.begin && pc < range.end) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// \brief Queues \p record for writing.
+  void record(const TraceRecord &record) {
+    if (!buffer.tryPush(record)) {
+      waitAndPush(record);
+    }
+  }
+
+  /// \brief Writes every queued record and closes the file. Called by the
+  /// destructor.
+  void close();
+
+private:
+  std::vector<TraceRange> ranges;
+  TraceBuffer buffer;
+  std::ofstream file;
+  // Used by the writer thread only; null without zlib
+  std::shared_ptr<TraceDeflater> p_deflater;
+  std::atomic<bool> stopping;
+  std::thread writer;
+
+  void waitAndPush(const TraceRecord &record);
+  void drain();
+};
+
+// The state records are delta-encoded against
+class TraceCodec;
+
+/// \brief Reads back the records of a file written by TraceWriter.
+class TraceReader {
+public:
+  /// \brief Opens \p filename and checks its header.
+  explicit TraceReader(const std::string &filename);
+
+  /// \brief Reads the next record into \p record.
+  /// \returns False at the end of the trace.
+  bool next(TraceRecord &record);
+
+private:
+  std::ifstream file;
+  std::string filename;
+  // Null for an uncompressed trace
+  std::shared_ptr<TraceInflater> p_inflater;
+  // Mirrors the encoder's state
+  std::shared_ptr<TraceCodec> p_codec;
+
+  // The next decompressed byte, or EOF at the end of the trace
+  int readByte();
+  uint32_t readVarint();
+};
+
+#endif // TRACE_H
@@ -1,52 +1,58 @@
 #include "alu.h"
 
-std::bitset<32> ALU::hardwareNor(std::bitset<32> val1, std::bitset<32> val2) {
+std::bitset<32> GateLevelALU::hardwareNor(std::bitset<32> val1,
+                                          std::bitset<32> val2) {
   return ~(val1 | val2);
 }
 
-std::bitset<32> ALU::hardwareLeftShift(std::bitset<32> val,
-                                       std::bitset<32> shamt) {
+std::bitset<32> GateLevelALU::hardwareLeftShift(std::bitset<32> val,
+                                                std::bitset<32> shamt) {
   return val << shamt.to_ulong();
 }
 
-std::bitset<32> ALU::hardwareRightShift(std::bitset<32> val,
-                                        std::bitset<32> shamt) {
+std::bitset<32> GateLevelALU::hardwareRightShift(std::bitset<32> val,
+                                                 std::bitset<32> shamt) {
   return val >> shamt.to_ulong();
 }
 
-bool ALU::hardwareIsEqual(std::bitset<32> val1, std::bitset<32> val2) {
+bool GateLevelALU::hardwareIsEqual(std::bitset<32> val1, std::bitset<32> val2) {
   return val1 == val2;
 }
 
-std::bitset<32> ALU::bitwiseNot(std::bitset<32> val1) {
+std::bitset<32> GateLevelALU::bitwiseNot(std::bitset<32> val1) {
   return hardwareNor(val1, val1);
 }
 
-std::bitset<32> ALU::negate(std::bitset<32> val) {
+std::bitset<32> GateLevelALU::negate(std::bitset<32> val) {
   return add(bitwiseNot(val), ONE);
 }
 
-std::bitset<32> ALU::bitwiseOr(std::bitset<32> val1, std::bitset<32> val2) {
+std::bitset<32> GateLevelALU::bitwiseOr(std::bitset<32> val1,
+                                        std::bitset<32> val2) {
   return bitwiseNot(hardwareNor(val1, val2));
 }
 
-std::bitset<32> ALU::bitwiseAnd(std::bitset<32> val1, std::bitset<32> val2) {
+std::bitset<32> GateLevelALU::bitwiseAnd(std::bitset<32> val1,
+                                         std::bitset<32> val2) {
   return hardwareNor(bitwiseNot(val1), bitwiseNot(val2));
 }
 
-std::bitset<32> ALU::bitwiseNand(std::bitset<32> val1, std::bitset<32> val2) {
+std::bitset<32> GateLevelALU::bitwiseNand(std::bitset<32> val1,
+                                          std::bitset<32> val2) {
   return bitwiseNot(bitwiseAnd(val1, val2));
 }
 
-std::bitset<32> ALU::bitwiseXor(std::bitset<32> val1, std::bitset<32> val2) {
+std::bitset<32> GateLevelALU::bitwiseXor(std::bitset<32> val1,
+                                         std::bitset<32> val2) {
   return bitwiseAnd(bitwiseOr(val1, val2), bitwiseNand(val1, val2));
 }
 
-std::bitset<32> ALU::bitwiseXnor(std::bitset<32> val1, std::bitset<32> val2) {
+std::bitset<32> GateLevelALU::bitwiseXnor(std::bitset<32> val1,
+                                          std::bitset<32> val2) {
   return bitwiseNot(bitwiseXor(val1, val2));
 }
 
-std::bitset<32> ALU::add(std::bitset<32> val1, std::bitset<32> val2) {
+std::bitset<32> GateLevelALU::add(std::bitset<32> val1, std::bitset<32> val2) {
   std::bitset<32> preadd = bitwiseXor(val1, val2);
   std::bitset<32> carries = bitwiseAnd(val1, val2);
   std::bitset<32> carries_shifted = hardwareLeftShift(carries, ONE);
@@ -59,7 +65,8 @@ std::bitset<32> ALU::add(std::bitset<32> val1, std::bitset<32> val2) {
   return add(preadd, carries_shifted);
 }
 
-bool ALU::lessThanUnsigned(std::bitset<32> val1, std::bitset<32> val2) {
+bool GateLevelALU::lessThanUnsigned(std::bitset<32> val1,
+                                    std::bitset<32> val2) {
   if (hardwareIsEqual(val1, val2)) {
     return false;
   }
@@ -88,7 +95,7 @@ bool ALU::lessThanUnsigned(std::bitset<32> val1, std::bitset<32> val2) {
   return lessThanUnsigned(val1_advanced, val2_advanced);
 }
 
-bool ALU::lessThanSigned(std::bitset<32> val1, std::bitset<32> val2) {
+bool GateLevelALU::lessThanSigned(std::bitset<32> val1, std::bitset<32> val2) {
   std::bitset<32> highest_bit_val1 = hardwareRightShift(val1, THIRTY_ONE);
   std::bitset<32> highest_bit_val2 = hardwareRightShift(val2, THIRTY_ONE);
 
@@ -113,7 +120,8 @@ bool ALU::lessThanSigned(std::bitset<32> val1, std::bitset<32> val2) {
   return lessThanUnsigned(val1_advanced, val2_advanced);
 }
 
-bool ALU::greaterThanEqualUnsigned(std::bitset<32> val1, std::bitset<32> val2) {
+bool GateLevelALU::greaterThanEqualUnsigned(std::bitset<32> val1,
+                                            std::bitset<32> val2) {
   if (hardwareIsEqual(val1, val2)) {
     return true;
   }
@@ -142,7 +150,8 @@ bool ALU::greaterThanEqualUnsigned(std::bitset<32> val1, std::bitset<32> val2) {
   return greaterThanEqualUnsigned(val1_advanced, val2_advanced);
 }
 
-bool ALU::greaterThanEqualSigned(std::bitset<32> val1, std::bitset<32> val2) {
+bool GateLevelALU::greaterThanEqualSigned(std::bitset<32> val1,
+                                          std::bitset<32> val2) {
   std::bitset<32> highest_bit_val1 = hardwareRightShift(val1, THIRTY_ONE);
   std::bitset<32> highest_bit_val2 = hardwareRightShift(val2, THIRTY_ONE);
 
@@ -167,8 +176,8 @@ bool ALU::greaterThanEqualSigned(std::bitset<32> val1, std::bitset<32> val2) {
   return greaterThanEqualUnsigned(val1_advanced, val2_advanced);
 }
 
-std::bitset<32> ALU::arithmeticRightShift(std::bitset<32> val,
-                                          std::bitset<32> shamt) {
+std::bitset<32> GateLevelALU::arithmeticRightShift(std::bitset<32> val,
+                                                   std::bitset<32> shamt) {
   std::bitset<32> shamt_upper_27 =
       hardwareRightShift(shamt, std::bitset<32>(5));
 
@@ -194,6 +203,6 @@ std::bitset<32> ALU::arithmeticRightShift(std::bitset<32> val,
   return arithmeticRightShift(shifted_val, shamt_minus_one);
 }
 
-std::bitset<32> ALU::maskLowFive(std::bitset<32> val) {
+std::bitset<32> GateLevelALU::maskLowFive(std::bitset<32> val) {
   return hardwareRightShift(hardwareLeftShift(val, TWENTY_SEVEN), TWENTY_SEVEN);
 }
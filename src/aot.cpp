@@ -0,0 +1,407 @@
+#include "decoder.h"
+#include "elffile.h"
+#include "imagecache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Translates the code of a guest binary ahead of time into C++ source, with
+// one function per basic block and a switch over block addresses that
+// dispatches every jump, direct or indirect. Compiled with the simulator's
+// include directory and linked against cpu_lib, the source becomes an
+// executable that runs the binary through aotMain (see aotruntime.h):
+//   rv32sim_aot bench.bin bench_aot.cpp
+//   c++ -O2 -std=c++14 -Iinclude bench_aot.cpp -Lbuild -lcpu_lib -lpthread
+// rv32sim_add_aot() in CMakeLists.txt does both steps.
+//
+// The code of a flat binary is taken to be all of it, and that of an ELF
+// file its executable segments. Words that do not decode, ecall and ebreak
+// are left to the interpreter, as are jumps to addresses that start no
+// block.
+
+namespace {
+
+const unsigned int MAX_BLOCK_LENGTH = 64;
+
+// Instruction words loaded at an address
+struct Text {
+  uint32_t address;
+  std::vector<uint32_t> words;
+  // Classified in one pass when the text is added
+  std::vector<RISC::Opcode> opcodes;
+};
+
+struct Block {
+  uint32_t pc;
+  std::vector<RISC::DecodedInstruction> code;
+};
+
+bool isTranslatable(RISC::Opcode opcode) {
+  return opcode != RISC::Opcode::Illegal && opcode != RISC::Opcode::Ecall &&
+         opcode != RISC::Opcode::Ebreak;
+}
+
+bool isBranch(RISC::Opcode opcode) {
+  return opcode >= RISC::Opcode::BranchEqual &&
+         opcode <= RISC::Opcode::BranchGreaterThanEqualUnsigned;
+}
+
+std::string hex(uint32_t value) {
+  std::ostringstream out;
+  out << "0x" << std::hex << std::setfill('0') << std::setw(8) << value
+      << "u";
+  return out.str();
+}
+
+std::string blockName(const char *prefix, uint32_t pc) {
+  std::ostringstream out;
+  out << prefix << std::hex << std::setfill('0') << std::setw(8) << pc;
+  return out.str();
+}
+
+// \p text as a C++ string literal
+std::string quote(const std::string &text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+std::string reg(unsigned int r) { return "s.x[" + std::to_string(r) + "]"; }
+
+void addText(std::vector<Text> &texts, const uint8_t *data, size_t size,
+             uint32_t address) {
+  Text text;
+  text.address = address;
+  for (size_t offset = 0; offset + 4 <= size; offset += 4) {
+    uint32_t word;
+    std::memcpy(&word, data + offset, 4);
+    text.words.push_back(word);
+  }
+  text.opcodes.resize(text.words.size());
+  RISC::classifyInstructions(text.words.data(), text.words.size(),
+                             text.opcodes.data());
+  texts.push_back(text);
+}
+
+bool inText(const std::vector<Text> &texts, uint32_t address) {
+  for (const Text &text : texts) {
+    if (address >= text.address && (address & 3) == 0 &&
+        (address - text.address) / 4 < text.words.size()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Blocks start at the entry point, at symbols, at the targets of branches
+// and direct jumps, and after control transfers and untranslated words
+std::set<uint32_t> findLeaders(const std::vector<Text> &texts,
+                               uint32_t entry, const ElfFile *p_elf) {
+  std::set<uint32_t> leaders;
+  leaders.insert(entry);
+  if (p_elf != nullptr) {
+    for (const ElfSymbol &symbol : p_elf->symbols()) {
+      if (inText(texts, symbol.address)) {
+        leaders.insert(symbol.address);
+      }
+    }
+  }
+
+  for (const Text &text : texts) {
+    leaders.insert(text.address);
+    for (size_t i = 0; i < text.words.size(); i++) {
+      uint32_t pc = text.address + 4 * static_cast<uint32_t>(i);
+      RISC::DecodedInstruction decoded =
+          RISC::decodeInstruction(text.words[i], text.opcodes[i]);
+      if (isBranch(decoded.opcode) ||
+          decoded.opcode == RISC::Opcode::JumpAndLink) {
+        if (inText(texts, pc + decoded.imm)) {
+          leaders.insert(pc + decoded.imm);
+        }
+      }
+      if (!isTranslatable(decoded.opcode) || RISC::endsBlock(decoded.opcode)) {
+        leaders.insert(pc + 4);
+      }
+    }
+  }
+  return leaders;
+}
+
+std::vector<Block> findBlocks(const std::vector<Text> &texts,
+                              const std::set<uint32_t> &leaders) {
+  std::vector<Block> blocks;
+  for (const Text &text : texts) {
+    bool open = false;
+    for (size_t i = 0; i < text.words.size(); i++) {
+      uint32_t pc = text.address + 4 * static_cast<uint32_t>(i);
+      RISC::DecodedInstruction decoded =
+          RISC::decodeInstruction(text.words[i], text.opcodes[i]);
+      if (!isTranslatable(decoded.opcode)) {
+        open = false;
+        continue;
+      }
+      if (!open || leaders.count(pc) != 0 ||
+          blocks.back().code.size() == MAX_BLOCK_LENGTH) {
+        blocks.push_back({pc, {}});
+        open = true;
+      }
+      blocks.back().code.push_back(decoded);
+      if (RISC::endsBlock(decoded.opcode)) {
+        open = false;
+      }
+    }
+  }
+  return blocks;
+}
+
+/*
+=========================
+    Code Generation
+=========================
+*/
+
+std::string binary(const RISC::DecodedInstruction &d, const char *op) {
+  return reg(d.rs1) + " " + op + " " + reg(d.rs2);
+}
+
+std::string immediate(const RISC::DecodedInstruction &d, const char *op) {
+  return reg(d.rs1) + " " + op + " " + hex(d.imm);
+}
+
+std::string load(const RISC::DecodedInstruction &d, unsigned int size,
+                 bool sign_extend) {
+  return "s.p_memory->readBytes(" + reg(d.rs1) + " + " + hex(d.imm) + ", " +
+         std::to_string(size) + (sign_extend ? ", true" : "") +
+         ").to_ulong()";
+}
+
+// The value an instruction writes to rd, or empty if it writes none
+std::string result(const RISC::DecodedInstruction &d, uint32_t pc) {
+  switch (d.opcode) {
+  case RISC::Opcode::Add:
+    return binary(d, "+");
+  case RISC::Opcode::Sub:
+    return binary(d, "-");
+  case RISC::Opcode::Xor:
+    return binary(d, "^");
+  case RISC::Opcode::Or:
+    return binary(d, "|");
+  case RISC::Opcode::And:
+    return binary(d, "&");
+  case RISC::Opcode::ShiftLeftLogi:
+    return reg(d.rs1) + " << (" + reg(d.rs2) + " & 0x1F)";
+  case RISC::Opcode::ShiftRightLogi:
+    return reg(d.rs1) + " >> (" + reg(d.rs2) + " & 0x1F)";
+  case RISC::Opcode::ShiftRightArith:
+    return "NativeALU::arithmeticRightShift(" + reg(d.rs1) + ", " +
+           reg(d.rs2) + " & 0x1F)";
+  case RISC::Opcode::SetLessThan:
+    return "NativeALU::lessThanSigned(" + reg(d.rs1) + ", " + reg(d.rs2) +
+           ")";
+  case RISC::Opcode::SetLessThanUnsigned:
+    return binary(d, "<");
+  case RISC::Opcode::AddImm:
+    return immediate(d, "+");
+  case RISC::Opcode::XorImm:
+    return immediate(d, "^");
+  case RISC::Opcode::OrImm:
+    return immediate(d, "|");
+  case RISC::Opcode::AndImm:
+    return immediate(d, "&");
+  case RISC::Opcode::ShiftLeftLogiImm:
+    return reg(d.rs1) + " << " + std::to_string(d.imm & 0x1F);
+  case RISC::Opcode::ShiftRightLogiImm:
+    return reg(d.rs1) + " >> " + std::to_string(d.imm & 0x1F);
+  case RISC::Opcode::ShiftRightArithImm:
+    return "NativeALU::arithmeticRightShift(" + reg(d.rs1) + ", " +
+           std::to_string(d.imm & 0x1F) + "u)";
+  case RISC::Opcode::SetLessThanImm:
+    return "NativeALU::lessThanSigned(" + reg(d.rs1) + ", " + hex(d.imm) +
+           ")";
+  case RISC::Opcode::SetLessThanImmUnsigned:
+    return immediate(d, "<");
+  case RISC::Opcode::LoadWord:
+    return load(d, 4, false);
+  case RISC::Opcode::LoadHalfWord:
+    return load(d, 2, true);
+  case RISC::Opcode::LoadByte:
+    return load(d, 1, true);
+  case RISC::Opcode::LoadUnsignedHalfWord:
+    return load(d, 2, false);
+  case RISC::Opcode::LoadUnsignedByte:
+    return load(d, 1, false);
+  case RISC::Opcode::LoadUpperImmediate:
+    return hex(d.imm);
+  case RISC::Opcode::AddUpperImmedateToPC:
+    return hex(pc + d.imm);
+  case RISC::Opcode::JumpAndLink:
+  case RISC::Opcode::JumpAndLinkReg:
+    return hex(pc + 4);
+  default:
+    return "";
+  }
+}
+
+std::string branchCondition(const RISC::DecodedInstruction &d) {
+  switch (d.opcode) {
+  case RISC::Opcode::BranchEqual:
+    return binary(d, "==");
+  case RISC::Opcode::BranchNotEqual:
+    return binary(d, "!=");
+  case RISC::Opcode::BranchLessThan:
+    return "NativeALU::lessThanSigned(" + reg(d.rs1) + ", " + reg(d.rs2) +
+           ")";
+  case RISC::Opcode::BranchGreaterThanEqual:
+    return "!NativeALU::lessThanSigned(" + reg(d.rs1) + ", " + reg(d.rs2) +
+           ")";
+  case RISC::Opcode::BranchLessThanUnsigned:
+    return binary(d, "<");
+  default:
+    return binary(d, ">=");
+  }
+}
+
+void writeBlock(std::ostream &out, const Block &block) {
+  out << "const uint32_t " << blockName("words_", block.pc) << "[] = {";
+  for (size_t i = 0; i < block.code.size(); i++) {
+    out << (i % 6 == 0 ? "\n    " : " ") << hex(block.code[i].raw) << ",";
+  }
+  out << "};\n\n";
+
+  out << "uint32_t " << blockName("block_", block.pc) << "(AotState &s) {\n";
+  for (size_t i = 0; i < block.code.size(); i++) {
+    const RISC::DecodedInstruction &d = block.code[i];
+    uint32_t pc = block.pc + 4 * static_cast<uint32_t>(i);
+    out << "  // " << std::hex << std::setfill('0') << std::setw(8) << pc
+        << std::dec << ": " << RISC::disassemble(d.raw, pc) << "\n";
+
+    if (d.opcode == RISC::Opcode::JumpAndLinkReg) {
+      // The target is read before rd is written, as rd may be rs1
+      out << "  uint32_t target = " << immediate(d, "+") << ";\n";
+    }
+    std::string value = result(d, pc);
+    bool has_rd = RISC::instructionInfo(d.opcode).syntax !=
+                  RISC::Syntax::Store;
+    if (!value.empty() && has_rd && d.rd != 0) {
+      out << "  " << reg(d.rd) << " = " << value << ";\n";
+    }
+
+    if (RISC::instructionInfo(d.opcode).syntax == RISC::Syntax::Store) {
+      unsigned int size = RISC::instructionInfo(d.opcode).access_size;
+      out << "  s.p_memory->writeBytes(" << immediate(d, "+") << ", "
+          << reg(d.rs2) << ", " << size << ");\n";
+      if (i + 1 < block.code.size()) {
+        // Run what the store wrote, not what was translated
+        out << "  if (s.code_modified) {\n"
+            << "    s.completed = " << i + 1 << ";\n"
+            << "    return " << hex(pc + 4) << ";\n"
+            << "  }\n";
+      }
+    } else if (isBranch(d.opcode)) {
+      out << "  return " << branchCondition(d) << " ? " << hex(pc + d.imm)
+          << " : " << hex(pc + 4) << ";\n";
+    } else if (d.opcode == RISC::Opcode::JumpAndLink) {
+      out << "  return " << hex(pc + d.imm) << ";\n";
+    } else if (d.opcode == RISC::Opcode::JumpAndLinkReg) {
+      out << "  return target;\n";
+    }
+  }
+  const RISC::DecodedInstruction &last = block.code.back();
+  if (!RISC::endsBlock(last.opcode)) {
+    uint32_t next = block.pc + 4 * static_cast<uint32_t>(block.code.size());
+    out << "  return " << hex(next) << ";\n";
+  }
+  out << "}\n\n";
+}
+
+void writeProgram(std::ostream &out, const std::string &source,
+                  const std::vector<Block> &blocks) {
+  out << "// Translated from " << source << " by rv32sim_aot.\n"
+      << "\n"
+      << "#include \"aotruntime.h\"\n"
+      << "#include \"nativealu.hpp\"\n"
+      << "\n"
+      << "namespace {\n"
+      << "\n";
+  for (const Block &block : blocks) {
+    writeBlock(out, block);
+  }
+
+  out << "AotBlock lookup(uint32_t pc) {\n"
+      << "  switch (pc) {\n";
+  for (size_t i = 0; i < blocks.size(); i++) {
+    out << "  case " << hex(blocks[i].pc) << ":\n"
+        << "    return {" << blockName("block_", blocks[i].pc) << ", "
+        << blockName("words_", blocks[i].pc) << ", "
+        << blocks[i].code.size() << ", " << i << "};\n";
+  }
+  out << "  default:\n"
+      << "    return {nullptr, nullptr, 0, 0};\n"
+      << "  }\n"
+      << "}\n"
+      << "\n"
+      << "} // namespace\n"
+      << "\n"
+      << "int main(int argc, char **argv) {\n"
+      << "  const AotProgram program = {" << quote(source) << ", "
+      << blocks.size() << ", lookup};\n"
+      << "  return aotMain(argc, argv, program);\n"
+      << "}\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <bin_file> <output_file>"
+              << std::endl;
+    return 1;
+  }
+  std::string bin_file = argv[1];
+
+  std::vector<Text> texts;
+  std::set<uint32_t> leaders;
+  try {
+    std::shared_ptr<const MappedFile> p_image =
+        ImageCache::instance().open(bin_file);
+    if (!p_image->isOpen()) {
+      throw std::runtime_error("Could not open file: " + bin_file);
+    }
+    if (ElfFile::isElf(*p_image)) {
+      ElfFile elf(bin_file, p_image);
+      for (const ElfSegment &segment : elf.segments()) {
+        if (segment.executable) {
+          addText(texts, p_image->data() + segment.file_offset,
+                  segment.file_size, segment.address);
+        }
+      }
+      leaders = findLeaders(texts, elf.entry(), &elf);
+    } else {
+      addText(texts, p_image->data(), p_image->size(), 0);
+      leaders = findLeaders(texts, 0, nullptr);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  std::vector<Block> blocks = findBlocks(texts, leaders);
+  std::ofstream file(argv[2]);
+  if (!file.is_open()) {
+    std::cerr << "Error: could not open file " << argv[2] << std::endl;
+    return 1;
+  }
+  writeProgram(file, bin_file, blocks);
+  return 0;
+}
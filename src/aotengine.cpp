@@ -0,0 +1,141 @@
+#include "aotengine.h"
+
+#include <algorithm>
+
+AotEngine::AotEngine(std::shared_ptr<InstructionFile> _p_instruction_file,
+                     std::shared_ptr<MemoryFile> _p_data_file,
+                     const AotProgram &_program)
+    : p_instruction_file(_p_instruction_file), p_data_file(_p_data_file),
+      translated_program(_program),
+      interpreter(_p_instruction_file, _p_data_file),
+      statuses(_program.block_count, UNCHECKED) {
+  state.code_modified = false;
+}
+
+bool AotEngine::run(uint32_t &pc, uint32_t *registers,
+                    unsigned long &retired, unsigned long budget,
+                    bool ignore_breakpoint) {
+  std::copy(registers, registers + 32, state.x);
+  state.x[0] = 0;
+  state.p_memory = p_data_file.get();
+  state.code_modified = false;
+
+  uint32_t current = pc;
+  bool at_breakpoint = false;
+  try {
+    bool first = true;
+    while (budget > 0) {
+      if (!breakpoints.empty() && !(ignore_breakpoint && first) &&
+          breakpoints.count(current) != 0) {
+        at_breakpoint = true;
+        break;
+      }
+      first = false;
+
+      AotBlock block = translated_program.lookup(current);
+      if (block.run != nullptr && block.length <= budget &&
+          usable(current, block)) {
+        state.completed = block.length;
+        current = block.run(state);
+        retired += state.completed;
+        budget -= state.completed;
+      } else {
+        unsigned long before = retired;
+        interpret(current, retired, budget);
+        budget -= retired - before;
+      }
+
+      if (state.code_modified) {
+        flush();
+      }
+    }
+  } catch (...) {
+    pc = current;
+    std::copy(state.x, state.x + 32, registers);
+    if (state.code_modified) {
+      flush();
+    }
+    throw;
+  }
+
+  pc = current;
+  std::copy(state.x, state.x + 32, registers);
+  return at_breakpoint;
+}
+
+bool AotEngine::usable(uint32_t pc, const AotBlock &block) {
+  uint8_t &status = statuses[block.index];
+  if (status != UNCHECKED) {
+    return status == USABLE;
+  }
+
+  uint32_t end = pc + 4 * block.length;
+  // Watch the block whether or not it matches, so that a store that makes
+  // it match is noticed
+  watch(pc, end);
+  status = USABLE;
+  if (breakpoints.upper_bound(pc) != breakpoints.end() &&
+      *breakpoints.upper_bound(pc) < end) {
+    status = UNUSABLE;
+    return false;
+  }
+  for (unsigned int i = 0; i < block.length; i++) {
+    try {
+      if (p_instruction_file->read(pc + 4 * i).to_ulong() != block.words[i]) {
+        status = UNUSABLE;
+        break;
+      }
+    } catch (const std::exception &) {
+      status = UNUSABLE;
+      break;
+    }
+  }
+  return status == USABLE;
+}
+
+void AotEngine::interpret(uint32_t &pc, unsigned long &retired,
+                          unsigned long budget) {
+  const BlockEngine::Block &block = interpreter.block(pc);
+  if (interpreted.insert(pc).second) {
+    // The block and the word that ends it
+    watch(pc, block.ops.back().pc + 4);
+  }
+  // A block that traps on its first word still has to run to raise it
+  unsigned long count =
+      std::min<unsigned long>(budget, std::max(block.length, 1u));
+  interpreter.run(pc, state.x, retired, count, true);
+}
+
+void AotEngine::flush() {
+  std::fill(statuses.begin(), statuses.end(), UNCHECKED);
+  interpreted.clear();
+  code_words.clear();
+  interpreter.flush();
+  watch_begin = ~0u;
+  watch_end = 0;
+  state.code_modified = false;
+}
+
+void AotEngine::setBreakpoints(const std::set<uint32_t> &_breakpoints) {
+  breakpoints = _breakpoints;
+  interpreter.setBreakpoints(breakpoints);
+  flush();
+}
+
+void AotEngine::watch(uint32_t begin, uint32_t end) {
+  for (uint32_t address = begin; address != end; address += 4) {
+    code_words.insert(address >> 2);
+  }
+  watch_begin = std::min(watch_begin, begin);
+  watch_end = std::max(watch_end, end);
+}
+
+void AotEngine::onWrite(uint32_t address, unsigned int n) {
+  if (code_words.count(address >> 2) == 0 &&
+      code_words.count((address + n - 1) >> 2) == 0) {
+    return;
+  }
+  state.code_modified = true;
+  // Ends the block the BlockEngine is running, if any
+  interpreter.onWrite(address, n);
+}
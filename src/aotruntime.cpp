@@ -0,0 +1,76 @@
+#include "aotruntime.h"
+#include "controlunit.h"
+#include "options.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+int aotMain(int argc, char **argv, const AotProgram &program) {
+  std::string bin_file = program.source;
+  std::string signature_file = "DUT-rv32sim.signature";
+  std::string save_snapshot;
+  unsigned long max_instructions = ControlUnit::UNLIMITED;
+  bool translated = true;
+  bool has_bin_file = false;
+
+  bool usage = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 12, "--signature=") == 0) {
+      signature_file = arg.substr(12);
+    } else if (arg.compare(0, 19, "--max-instructions=") == 0) {
+      if (!parseCount(arg.substr(19), max_instructions)) {
+        std::cerr << "Error: bad value in " << arg << std::endl;
+        usage = true;
+        break;
+      }
+    } else if (arg.compare(0, 16, "--save-snapshot=") == 0) {
+      save_snapshot = arg.substr(16);
+    } else if (arg == "--engine=aot") {
+      translated = true;
+    } else if (arg == "--engine=block") {
+      // Runs without the translated code, for comparison
+      translated = false;
+    } else if (arg.compare(0, 2, "--") != 0 && !has_bin_file) {
+      bin_file = arg;
+      has_bin_file = true;
+    } else {
+      usage = true;
+    }
+  }
+  if (usage) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--signature=FILE] [--max-instructions=N]"
+                 " [--save-snapshot=FILE] [--engine=aot|block] [bin_file]\n"
+              << "Translated from " << program.source << std::endl;
+    return 1;
+  }
+
+  std::unique_ptr<ControlUnit> p_cu;
+  try {
+    p_cu.reset(new ControlUnit(bin_file));
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  ControlUnit &cu = *p_cu;
+  if (translated) {
+    cu.setAotProgram(program);
+  } else {
+    cu.setEngine(Engine::Block);
+  }
+  cu.setCycleLimit(max_instructions);
+
+  int exit_code = cu.exitCode(cu.runProgram(signature_file), std::cerr);
+
+  if (!save_snapshot.empty()) {
+    try {
+      cu.snapshot().save(save_snapshot);
+    } catch (const std::exception &e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+    }
+  }
+  return exit_code;
+}
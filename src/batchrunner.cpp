@@ -0,0 +1,256 @@
+#include "batchrunner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <thread>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+bool isDirectory(const std::string &path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+bool endsWith(const std::string &text, const std::string &suffix) {
+  return text.size() >= suffix.size() &&
+         text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void findBinaries(const std::string &directory,
+                  std::vector<std::string> &binaries) {
+  DIR *p_dir = opendir(directory.c_str());
+  if (p_dir == nullptr) {
+    throw std::runtime_error("Could not open directory: " + directory);
+  }
+  while (dirent *p_entry = readdir(p_dir)) {
+    std::string name = p_entry->d_name;
+    if (name == "." || name == "..") {
+      continue;
+    }
+    std::string path = directory + "/" + name;
+    if (isDirectory(path)) {
+      findBinaries(path, binaries);
+    } else if (endsWith(name, ".bin") || endsWith(name, ".elf")) {
+      binaries.push_back(path);
+    }
+  }
+  closedir(p_dir);
+}
+
+const char *reasonName(StopReason reason) {
+  switch (reason) {
+  case StopReason::Budget:
+    return "budget";
+  case StopReason::Ecall:
+    return "ecall";
+  case StopReason::Ebreak:
+    return "ebreak";
+  case StopReason::Breakpoint:
+    return "breakpoint";
+  case StopReason::CycleLimit:
+    return "instruction limit";
+  case StopReason::Deadline:
+    return "timeout";
+  case StopReason::Error:
+    return "error";
+  }
+  return "unknown";
+}
+
+// Escapes \p text for use inside a JSON string, including the control
+// characters U+0000 to U+001F
+std::string jsonEscape(const std::string &text) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  std::string escaped;
+  for (char c : text) {
+    unsigned char byte = static_cast<unsigned char>(c);
+    switch (c) {
+    case '"':
+      escaped += "\\\"";
+      break;
+    case '\\':
+      escaped += "\\\\";
+      break;
+    case '\n':
+      escaped += "\\n";
+      break;
+    case '\r':
+      escaped += "\\r";
+      break;
+    case '\t':
+      escaped += "\\t";
+      break;
+    default:
+      if (byte < 0x20) {
+        escaped += "\\u00";
+        escaped += HEX_DIGITS[byte >> 4];
+        escaped += HEX_DIGITS[byte & 0xF];
+      } else {
+        escaped += c;
+      }
+      break;
+    }
+  }
+  return escaped;
+}
+
+} // namespace
+
+std::vector<std::string>
+BatchRunner::collectBinaries(const std::vector<std::string> &paths) {
+  std::vector<std::string> binaries;
+  for (const std::string &path : paths) {
+    if (!isDirectory(path)) {
+      binaries.push_back(path);
+      continue;
+    }
+    std::vector<std::string> found;
+    findBinaries(path, found);
+    std::sort(found.begin(), found.end());
+    binaries.insert(binaries.end(), found.begin(), found.end());
+  }
+  return binaries;
+}
+
+std::vector<TestResult>
+BatchRunner::run(const std::vector<std::string> &binaries) {
+  // Signatures are written from the workers, which would only report each
+  // test failed
+  if (!options.signature_dir.empty() && !isDirectory(options.signature_dir) &&
+      mkdir(options.signature_dir.c_str(), 0777) != 0) {
+    throw std::runtime_error("Could not create signature directory: " +
+                             options.signature_dir);
+  }
+
+  std::vector<TestResult> results(binaries.size());
+  std::atomic<size_t> next(0);
+
+  unsigned int jobs = options.jobs;
+  if (jobs == 0) {
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  jobs = static_cast<unsigned int>(
+      std::min<size_t>(jobs, std::max<size_t>(1, binaries.size())));
+
+  auto work = [&]() {
+    for (size_t i = next++; i < binaries.size(); i = next++) {
+      results[i] = runTest(binaries[i]);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned int i = 1; i < jobs; i++) {
+    workers.emplace_back(work);
+  }
+  // The calling thread is a worker too
+  work();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  return results;
+}
+
+TestResult BatchRunner::runTest(const std::string &binary) const {
+  TestResult result = {binary, signaturePath(binary), false,
+                       StopReason::Error, "", 0, 0};
+  Clock::time_point start = Clock::now();
+
+  try {
+    ControlUnit cu(binary, options.backend);
+    cu.setDecodeCacheEnabled(options.decode_cache);
+    cu.setEngine(options.engine);
+    cu.setCycleLimit(options.max_instructions);
+    if (options.timeout > 0) {
+      std::chrono::duration<double> timeout(options.timeout);
+      cu.setDeadline(start +
+                     std::chrono::duration_cast<Clock::duration>(timeout));
+    }
+
+    RunResult run = cu.runProgram(result.signature);
+    result.retired = run.retired;
+    result.reason = run.reason;
+    result.message = run.message;
+    result.passed = run.reason == StopReason::Ecall;
+  } catch (const std::exception &e) {
+    result.reason = StopReason::Error;
+    result.message = e.what();
+  }
+
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return result;
+}
+
+std::string BatchRunner::signaturePath(const std::string &binary) const {
+  std::string stem = binary;
+  if (endsWith(stem, ".bin") || endsWith(stem, ".elf")) {
+    stem.resize(stem.size() - 4);
+  }
+  if (options.signature_dir.empty()) {
+    return stem + ".signature";
+  }
+
+  // Flatten the path so that tests with the same file name stay apart.
+  // Escaping '%' as well keeps two paths from flattening to the same name.
+  if (stem.compare(0, 2, "./") == 0) {
+    stem = stem.substr(2);
+  }
+  std::string flat;
+  for (char c : stem) {
+    if (c == '/') {
+      flat += "%2F";
+    } else if (c == '%') {
+      flat += "%25";
+    } else {
+      flat += c;
+    }
+  }
+  return options.signature_dir + "/" + flat + ".signature";
+}
+
+void BatchRunner::printReport(const std::vector<TestResult> &results,
+                              double seconds, std::ostream &out) {
+  unsigned int passed = 0;
+  for (const TestResult &result : results) {
+    passed += result.passed;
+    out << (result.passed ? "PASS " : "FAIL ") << result.binary << " ("
+        << result.retired << " instructions, " << result.seconds << " s)";
+    if (!result.passed) {
+      out << ": " << reasonName(result.reason);
+      if (!result.message.empty()) {
+        out << ": " << result.message;
+      }
+    }
+    out << "\n";
+  }
+  out << passed << " passed, " << results.size() - passed << " failed in "
+      << seconds << " s" << std::endl;
+}
+
+void BatchRunner::writeJson(const std::vector<TestResult> &results,
+                            double seconds, std::ostream &out) {
+  unsigned int passed = 0;
+  for (const TestResult &result : results) {
+    passed += result.passed;
+  }
+
+  out << "{\n  \"passed\": " << passed
+      << ",\n  \"failed\": " << results.size() - passed
+      << ",\n  \"wall_time_seconds\": " << seconds << ",\n  \"tests\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const TestResult &result = results[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"binary\": \""
+        << jsonEscape(result.binary) << "\", \"signature\": \""
+        << jsonEscape(result.signature)
+        << "\", \"passed\": " << (result.passed ? "true" : "false")
+        << ", \"reason\": \"" << reasonName(result.reason)
+        << "\", \"message\": \"" << jsonEscape(result.message)
+        << "\", \"instructions\": " << result.retired
+        << ", \"seconds\": " << result.seconds << "}";
+  }
+  out << "\n  ]\n}\n";
+}
@@ -0,0 +1,536 @@
+#include "blockengine.h"
+#include "exceptions.h"
+#include "nativealu.hpp"
+
+#include <algorithm>
+#include <bitset>
+
+namespace {
+
+typedef BlockEngine::State State;
+typedef BlockEngine::Op Op;
+
+/*
+=========================
+    Dispatch
+=========================
+*/
+
+// Continues with the next operation of the block. Handlers end with this call
+// in tail position, so it compiles to a jump to the next handler.
+inline void next(State &state, const Op *op) { op[1].handler(state, op + 1); }
+
+inline unsigned int indexOf(const State &state, const Op *op) {
+  return static_cast<unsigned int>(op - state.p_block->ops.data());
+}
+
+// Leaves the block after \p op has completed, continuing at \p pc
+inline void leave(State &state, const Op *op, uint32_t pc) {
+  state.pc = pc;
+  state.completed = indexOf(state, op) + 1;
+}
+
+// Leaves the block before \p op has completed, stopping at \p pc
+inline void stop(State &state, const Op *op, uint32_t pc) {
+  state.pc = pc;
+  state.completed = indexOf(state, op);
+}
+
+/*
+=========================
+    RType Handlers
+=========================
+*/
+
+void add(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] + s.x[op->rs2];
+  return next(s, op);
+}
+
+void sub(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] - s.x[op->rs2];
+  return next(s, op);
+}
+
+void bitwiseXor(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] ^ s.x[op->rs2];
+  return next(s, op);
+}
+
+void bitwiseOr(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] | s.x[op->rs2];
+  return next(s, op);
+}
+
+void bitwiseAnd(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] & s.x[op->rs2];
+  return next(s, op);
+}
+
+void shiftLeftLogi(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] << (s.x[op->rs2] & 0x1F);
+  return next(s, op);
+}
+
+void shiftRightLogi(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] >> (s.x[op->rs2] & 0x1F);
+  return next(s, op);
+}
+
+void shiftRightArith(State &s, const Op *op) {
+  s.x[op->rd] =
+      NativeALU::arithmeticRightShift(s.x[op->rs1], s.x[op->rs2] & 0x1F);
+  return next(s, op);
+}
+
+void setLessThan(State &s, const Op *op) {
+  s.x[op->rd] = NativeALU::lessThanSigned(s.x[op->rs1], s.x[op->rs2]);
+  return next(s, op);
+}
+
+void setLessThanUnsigned(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] < s.x[op->rs2];
+  return next(s, op);
+}
+
+/*
+=========================
+    IType Handlers
+=========================
+*/
+
+void addImm(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] + op->imm;
+  return next(s, op);
+}
+
+void xorImm(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] ^ op->imm;
+  return next(s, op);
+}
+
+void orImm(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] | op->imm;
+  return next(s, op);
+}
+
+void andImm(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] & op->imm;
+  return next(s, op);
+}
+
+void shiftLeftLogiImm(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] << (op->imm & 0x1F);
+  return next(s, op);
+}
+
+void shiftRightLogiImm(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] >> (op->imm & 0x1F);
+  return next(s, op);
+}
+
+void shiftRightArithImm(State &s, const Op *op) {
+  s.x[op->rd] =
+      NativeALU::arithmeticRightShift(s.x[op->rs1], op->imm & 0x1F);
+  return next(s, op);
+}
+
+void setLessThanImm(State &s, const Op *op) {
+  s.x[op->rd] = NativeALU::lessThanSigned(s.x[op->rs1], op->imm);
+  return next(s, op);
+}
+
+void setLessThanImmUnsigned(State &s, const Op *op) {
+  s.x[op->rd] = s.x[op->rs1] < op->imm;
+  return next(s, op);
+}
+
+void loadWord(State &s, const Op *op) {
+  s.x[op->rd] =
+      s.p_data_file->readBytes(s.x[op->rs1] + op->imm, 4).to_ulong();
+  return next(s, op);
+}
+
+void loadHalfWord(State &s, const Op *op) {
+  s.x[op->rd] =
+      s.p_data_file->readBytes(s.x[op->rs1] + op->imm, 2, true).to_ulong();
+  return next(s, op);
+}
+
+void loadByte(State &s, const Op *op) {
+  s.x[op->rd] =
+      s.p_data_file->readBytes(s.x[op->rs1] + op->imm, 1, true).to_ulong();
+  return next(s, op);
+}
+
+void loadUnsignedHalfWord(State &s, const Op *op) {
+  s.x[op->rd] =
+      s.p_data_file->readBytes(s.x[op->rs1] + op->imm, 2).to_ulong();
+  return next(s, op);
+}
+
+void loadUnsignedByte(State &s, const Op *op) {
+  s.x[op->rd] =
+      s.p_data_file->readBytes(s.x[op->rs1] + op->imm, 1).to_ulong();
+  return next(s, op);
+}
+
+void jumpAndLinkReg(State &s, const Op *op) {
+  uint32_t target = s.x[op->rs1] + op->imm;
+  s.x[op->rd] = op->pc + 4;
+  return leave(s, op, target);
+}
+
+void ecall(State &s, const Op *op) {
+  stop(s, op, op->pc);
+  throw EcallTrap();
+}
+
+void ebreak(State &s, const Op *op) {
+  // The staged model advances the PC before trapping
+  stop(s, op, op->pc + 4);
+  throw EbreakTrap();
+}
+
+void fence(State &s, const Op *op) { return next(s, op); }
+
+/*
+=========================
+    SType Handlers
+=========================
+*/
+
+// A store that overwrote decoded code ends the block, so that the
+// instructions after it are decoded again before they run.
+inline void nextAfterStore(State &s, const Op *op) {
+  if (s.code_modified) {
+    return leave(s, op, op->pc + 4);
+  }
+  return next(s, op);
+}
+
+void saveWord(State &s, const Op *op) {
+  s.p_data_file->writeBytes(s.x[op->rs1] + op->imm, s.x[op->rs2], 4);
+  return nextAfterStore(s, op);
+}
+
+void saveHalfWord(State &s, const Op *op) {
+  s.p_data_file->writeBytes(s.x[op->rs1] + op->imm, s.x[op->rs2], 2);
+  return nextAfterStore(s, op);
+}
+
+void saveByte(State &s, const Op *op) {
+  s.p_data_file->writeBytes(s.x[op->rs1] + op->imm, s.x[op->rs2], 1);
+  return nextAfterStore(s, op);
+}
+
+/*
+=========================
+    BType Handlers
+=========================
+*/
+
+inline void branch(State &s, const Op *op, bool taken) {
+  s.taken = taken;
+  return leave(s, op, taken ? op->pc + op->imm : op->pc + 4);
+}
+
+void branchEqual(State &s, const Op *op) {
+  return branch(s, op, s.x[op->rs1] == s.x[op->rs2]);
+}
+
+void branchNotEqual(State &s, const Op *op) {
+  return branch(s, op, s.x[op->rs1] != s.x[op->rs2]);
+}
+
+void branchLessThan(State &s, const Op *op) {
+  return branch(s, op, NativeALU::lessThanSigned(s.x[op->rs1], s.x[op->rs2]));
+}
+
+void branchGreaterThanEqual(State &s, const Op *op) {
+  return branch(s, op, !NativeALU::lessThanSigned(s.x[op->rs1], s.x[op->rs2]));
+}
+
+void branchLessThanUnsigned(State &s, const Op *op) {
+  return branch(s, op, s.x[op->rs1] < s.x[op->rs2]);
+}
+
+void branchGreaterThanEqualUnsigned(State &s, const Op *op) {
+  return branch(s, op, s.x[op->rs1] >= s.x[op->rs2]);
+}
+
+/*
+=========================
+    UType / JType Handlers
+=========================
+*/
+
+void loadUpperImmediate(State &s, const Op *op) {
+  s.x[op->rd] = op->imm;
+  return next(s, op);
+}
+
+void addUpperImmediateToPC(State &s, const Op *op) {
+  s.x[op->rd] = op->pc + op->imm;
+  return next(s, op);
+}
+
+void jumpAndLink(State &s, const Op *op) {
+  s.x[op->rd] = op->pc + 4;
+  return leave(s, op, op->pc + op->imm);
+}
+
+/*
+=========================
+    Block Exits
+=========================
+*/
+
+// Ends a block that reached the length limit or a breakpoint, without being an
+// instruction
+void fallThrough(State &s, const Op *op) { return stop(s, op, op->pc); }
+
+// Raises the error the staged model would have raised fetching or decoding
+// this word
+void trap(State &s, const Op *op) {
+  stop(s, op, op->pc);
+  throw std::runtime_error(s.p_block->error);
+}
+
+const BlockEngine::Handler handlers[] = {
+    trap, // Illegal
+    // RType
+    add, sub, bitwiseXor, bitwiseOr, bitwiseAnd, shiftLeftLogi,
+    shiftRightLogi, shiftRightArith, setLessThan, setLessThanUnsigned,
+    // IType
+    addImm, xorImm, orImm, andImm, shiftLeftLogiImm, shiftRightLogiImm,
+    shiftRightArithImm, setLessThanImm, setLessThanImmUnsigned, loadWord,
+    loadHalfWord, loadByte, loadUnsignedHalfWord, loadUnsignedByte,
+    jumpAndLinkReg, ecall, ebreak, fence,
+    // SType
+    saveWord, saveHalfWord, saveByte,
+    // BType
+    branchEqual, branchNotEqual, branchLessThan, branchGreaterThanEqual,
+    branchLessThanUnsigned, branchGreaterThanEqualUnsigned,
+    // UType
+    loadUpperImmediate, addUpperImmediateToPC,
+    // JType
+    jumpAndLink};
+
+static_assert(sizeof(handlers) / sizeof(handlers[0]) ==
+                  static_cast<size_t>(RISC::Opcode::Count),
+              "One handler per opcode");
+
+} // namespace
+
+BlockEngine::BlockEngine(std::shared_ptr<InstructionFile> _p_instruction_file,
+                         std::shared_ptr<MemoryFile> _p_data_file)
+    : p_instruction_file(_p_instruction_file), p_data_file(_p_data_file),
+      p_statistics(nullptr), p_predecode(nullptr) {
+  state.taken = false;
+  state.code_modified = false;
+}
+
+bool BlockEngine::run(uint32_t &pc, uint32_t *registers,
+                      unsigned long &retired, unsigned long budget,
+                      bool ignore_breakpoint) {
+  std::copy(registers, registers + 32, state.x);
+  state.x[0] = 0;
+  state.x[SINK_REGISTER] = 0;
+  state.pc = pc;
+  state.completed = 0;
+  state.p_data_file = p_data_file.get();
+  state.code_modified = false;
+
+  bool at_breakpoint = false;
+  try {
+    Block *p_block = nullptr;
+    bool first = true;
+    while (budget > 0) {
+      // Blocks are split at breakpoints, so they can only be reached here
+      if (!breakpoints.empty() && !(ignore_breakpoint && first) &&
+          breakpoints.count(state.pc) != 0) {
+        at_breakpoint = true;
+        break;
+      }
+      first = false;
+
+      p_block = follow(p_block, state.pc);
+      if (p_block->length > budget) {
+        // Run only the start of the block, without keeping the copy
+        std::unique_ptr<Block> p_partial =
+            build(state.pc, static_cast<unsigned int>(budget));
+        execute(p_partial.get(), retired);
+        break;
+      }
+
+      unsigned long before = retired;
+      execute(p_block, retired);
+      budget -= retired - before;
+      if (state.code_modified) {
+        flush();
+        p_block = nullptr;
+      }
+    }
+  } catch (...) {
+    pc = state.pc;
+    std::copy(state.x, state.x + 32, registers);
+    if (state.code_modified) {
+      flush();
+    }
+    throw;
+  }
+
+  pc = state.pc;
+  std::copy(state.x, state.x + 32, registers);
+  if (state.code_modified) {
+    flush();
+  }
+  return at_breakpoint;
+}
+
+void BlockEngine::execute(const Block *p_block, unsigned long &retired) {
+  state.p_block = p_block;
+  try {
+    p_block->ops[0].handler(state, p_block->ops.data());
+  } catch (...) {
+    // Count the instructions before the trap while the block still exists
+    retire(retired);
+    throw;
+  }
+  retire(retired);
+}
+
+void BlockEngine::retire(unsigned long &retired) {
+  retired += state.completed;
+  if (p_statistics != nullptr && state.completed > 0) {
+    p_statistics->retire(state.p_block->opcodes.data(), state.completed,
+                         state.p_block->ops[state.completed - 1].pc,
+                         state.taken);
+  }
+  state.completed = 0;
+}
+
+BlockEngine::Block *BlockEngine::follow(Block *p_previous, uint32_t pc) {
+  if (p_previous == nullptr) {
+    return lookup(pc);
+  }
+
+  // Follow the chain to the successor, resolving and remembering it on first
+  // use
+  if (p_previous->p_successor[0] != nullptr &&
+      p_previous->successor_pc[0] == pc) {
+    return p_previous->p_successor[0];
+  }
+  if (p_previous->p_successor[1] != nullptr &&
+      p_previous->successor_pc[1] == pc) {
+    return p_previous->p_successor[1];
+  }
+  Block *p_next = lookup(pc);
+  p_previous->successor_pc[1] = p_previous->successor_pc[0];
+  p_previous->p_successor[1] = p_previous->p_successor[0];
+  p_previous->successor_pc[0] = pc;
+  p_previous->p_successor[0] = p_next;
+  return p_next;
+}
+
+void BlockEngine::flush() {
+  blocks.clear();
+  code_words.clear();
+  watch_begin = ~0u;
+  watch_end = 0;
+  state.code_modified = false;
+}
+
+void BlockEngine::setBreakpoints(const std::set<uint32_t> &_breakpoints) {
+  breakpoints = _breakpoints;
+  flush();
+}
+
+void BlockEngine::onWrite(uint32_t address, unsigned int n) {
+  // The watch range spans all decoded code, so also check the words, which
+  // keeps data stored between blocks from discarding them
+  if (code_words.count(address >> 2) == 0 &&
+      code_words.count((address + n - 1) >> 2) == 0) {
+    return;
+  }
+  state.code_modified = true;
+}
+
+BlockEngine::Block *BlockEngine::lookup(uint32_t pc) {
+  auto it = blocks.find(pc);
+  if (it != blocks.end()) {
+    return it->second.get();
+  }
+  std::unique_ptr<Block> &p_block = blocks[pc];
+  p_block = build(pc, MAX_BLOCK_LENGTH);
+  return p_block.get();
+}
+
+std::unique_ptr<BlockEngine::Block>
+BlockEngine::build(uint32_t pc, unsigned int max_length) {
+  std::unique_ptr<Block> p_block(new Block());
+  p_block->length = 0;
+  p_block->p_successor[0] = nullptr;
+  p_block->p_successor[1] = nullptr;
+  p_block->successor_pc[0] = 0;
+  p_block->successor_pc[1] = 0;
+
+  uint32_t address = pc;
+  while (true) {
+    Op op = {};
+    op.pc = address;
+
+    if (p_block->length == max_length ||
+        (address != pc && breakpoints.count(address) != 0)) {
+      op.handler = fallThrough;
+      p_block->ops.push_back(op);
+      break;
+    }
+
+    uint32_t raw;
+    try {
+      raw = p_instruction_file->read(address).to_ulong();
+    } catch (const std::exception &e) {
+      op.handler = trap;
+      p_block->error = e.what();
+      p_block->ops.push_back(op);
+      break;
+    }
+
+    RISC::DecodedInstruction decoded =
+        p_predecode != nullptr
+            ? RISC::decodeInstruction(raw, p_predecode->opcode(address, raw))
+            : RISC::decodeInstruction(raw);
+    if (decoded.opcode == RISC::Opcode::Illegal) {
+      op.handler = trap;
+      p_block->error =
+          "Unknown instruction: " + std::bitset<32>(raw).to_string();
+      p_block->ops.push_back(op);
+      break;
+    }
+
+    op.handler = handlers[static_cast<size_t>(decoded.opcode)];
+    op.imm = decoded.imm;
+    op.rd = decoded.rd == 0 ? SINK_REGISTER : decoded.rd;
+    op.rs1 = decoded.rs1;
+    op.rs2 = decoded.rs2;
+    p_block->ops.push_back(op);
+    p_block->opcodes.push_back(decoded.opcode);
+    p_block->length++;
+
+    if (RISC::endsBlock(decoded.opcode)) {
+      break;
+    }
+    address += 4;
+  }
+
+  // Watch the decoded words so that stores to them are noticed
+  for (uint32_t word = pc; word != address + 4; word += 4) {
+    code_words.insert(word >> 2);
+  }
+  watch_begin = std::min(watch_begin, pc);
+  watch_end = std::max(watch_end, address + 4);
+
+  return p_block;
+}
@@ -0,0 +1,122 @@
+#include "branchpredictor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Weakly not taken
+const uint8_t INITIAL_COUNTER = 1;
+
+} // namespace
+
+std::shared_ptr<BranchPredictor> makeBranchPredictor(PredictorKind kind,
+                                                     unsigned int index_bits) {
+  if (kind != PredictorKind::NotTaken &&
+      (index_bits == 0 || index_bits > MAX_PREDICTOR_INDEX_BITS)) {
+    throw std::runtime_error("Predictor index bits must be from 1 to " +
+                             std::to_string(MAX_PREDICTOR_INDEX_BITS));
+  }
+  switch (kind) {
+  case PredictorKind::NotTaken:
+    return std::make_shared<NotTakenPredictor>();
+  case PredictorKind::Bimodal:
+    return std::make_shared<BimodalPredictor>(index_bits);
+  case PredictorKind::GShare:
+    return std::make_shared<GSharePredictor>(index_bits);
+  }
+  throw std::runtime_error("Unknown branch predictor");
+}
+
+/*
+=========================
+    Bimodal
+=========================
+*/
+
+BimodalPredictor::BimodalPredictor(unsigned int index_bits)
+    : mask((1u << index_bits) - 1), counters(1u << index_bits) {
+  reset();
+}
+
+void BimodalPredictor::update(uint32_t pc, bool taken) {
+  train(index(pc), taken);
+}
+
+void BimodalPredictor::reset() {
+  std::fill(counters.begin(), counters.end(), INITIAL_COUNTER);
+}
+
+std::string BimodalPredictor::name() const {
+  return "bimodal, " + std::to_string(counters.size()) + " counters";
+}
+
+void BimodalPredictor::train(uint32_t slot, bool taken) {
+  uint8_t &counter = counters[slot];
+  if (taken && counter < 3) {
+    counter++;
+  } else if (!taken && counter > 0) {
+    counter--;
+  }
+}
+
+/*
+=========================
+    GShare
+=========================
+*/
+
+GSharePredictor::GSharePredictor(unsigned int index_bits)
+    : BimodalPredictor(index_bits), history(0) {}
+
+void GSharePredictor::update(uint32_t pc, bool taken) {
+  train(index(pc), taken);
+  history = ((history << 1) | taken) & mask;
+}
+
+void GSharePredictor::reset() {
+  BimodalPredictor::reset();
+  history = 0;
+}
+
+std::string GSharePredictor::name() const {
+  return "gshare, " + std::to_string(counters.size()) + " counters";
+}
+
+/*
+=========================
+    Return address stack
+=========================
+*/
+
+const unsigned int ReturnAddressStack::MAX_DEPTH;
+
+ReturnAddressStack::ReturnAddressStack(unsigned int _depth)
+    : top(0), count(0) {
+  if (_depth > MAX_DEPTH) {
+    throw std::runtime_error("Return address stack depth must be at most " +
+                             std::to_string(MAX_DEPTH));
+  }
+  entries.resize(_depth);
+}
+
+void ReturnAddressStack::push(uint32_t address) {
+  if (entries.empty()) {
+    return;
+  }
+  entries[top] = address;
+  top = (top + 1) % entries.size();
+  if (count < entries.size()) {
+    count++;
+  }
+}
+
+bool ReturnAddressStack::pop(uint32_t &address) {
+  if (count == 0) {
+    return false;
+  }
+  top = (top + entries.size() - 1) % entries.size();
+  count--;
+  address = entries[top];
+  return true;
+}
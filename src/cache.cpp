@@ -0,0 +1,445 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+const uint32_t Cache::INVALID;
+
+namespace {
+
+bool isPowerOfTwo(uint32_t value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+unsigned int floorLog2(uint32_t value) {
+  unsigned int bits = 0;
+  while (value >>= 1) {
+    bits++;
+  }
+  return bits;
+}
+
+// A byte count with an optional k or m suffix
+uint32_t parseSize(const std::string &text) {
+  size_t end;
+  unsigned long value = std::stoul(text, &end);
+  std::string suffix = text.substr(end);
+  if (suffix == "k" || suffix == "K") {
+    value *= 1024;
+  } else if (suffix == "m" || suffix == "M") {
+    value *= 1024 * 1024;
+  } else if (!suffix.empty()) {
+    throw std::invalid_argument(text);
+  }
+  return static_cast<uint32_t>(value);
+}
+
+const char *policyName(ReplacementPolicy policy) {
+  switch (policy) {
+  case ReplacementPolicy::LRU:
+    return "LRU";
+  case ReplacementPolicy::PLRU:
+    return "PLRU";
+  case ReplacementPolicy::Random:
+    return "random";
+  }
+  return "unknown";
+}
+
+// The PCs with the most misses come first
+const unsigned int REPORTED_PCS = 16;
+
+} // namespace
+
+/*
+=========================
+    Configuration
+=========================
+*/
+
+CacheConfig CacheConfig::parse(const std::string &text,
+                               const CacheConfig &defaults) {
+  std::vector<std::string> fields;
+  std::stringstream stream(text);
+  for (std::string field; std::getline(stream, field, ':');) {
+    fields.push_back(field);
+  }
+  if (fields.size() < 3) {
+    throw std::runtime_error("Invalid cache configuration: " + text);
+  }
+
+  CacheConfig config = defaults;
+  try {
+    config.size = parseSize(fields[0]);
+    config.associativity = std::stoul(fields[1]);
+    config.line_size = parseSize(fields[2]);
+    for (size_t i = 3; i < fields.size(); i++) {
+      const std::string &field = fields[i];
+      if (field == "lru") {
+        config.replacement = ReplacementPolicy::LRU;
+      } else if (field == "plru") {
+        config.replacement = ReplacementPolicy::PLRU;
+      } else if (field == "random") {
+        config.replacement = ReplacementPolicy::Random;
+      } else if (field == "wb") {
+        config.write_policy = WritePolicy::WriteBack;
+      } else if (field == "wt") {
+        config.write_policy = WritePolicy::WriteThrough;
+      } else if (field.compare(0, 8, "latency=") == 0) {
+        config.latency = std::stoul(field.substr(8));
+      } else {
+        throw std::invalid_argument(field);
+      }
+    }
+  } catch (const std::logic_error &e) {
+    throw std::runtime_error("Invalid cache configuration: " + text);
+  }
+  return config;
+}
+
+std::string CacheConfig::describe() const {
+  std::stringstream text;
+  if (size % 1024 == 0) {
+    text << size / 1024 << " KiB";
+  } else {
+    text << size << " B";
+  }
+  text << ", " << associativity << "-way, " << line_size << " B lines, "
+       << policyName(replacement) << ", "
+       << (write_policy == WritePolicy::WriteBack ? "write-back"
+                                                  : "write-through");
+  if (latency > 0) {
+    text << ", " << latency << " cycles";
+  }
+  return text.str();
+}
+
+/*
+=========================
+    Cache
+=========================
+*/
+
+Cache::Cache(const std::string &_name, const CacheConfig &_config)
+    : cache_name(_name), configuration(_config) {
+  uint32_t line_size = configuration.line_size;
+  ways = configuration.associativity;
+  if (!isPowerOfTwo(line_size) || line_size < 4 || ways == 0 ||
+      configuration.size % (line_size * ways) != 0 ||
+      !isPowerOfTwo(configuration.size / (line_size * ways))) {
+    throw std::runtime_error(cache_name +
+                             ": the size must be a power-of-two number of "
+                             "sets of power-of-two sized lines");
+  }
+  if (configuration.replacement == ReplacementPolicy::PLRU &&
+      (!isPowerOfTwo(ways) || ways > 64)) {
+    throw std::runtime_error(cache_name +
+                             ": PLRU needs a power-of-two number of ways up "
+                             "to 64");
+  }
+
+  uint32_t sets = configuration.size / (line_size * ways);
+  line_bits = floorLog2(line_size);
+  tree_levels = floorLog2(ways);
+  set_mask = sets - 1;
+  tags.resize(sets * ways);
+  dirty.resize(sets * ways);
+  last_used.resize(sets * ways);
+  tree.resize(sets);
+  reset();
+}
+
+void Cache::reset() {
+  std::fill(tags.begin(), tags.end(), INVALID);
+  std::fill(dirty.begin(), dirty.end(), 0);
+  std::fill(last_used.begin(), last_used.end(), 0);
+  std::fill(tree.begin(), tree.end(), 0);
+  clock = 0;
+  // xorshift32, for the same replacements on every run
+  random_state = 0x2545F491;
+  last_line = INVALID;
+  last_slot = 0;
+  access_counts = Counts();
+}
+
+Cache::Access Cache::access(uint32_t address, bool is_write) {
+  if (is_write) {
+    access_counts.writes++;
+  } else {
+    access_counts.reads++;
+  }
+  bool allocates =
+      !is_write || configuration.write_policy == WritePolicy::WriteBack;
+  Access result = {true, false, 0};
+
+  uint32_t line = address >> line_bits;
+  if (line == last_line) {
+    // Already the most recently used line of its set
+    if (is_write && allocates) {
+      dirty[last_slot] = 1;
+    }
+    return result;
+  }
+
+  uint32_t set = line & set_mask;
+  uint32_t base = set * ways;
+  for (uint32_t way = 0; way < ways; way++) {
+    if (tags[base + way] == line) {
+      if (is_write && allocates) {
+        dirty[base + way] = 1;
+      }
+      touch(set, way);
+      last_line = line;
+      last_slot = base + way;
+      return result;
+    }
+  }
+
+  result.hit = false;
+  access_counts.misses++;
+  if (!allocates) {
+    return result;
+  }
+
+  uint32_t way = victim(set);
+  uint32_t slot = base + way;
+  if (tags[slot] != INVALID) {
+    access_counts.evictions++;
+    if (dirty[slot]) {
+      access_counts.writebacks++;
+      result.writeback = true;
+      result.writeback_address = tags[slot] << line_bits;
+    }
+  }
+  tags[slot] = line;
+  dirty[slot] = is_write;
+  touch(set, way);
+  last_line = line;
+  last_slot = slot;
+  return result;
+}
+
+void Cache::touch(uint32_t set, uint32_t way) {
+  switch (configuration.replacement) {
+  case ReplacementPolicy::LRU:
+    last_used[set * ways + way] = ++clock;
+    break;
+  case ReplacementPolicy::PLRU: {
+    // Node n has children 2n and 2n + 1; the root is node 1
+    uint64_t &bits = tree[set];
+    uint32_t node = 1;
+    for (unsigned int shift = tree_levels; shift-- > 0;) {
+      uint32_t right = way >> shift & 1;
+      if (right) {
+        bits &= ~(uint64_t(1) << node);
+      } else {
+        bits |= uint64_t(1) << node;
+      }
+      node = node * 2 + right;
+    }
+    break;
+  }
+  case ReplacementPolicy::Random:
+    break;
+  }
+}
+
+uint32_t Cache::victim(uint32_t set) {
+  uint32_t base = set * ways;
+  for (uint32_t way = 0; way < ways; way++) {
+    if (tags[base + way] == INVALID) {
+      return way;
+    }
+  }
+
+  switch (configuration.replacement) {
+  case ReplacementPolicy::LRU:
+    return static_cast<uint32_t>(
+        std::min_element(last_used.begin() + base,
+                         last_used.begin() + base + ways) -
+        (last_used.begin() + base));
+  case ReplacementPolicy::PLRU: {
+    uint64_t bits = tree[set];
+    uint32_t node = 1;
+    uint32_t way = 0;
+    for (unsigned int level = tree_levels; level > 0; level--) {
+      uint32_t right = bits >> node & 1;
+      way = way * 2 + right;
+      node = node * 2 + right;
+    }
+    return way;
+  }
+  case ReplacementPolicy::Random:
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state % ways;
+  }
+  return 0;
+}
+
+/*
+=========================
+    Hierarchy
+=========================
+*/
+
+CacheHierarchy::CacheHierarchy(const CacheHierarchyConfig &_config)
+    : configuration(_config), instruction_cache("L1I", _config.l1i),
+      data_cache("L1D", _config.l1d), unified_cache("L2", _config.l2) {
+  reset();
+}
+
+void CacheHierarchy::reset() {
+  instruction_cache.reset();
+  data_cache.reset();
+  unified_cache.reset();
+  fetch_stalls = 0;
+  data_stalls = 0;
+  pc_counts.clear();
+}
+
+unsigned int CacheHierarchy::fetch(uint32_t pc) {
+  unsigned long evictions = instruction_cache.counts().evictions;
+  unsigned int stalls = lookup(instruction_cache, pc, false);
+  fetch_stalls += stalls;
+  if (configuration.per_pc && stalls > 0) {
+    PcCounts &counts = pc_counts[pc];
+    counts.fetch_misses++;
+    counts.evictions += instruction_cache.counts().evictions - evictions;
+  }
+  return stalls;
+}
+
+unsigned int CacheHierarchy::access(uint32_t pc, uint32_t address,
+                                    unsigned int size, bool is_write) {
+  Cache::Counts before = data_cache.counts();
+  unsigned int stalls = lookup(data_cache, address, is_write);
+  // A misaligned access may straddle two lines
+  uint32_t last = address + size - 1;
+  if (data_cache.lineAddress(last) != data_cache.lineAddress(address)) {
+    stalls += lookup(data_cache, last, is_write);
+  }
+  data_stalls += stalls;
+
+  if (configuration.per_pc) {
+    const Cache::Counts &after = data_cache.counts();
+    PcCounts &counts = pc_counts[pc];
+    counts.accesses++;
+    counts.misses += after.misses - before.misses;
+    counts.evictions += after.evictions - before.evictions;
+    counts.writebacks += after.writebacks - before.writebacks;
+  }
+  return stalls;
+}
+
+unsigned int CacheHierarchy::lookup(Cache &cache, uint32_t address,
+                                    bool is_write) {
+  Cache::Access result = cache.access(address, is_write);
+  if (configuration.has_l2 && result.writeback) {
+    unified_cache.access(result.writeback_address, true);
+  }
+  if (is_write && cache.config().write_policy == WritePolicy::WriteThrough) {
+    // Absorbed by the write buffer
+    if (configuration.has_l2) {
+      unified_cache.access(address, true);
+    }
+    return 0;
+  }
+  return result.hit ? 0 : fill(address);
+}
+
+unsigned int CacheHierarchy::fill(uint32_t address) {
+  if (!configuration.has_l2) {
+    return configuration.memory_latency;
+  }
+  Cache::Access result = unified_cache.access(address, false);
+  return configuration.l2.latency +
+         (result.hit ? 0 : configuration.memory_latency);
+}
+
+void CacheHierarchy::print(std::ostream &out) const {
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  for (const Cache *p_cache : {&instruction_cache, &data_cache,
+                               &unified_cache}) {
+    if (p_cache == &unified_cache && !configuration.has_l2) {
+      continue;
+    }
+    const Cache::Counts &counts = p_cache->counts();
+    unsigned long accesses = counts.reads + counts.writes;
+    out << p_cache->name() << ": " << p_cache->config().describe() << "\n"
+        << "  reads: " << counts.reads << ", writes: " << counts.writes
+        << ", misses: " << counts.misses << " ("
+        << (accesses > 0 ? 100.0 * counts.misses / accesses : 0)
+        << "% miss rate)\n"
+        << "  evictions: " << counts.evictions
+        << ", writebacks: " << counts.writebacks << "\n";
+  }
+  out << "memory stall cycles: " << fetch_stalls << " fetch, " << data_stalls
+      << " data\n";
+
+  if (configuration.per_pc) {
+    std::vector<std::pair<uint32_t, PcCounts>> sorted(pc_counts.begin(),
+                                                      pc_counts.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<uint32_t, PcCounts> &a,
+                 const std::pair<uint32_t, PcCounts> &b) {
+                unsigned long a_misses =
+                    a.second.fetch_misses + a.second.misses;
+                unsigned long b_misses =
+                    b.second.fetch_misses + b.second.misses;
+                return a_misses != b_misses ? a_misses > b_misses
+                                            : a.first < b.first;
+              });
+    sorted.resize(std::min<size_t>(sorted.size(), REPORTED_PCS));
+    out << "PCs with the most misses (pc, fetch misses, data accesses, data "
+           "misses, evictions, writebacks):\n";
+    for (const auto &pc : sorted) {
+      out << "  0x" << std::hex << std::setfill('0') << std::setw(8)
+          << pc.first << std::dec << std::setfill(' ') << std::setw(12)
+          << pc.second.fetch_misses << std::setw(12) << pc.second.accesses
+          << std::setw(12) << pc.second.misses << std::setw(12)
+          << pc.second.evictions << std::setw(12) << pc.second.writebacks
+          << "\n";
+    }
+  }
+  out.flags(flags);
+}
+
+void CacheHierarchy::writeJson(std::ostream &out) const {
+  out << "{\n  \"caches\": [";
+  bool first = true;
+  for (const Cache *p_cache : {&instruction_cache, &data_cache,
+                               &unified_cache}) {
+    if (p_cache == &unified_cache && !configuration.has_l2) {
+      continue;
+    }
+    const Cache::Counts &counts = p_cache->counts();
+    out << (first ? "\n" : ",\n") << "    {\"name\": \"" << p_cache->name()
+        << "\", \"config\": \"" << p_cache->config().describe()
+        << "\", \"reads\": " << counts.reads
+        << ", \"writes\": " << counts.writes
+        << ", \"misses\": " << counts.misses
+        << ", \"evictions\": " << counts.evictions
+        << ", \"writebacks\": " << counts.writebacks << "}";
+    first = false;
+  }
+  out << "\n  ],\n  \"stall_cycles\": {\"fetch\": " << fetch_stalls
+      << ", \"data\": " << data_stalls << "},\n  \"pcs\": [";
+  first = true;
+  std::map<uint32_t, PcCounts> sorted(pc_counts.begin(), pc_counts.end());
+  for (const auto &pc : sorted) {
+    out << (first ? "\n" : ",\n") << "    {\"pc\": " << pc.first
+        << ", \"fetch_misses\": " << pc.second.fetch_misses
+        << ", \"accesses\": " << pc.second.accesses
+        << ", \"misses\": " << pc.second.misses
+        << ", \"evictions\": " << pc.second.evictions
+        << ", \"writebacks\": " << pc.second.writebacks << "}";
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+}
@@ -1,217 +1,592 @@
 #include "controlunit.h"
+#include "imagecache.h"
 
-ControlUnit::ControlUnit(std::string bin_file) {
+const unsigned long ControlUnit::UNLIMITED;
+const unsigned long ControlUnit::DEADLINE_CHECK_INTERVAL;
+
+ControlUnit::ControlUnit(std::string bin_file, MemoryBackend backend) {
   cycles = 0;
   pc = std::bitset<32>(0);
+  p_current_instruction = nullptr;
+  p_current_decoded = nullptr;
   p_mu = std::make_shared<MaskingUnit>();
-  p_instruction_file = std::make_shared<InstructionFile>(bin_file);
+  // Fetches, loads and stores share a single copy of the program image
+  p_image = ImageCache::instance().open(bin_file);
+  if (p_image->isOpen() && ElfFile::isElf(*p_image)) {
+    p_elf = std::make_shared<ElfFile>(bin_file, p_image);
+    p_data_file = std::make_shared<MemoryFile>("", backend);
+    loadElf();
+  } else {
+    p_data_file = std::make_shared<MemoryFile>(bin_file, backend);
+  }
+  p_instruction_file = std::make_shared<InstructionFile>(p_data_file);
   p_igu = std::make_shared<ImmGenUnit>();
   p_reg_file = std::make_shared<RegisterFile>();
   p_alu = std::make_shared<ALU>();
-  p_data_file = std::make_shared<MemoryFile>(bin_file);
+  has_explicit_signature_range = false;
+  resolveSignatureRange();
+  engine = Engine::Interpreter;
+  cycle_limit = UNLIMITED;
+  has_deadline = false;
+  setDecodeCacheEnabled(true);
 }
 
-void ControlUnit::step() {
-  fetch();
-  decode();
-  execute();
-  memoryAccess();
-  writeBack();
-  cycles++;
+ControlUnit::~ControlUnit() { p_data_file->setWriteObserver(nullptr); }
+
+void ControlUnit::loadElf() {
+  for (const ElfSegment &segment : p_elf->segments()) {
+    // The zero-filled rest of the segment, such as .bss, is left unmapped
+    p_data_file->loadSegment(p_elf->image(), segment.file_offset,
+                             segment.file_size, segment.address);
+  }
+  pc = p_elf->entry();
 }
 
-void ControlUnit::fetch() {
-  std::bitset<32> instruction = p_instruction_file->read(pc);
-  p_current_instruction = createInstruction(instruction);
-  p_current_instruction->fetch(instruction, p_mu);
+void ControlUnit::resolveSignatureRange() {
+  if (has_explicit_signature_range) {
+    p_data_file->setSignatureRange(explicit_signature_range.begin,
+                                   explicit_signature_range.end);
+    return;
+  }
+  if (p_elf) {
+    const ElfSymbol *p_begin = p_elf->symbol("begin_signature");
+    const ElfSymbol *p_end = p_elf->symbol("end_signature");
+    if (p_begin && p_end &&
+        MemoryFile::isValidSignatureRange(p_begin->address, p_end->address)) {
+      p_data_file->setSignatureRange(p_begin->address, p_end->address);
+      return;
+    }
+  }
+  // A program that writes its canaries as it runs is searched again when
+  // the signature is dumped
+  p_data_file->findSignatureRange();
 }
 
-void ControlUnit::decode() { p_current_instruction->decode(p_reg_file, p_igu); }
+void ControlUnit::predecode() {
+  std::shared_ptr<PredecodeTable> p_table = std::make_shared<PredecodeTable>();
+  if (p_elf) {
+    for (const ElfSegment &segment : p_elf->segments()) {
+      if (segment.executable) {
+        p_table->addRegion(p_elf->image(), segment.file_offset,
+                           segment.file_size, segment.address);
+      }
+    }
+  } else if (p_image->isOpen()) {
+    p_table->addRegion(p_image, 0, p_image->size(), 0);
+  }
 
-void ControlUnit::execute() { p_current_instruction->execute(p_alu, pc); }
+  uint32_t address;
+  uint32_t raw;
+  if (p_table->firstReachableIllegal(pc.to_ulong(), address, raw)) {
+    std::ostringstream message;
+    message << "Unknown instruction: " << std::bitset<32>(raw).to_string()
+            << " at 0x" << std::hex << address;
+    throw std::runtime_error(message.str());
+  }
 
-void ControlUnit::memoryAccess() {
-  p_current_instruction->accessMemory(p_data_file);
+  setPredecodeTable(p_table);
+  // Code decoded before now is decoded again through the table
+  if (p_decode_cache) {
+    p_decode_cache->clear();
+  }
+  updateWriteObserver();
 }
 
-void ControlUnit::writeBack() { p_current_instruction->writeBack(p_reg_file); }
+void ControlUnit::setPredecodeTable(std::shared_ptr<PredecodeTable> p_table) {
+  p_predecode = p_table;
+  if (p_block_engine) {
+    p_block_engine->setPredecodeTable(p_predecode.get());
+  }
+  if (p_jit_engine) {
+    p_jit_engine->setPredecodeTable(p_predecode.get());
+  }
+  if (p_aot_engine) {
+    p_aot_engine->setPredecodeTable(p_predecode.get());
+  }
+}
 
-std::shared_ptr<RISC::Instruction>
-ControlUnit::createInstruction(std::bitset<32> instruction) {
-  std::bitset<7> opcode = p_mu->hardwareMaskBits<7, 32>(instruction, 0, 7);
-  std::bitset<3> funct3 = p_mu->hardwareMaskBits<3, 32>(instruction, 12, 3);
-  std::bitset<7> funct7 = p_mu->hardwareMaskBits<7, 32>(instruction, 25, 7);
-  std::shared_ptr<RISC::Instruction> p_instruction;
-
-  switch (opcode.to_ulong()) {
-  case 0b0110011: {
-    // RType
-    if (funct3 == 0b000 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::Add>();
-    } else if (funct3 == 0b000 && funct7 == 0b0100000) {
-      p_instruction = std::make_shared<RISC::Sub>();
-    } else if (funct3 == 0b001 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::ShiftLeftLogi>();
-    } else if (funct3 == 0b010 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::SetLessThan>();
-    } else if (funct3 == 0b011 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::SetLessThanUnsigned>();
-    } else if (funct3 == 0b100 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::Xor>();
-    } else if (funct3 == 0b101 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::ShiftRightLogi>();
-    } else if (funct3 == 0b101 && funct7 == 0b0100000) {
-      p_instruction = std::make_shared<RISC::ShiftRightArith>();
-    } else if (funct3 == 0b110 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::Or>();
-    } else if (funct3 == 0b111 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::And>();
-    } else {
-      throw std::runtime_error("Unknown R-type instruction: " +
-                               instruction.to_string());
+void ControlUnit::setDecodeCacheEnabled(bool enabled) {
+  if (enabled) {
+    p_decode_cache = std::make_shared<DecodeCache>();
+  } else {
+    p_decode_cache.reset();
+  }
+  updateWriteObserver();
+}
+
+void ControlUnit::setStatisticsEnabled(bool enabled) {
+  if (enabled) {
+    p_statistics = std::make_shared<Statistics>();
+  } else {
+    p_statistics.reset();
+  }
+  if (p_block_engine) {
+    p_block_engine->setStatistics(p_statistics.get());
+  }
+  updateWriteObserver();
+}
+
+void ControlUnit::setPipelineEnabled(bool enabled,
+                                     const PipelineConfig &config) {
+  if (enabled) {
+    p_pipeline = std::make_shared<PipelineModel>(config);
+  } else {
+    p_pipeline.reset();
+  }
+  updateWriteObserver();
+}
+
+void ControlUnit::setCachesEnabled(bool enabled,
+                                   const CacheHierarchyConfig &config) {
+  if (enabled) {
+    p_caches = std::make_shared<CacheHierarchy>(config);
+  } else {
+    p_caches.reset();
+  }
+  updateWriteObserver();
+}
+
+Snapshot ControlUnit::snapshot() {
+  Snapshot snapshot;
+  snapshot.pc = pc.to_ulong();
+  snapshot.cycles = cycles;
+  p_reg_file->copyTo(snapshot.registers);
+  snapshot.pages = p_data_file->snapshot();
+  return snapshot;
+}
+
+void ControlUnit::restore(const Snapshot &snapshot) {
+  pc = snapshot.pc;
+  cycles = snapshot.cycles;
+  p_reg_file->copyFrom(snapshot.registers);
+  p_data_file->restore(snapshot.pages);
+
+  // Nothing derived from the run or the image before the restore survives
+  if (p_pipeline) {
+    p_pipeline->reset();
+  }
+  if (p_caches) {
+    p_caches->reset();
+  }
+  setPredecodeTable(nullptr);
+  if (p_decode_cache) {
+    p_decode_cache->clear();
+  }
+  if (p_block_engine) {
+    p_block_engine->flush();
+  }
+  if (p_jit_engine) {
+    p_jit_engine->flush();
+  }
+  if (p_aot_engine) {
+    p_aot_engine->flush();
+  }
+  p_data_file->clearSignatureRange();
+  resolveSignatureRange();
+  updateWriteObserver();
+}
+
+void ControlUnit::setEngine(Engine _engine) {
+  engine = _engine;
+  if (engine != Engine::Interpreter && !p_block_engine) {
+    p_block_engine =
+        std::make_shared<BlockEngine>(p_instruction_file, p_data_file);
+    p_block_engine->setBreakpoints(breakpoints);
+    p_block_engine->setStatistics(p_statistics.get());
+    p_block_engine->setPredecodeTable(p_predecode.get());
+  }
+  if (engine == Engine::Jit && !p_jit_engine) {
+    p_jit_engine =
+        std::make_shared<JitEngine>(p_instruction_file, p_data_file);
+    p_jit_engine->setBreakpoints(breakpoints);
+    p_jit_engine->setPredecodeTable(p_predecode.get());
+  }
+  updateWriteObserver();
+}
+
+void ControlUnit::setAotProgram(const AotProgram &program) {
+  p_aot_engine =
+      std::make_shared<AotEngine>(p_instruction_file, p_data_file, program);
+  p_aot_engine->setBreakpoints(breakpoints);
+  p_aot_engine->setPredecodeTable(p_predecode.get());
+  setEngine(Engine::Aot);
+}
+
+void ControlUnit::startTrace(const std::string &filename,
+                             const std::vector<TraceRange> &ranges) {
+  stopTrace();
+  p_trace = std::make_shared<TraceWriter>(filename, ranges);
+  updateWriteObserver();
+}
+
+void ControlUnit::stopTrace() {
+  if (!p_trace) {
+    return;
+  }
+  p_trace.reset();
+  updateWriteObserver();
+}
+
+void ControlUnit::updateWriteObserver() {
+  // Only the active engine holds decoded code that stores must invalidate
+  if (usesJit()) {
+    p_jit_engine->flush();
+    p_data_file->setWriteObserver(p_jit_engine.get());
+  } else if (usesAot()) {
+    p_aot_engine->flush();
+    p_data_file->setWriteObserver(p_aot_engine.get());
+  } else if (usesBlocks()) {
+    p_block_engine->flush();
+    p_data_file->setWriteObserver(p_block_engine.get());
+  } else {
+    if (p_decode_cache) {
+      p_decode_cache->clear();
     }
-    break;
+    p_data_file->setWriteObserver(p_decode_cache.get());
   }
-  case 0b0010011: {
-    // IType
-    if (funct3 == 0b000) {
-      p_instruction = std::make_shared<RISC::AddImm>();
-    } else if (funct3 == 0b100) {
-      p_instruction = std::make_shared<RISC::XorImm>();
-    } else if (funct3 == 0b110) {
-      p_instruction = std::make_shared<RISC::OrImm>();
-    } else if (funct3 == 0b111) {
-      p_instruction = std::make_shared<RISC::AndImm>();
-    } else if (funct3 == 0b010) {
-      p_instruction = std::make_shared<RISC::SetLessThanImm>();
-    } else if (funct3 == 0b011) {
-      p_instruction = std::make_shared<RISC::SetLessThanImmUnsigned>();
-    } else if (funct3 == 0b001 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::ShiftLeftLogiImm>();
-    } else if (funct3 == 0b101 && funct7 == 0b0000000) {
-      p_instruction = std::make_shared<RISC::ShiftRightLogiImm>();
-    } else if (funct3 == 0b101 && funct7 == 0b0100000) {
-      p_instruction = std::make_shared<RISC::ShiftRightArithImm>();
-    } else {
-      throw std::runtime_error("Unknown I-type instruction: " +
-                               instruction.to_string());
+}
+
+void ControlUnit::updateBreakpoints() {
+  if (p_block_engine) {
+    p_block_engine->setBreakpoints(breakpoints);
+  }
+  if (p_jit_engine) {
+    p_jit_engine->setBreakpoints(breakpoints);
+  }
+  if (p_aot_engine) {
+    p_aot_engine->setBreakpoints(breakpoints);
+  }
+}
+
+void ControlUnit::addBreakpoint(uint32_t address) {
+  breakpoints.insert(address);
+  updateBreakpoints();
+}
+
+void ControlUnit::removeBreakpoint(uint32_t address) {
+  breakpoints.erase(address);
+  updateBreakpoints();
+}
+
+void ControlUnit::clearBreakpoints() {
+  breakpoints.clear();
+  updateBreakpoints();
+}
+
+void ControlUnit::setDeadline(std::chrono::steady_clock::time_point time) {
+  deadline = time;
+  has_deadline = true;
+}
+
+void ControlUnit::step() {
+  if (usesBlocks()) {
+    runBlocks(1, true);
+  } else {
+    runInstructions(1, true);
+  }
+}
+
+RunResult ControlUnit::run(unsigned long budget) {
+  RunResult result = {StopReason::Budget, 0, ""};
+  unsigned long start = cycles;
+
+  try {
+    while (true) {
+      unsigned long retired = cycles - start;
+      if (retired >= budget) {
+        result.reason = StopReason::Budget;
+        break;
+      }
+      if (cycles >= cycle_limit) {
+        result.reason = StopReason::CycleLimit;
+        break;
+      }
+      if (has_deadline && std::chrono::steady_clock::now() >= deadline) {
+        result.reason = StopReason::Deadline;
+        break;
+      }
+
+      unsigned long count = std::min(budget - retired, cycle_limit - cycles);
+      if (has_deadline) {
+        count = std::min(count, DEADLINE_CHECK_INTERVAL);
+      }
+      bool resuming = cycles == start;
+      bool at_breakpoint = usesBlocks() ? runBlocks(count, resuming)
+                                        : runInstructions(count, resuming);
+      if (at_breakpoint) {
+        result.reason = StopReason::Breakpoint;
+        break;
+      }
     }
-    break;
+  } catch (const EcallTrap &e) {
+    result.reason = StopReason::Ecall;
+  } catch (const EbreakTrap &e) {
+    result.reason = StopReason::Ebreak;
+  } catch (const std::exception &e) {
+    result.reason = StopReason::Error;
+    result.message = e.what();
   }
-  case 0b0000011: {
-    // IType (Load)
-    if (funct3 == 0b010) {
-      p_instruction = std::make_shared<RISC::LoadWord>();
-    } else if (funct3 == 0b001) {
-      p_instruction = std::make_shared<RISC::LoadHalfWord>();
-    } else if (funct3 == 0b000) {
-      p_instruction = std::make_shared<RISC::LoadByte>();
-    } else if (funct3 == 0b101) {
-      p_instruction = std::make_shared<RISC::LoadUnsignedHalfWord>();
-    } else if (funct3 == 0b100) {
-      p_instruction = std::make_shared<RISC::LoadUnsignedByte>();
-    } else {
-      throw std::runtime_error("Unknown I-type load instruction: " +
-                               instruction.to_string());
+
+  result.retired = cycles - start;
+  return result;
+}
+
+RunResult ControlUnit::runProgram(const std::string &signature_file,
+                                  unsigned long budget,
+                                  const std::function<void()> &on_ebreak) {
+  RunResult result = {StopReason::Budget, 0, ""};
+  while (true) {
+    RunResult run = this->run(budget - result.retired);
+    result.retired += run.retired;
+    result.reason = run.reason;
+    result.message = run.message;
+    try {
+      switch (run.reason) {
+      case StopReason::Ecall:
+      case StopReason::Budget:
+        return result;
+      case StopReason::Ebreak:
+        // Save signature for debugging and continue on ebreak
+        signature(signature_file);
+        if (on_ebreak) {
+          on_ebreak();
+        }
+        break;
+      case StopReason::Breakpoint:
+        break;
+      case StopReason::CycleLimit:
+      case StopReason::Deadline:
+      case StopReason::Error:
+        // Save signature and exit when the run fails
+        signature(signature_file);
+        return result;
+      }
+    } catch (const std::exception &e) {
+      // A test whose signature is lost has failed, whatever stopped it
+      result.message = result.message.empty()
+                           ? e.what()
+                           : result.message + "; " + e.what();
+      result.reason = StopReason::Error;
+      return result;
     }
+  }
+}
+
+int ControlUnit::exitCode(const RunResult &result, std::ostream &out) const {
+  switch (result.reason) {
+  case StopReason::Ecall:
+    return 0;
+  case StopReason::CycleLimit:
+  case StopReason::Deadline:
+    out << "Error: "
+        << (result.reason == StopReason::CycleLimit
+                ? "instruction limit reached"
+                : "timeout reached")
+        << " at pc 0x" << std::hex << programCounter() << std::dec
+        << std::endl;
+    return 1;
+  case StopReason::Error:
+    out << "Error: " << result.message << std::endl;
+    return 1;
+  case StopReason::Budget:
+  case StopReason::Ebreak:
+  case StopReason::Breakpoint:
     break;
   }
-  case 0b0100011: {
-    // SType
-    if (funct3 == 0b000) {
-      p_instruction = std::make_shared<RISC::SaveByte>();
-    } else if (funct3 == 0b001) {
-      p_instruction = std::make_shared<RISC::SaveHalfWord>();
-    } else if (funct3 == 0b010) {
-      p_instruction = std::make_shared<RISC::SaveWord>();
-    } else {
-      throw std::runtime_error("Unknown S-type instruction: " +
-                               instruction.to_string());
+  return -1;
+}
+
+bool ControlUnit::runInstructions(unsigned long count,
+                                  bool ignore_breakpoint) {
+  for (unsigned long i = 0; i < count; i++) {
+    if (!breakpoints.empty() && !(ignore_breakpoint && i == 0) &&
+        breakpoints.count(pc.to_ulong()) != 0) {
+      return true;
+    }
+
+    uint32_t current_pc = pc.to_ulong();
+    fetch();
+    bool traced = p_trace && p_trace->covers(current_pc);
+    uint32_t address = traced || p_caches ? memoryAddress() : 0;
+    decode();
+    execute();
+    memoryAccess();
+    writeBack();
+    cycles++;
+
+    if (traced) {
+      traceRetired(current_pc, address);
+    }
+    if (p_statistics) {
+      p_statistics->retire(p_current_decoded->opcode, current_pc,
+                           branchTaken());
+    }
+    if (p_pipeline || p_caches) {
+      timeRetired(current_pc, address);
     }
-    break;
   }
-  case 0b1100011: {
-    // BType
-    if (funct3 == 0b000) {
-      p_instruction = std::make_shared<RISC::BranchEqual>();
-    } else if (funct3 == 0b001) {
-      p_instruction = std::make_shared<RISC::BranchNotEqual>();
-    } else if (funct3 == 0b100) {
-      p_instruction = std::make_shared<RISC::BranchLessThan>();
-    } else if (funct3 == 0b101) {
-      p_instruction = std::make_shared<RISC::BranchGreaterThanEqual>();
-    } else if (funct3 == 0b110) {
-      p_instruction = std::make_shared<RISC::BranchLessThanUnsigned>();
-    } else if (funct3 == 0b111) {
-      p_instruction = std::make_shared<RISC::BranchGreaterThanEqualUnsigned>();
+  return false;
+}
+
+bool ControlUnit::runBlocks(unsigned long count, bool ignore_breakpoint) {
+  uint32_t registers[32];
+  p_reg_file->copyTo(registers);
+  uint32_t address = pc.to_ulong();
+  bool at_breakpoint;
+  try {
+    if (usesJit()) {
+      at_breakpoint = p_jit_engine->run(address, registers, cycles, count,
+                                        ignore_breakpoint);
+    } else if (usesAot()) {
+      at_breakpoint = p_aot_engine->run(address, registers, cycles, count,
+                                        ignore_breakpoint);
     } else {
-      throw std::runtime_error("Unknown B-type instruction: " +
-                               instruction.to_string());
+      at_breakpoint = p_block_engine->run(address, registers, cycles, count,
+                                          ignore_breakpoint);
     }
-    break;
-  }
-  case 0b0110111: {
-    // UType (LoadUpperImmediate)
-    p_instruction = std::make_shared<RISC::LoadUpperImmediate>();
-    break;
+  } catch (...) {
+    pc = address;
+    p_reg_file->copyFrom(registers);
+    throw;
   }
-  case 0b0010111: {
-    // UType (AUIPC)
-    p_instruction = std::make_shared<RISC::AddUpperImmedateToPC>();
-    break;
+  pc = address;
+  p_reg_file->copyFrom(registers);
+  return at_breakpoint;
+}
+
+uint32_t ControlUnit::memoryAddress() {
+  if (RISC::instructionInfo(p_current_decoded->opcode).access_size == 0) {
+    return 0;
   }
-  case 0b1101111: {
-    // JType (JumpAndLink)
-    p_instruction = std::make_shared<RISC::JumpAndLink>();
-    break;
+  std::bitset<32> base = p_reg_file->read(p_current_decoded->rs1);
+  return base.to_ulong() + p_current_decoded->imm;
+}
+
+void ControlUnit::traceRetired(uint32_t instruction_pc, uint32_t address) {
+  const RISC::DecodedInstruction &decoded = *p_current_decoded;
+  const RISC::InstructionInfo &info = RISC::instructionInfo(decoded.opcode);
+  TraceRecord record = {};
+  record.pc = instruction_pc;
+  record.raw = decoded.raw;
+  // Stores and branches have no rd field
+  if (decoded.rd != 0 && info.syntax != RISC::Syntax::Store &&
+      info.syntax != RISC::Syntax::Branch &&
+      info.syntax != RISC::Syntax::None) {
+    record.rd = decoded.rd;
+    record.rd_value = p_reg_file->read(decoded.rd).to_ulong();
   }
-  case 0b1100111: {
-    // IType (JumpAndLinkRegister)
-    p_instruction = std::make_shared<RISC::JumpAndLinkReg>();
-    break;
+  if (info.access_size != 0) {
+    record.mem_address = address;
+    record.mem_size = info.access_size;
+    record.is_store = info.syntax == RISC::Syntax::Store;
+    record.mem_value =
+        p_data_file->readBytes(address, info.access_size).to_ulong();
   }
-  case 0b1110011: {
-    // System (IType)
-    std::bitset<12> funct12 = p_mu->hardwareMaskBits<12, 32>(instruction, 20, 12);
-    if (funct3 == 000) {
-      if (funct12 == 0b000000000000) {
-        // Ecall
-        p_instruction = std::make_shared<RISC::Ecall>();
-      } else if (funct12 == 0b000000000001) {
-        // Ebreak
-        p_instruction = std::make_shared<RISC::Ebreak>();
-      }
-    } else {
-      throw std::runtime_error("Unknown system instruction: " +
-                               instruction.to_string());
+  p_trace->record(record);
+}
+
+void ControlUnit::timeRetired(uint32_t instruction_pc, uint32_t address) {
+  unsigned int fetch_stall = 0;
+  unsigned int memory_stall = 0;
+  if (p_caches) {
+    const RISC::InstructionInfo &info =
+        RISC::instructionInfo(p_current_decoded->opcode);
+    fetch_stall = p_caches->fetch(instruction_pc);
+    if (info.access_size != 0) {
+      memory_stall = p_caches->access(instruction_pc, address,
+                                      info.access_size,
+                                      info.syntax == RISC::Syntax::Store);
     }
-    break;
   }
-  case 0b0001111: {
-    // IType (Fence)
-    p_instruction = std::make_shared<RISC::Fence>();
-    break;
+  if (p_pipeline) {
+    p_pipeline->retire(*p_current_decoded, instruction_pc, pc.to_ulong(),
+                       branchTaken(), fetch_stall, memory_stall);
   }
-  default:
-    throw std::runtime_error("Unknown instruction: " + instruction.to_string());
+}
+
+bool ControlUnit::branchTaken() const {
+  if (RISC::instructionInfo(p_current_decoded->opcode).syntax !=
+      RISC::Syntax::Branch) {
+    return false;
   }
+  return static_cast<const RISC::BType *>(p_current_instruction)->taken;
+}
 
+void ControlUnit::fetch() {
+  if (!p_decode_cache) {
+    p_current_instruction =
+        createInstruction(p_instruction_file->read(pc), current_decoded,
+                          current_slot);
+    p_current_decoded = &current_decoded;
+    return;
+  }
+
+  const DecodeCache::Entry *p_entry = p_decode_cache->lookup(pc.to_ulong());
+  if (p_entry) {
+    p_current_instruction = p_entry->slot.get();
+    p_current_decoded = &p_entry->decoded;
+    return;
+  }
+
+  // Decode straight into the cache entry
+  DecodeCache::Entry &entry = p_decode_cache->entryFor(pc.to_ulong());
+  p_current_instruction = createInstruction(p_instruction_file->read(pc),
+                                            entry.decoded, entry.slot);
+  p_current_decoded = &entry.decoded;
+  p_decode_cache->insert(pc.to_ulong());
+}
+
+void ControlUnit::decode() { p_current_instruction->decode(p_reg_file); }
+
+void ControlUnit::execute() { p_current_instruction->execute(p_alu, pc); }
+
+void ControlUnit::memoryAccess() {
+  p_current_instruction->accessMemory(p_data_file);
+}
+
+void ControlUnit::writeBack() { p_current_instruction->writeBack(p_reg_file); }
+
+RISC::Instruction *
+ControlUnit::createInstruction(std::bitset<32> instruction,
+                               RISC::DecodedInstruction &decoded,
+                               RISC::InstructionSlot &slot) {
+  uint32_t raw = instruction.to_ulong();
+  decoded = p_predecode
+                ? RISC::decodeInstruction(
+                      raw, p_predecode->opcode(pc.to_ulong(), raw))
+                : RISC::decodeInstruction(raw);
+  if (decoded.opcode == RISC::Opcode::Illegal) {
+    throw std::runtime_error("Unknown instruction: " + instruction.to_string());
+  }
+  RISC::Instruction *p_instruction = slot.emplace(decoded.opcode);
+  p_instruction->fetch(instruction, p_mu);
+  p_instruction->generateImmediate(p_igu);
   return p_instruction;
 }
 
-void ControlUnit::signature() {
-  std::ofstream signature_file("DUT-rv32sim.signature");
+void ControlUnit::signature(const std::string &filename) {
+  std::ofstream signature_file(filename);
+  if (!signature_file.is_open()) {
+    throw std::runtime_error("Could not open/create signature file: " +
+                             filename);
+  }
   std::string signature = p_data_file->signature();
 
-  std::stringstream ss(signature);
-  std::string line;
-  int number_of_lines = 0;
-  while (std::getline(ss, line)) {
-    number_of_lines++;
-  }
-  signature_file << p_data_file->signature();
+  // Every line is 8 hex digits and a newline
+  size_t number_of_lines = signature.size() / 9;
+  signature_file << signature;
   // insert empty lines to reach a multiple of 4 (lines)
-  for (int i = number_of_lines % 4; (i > 0) && (i < 4); i++) {
+  for (size_t i = number_of_lines % 4; (i > 0) && (i < 4); i++) {
     signature_file << "00000000\n";
   }
-}
\ No newline at end of file
+  signature_file.flush();
+  if (!signature_file) {
+    throw std::runtime_error("Could not write signature file: " + filename);
+  }
+}
+
+void ControlUnit::setSignatureRange(uint32_t begin, uint32_t end) {
+  p_data_file->setSignatureRange(begin, end);
+  explicit_signature_range = {begin, end};
+  has_explicit_signature_range = true;
+}
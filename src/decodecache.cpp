@@ -0,0 +1,45 @@
+#include "decodecache.h"
+
+DecodeCache::DecodeCache(unsigned int index_bits)
+    : entries(new Entry[1u << index_bits]), entry_count(1u << index_bits),
+      index_mask((1u << index_bits) - 1), hit_count(0), miss_count(0),
+      invalidation_count(0) {}
+
+DecodeCache::Entry &DecodeCache::entryFor(uint32_t pc) {
+  Entry &entry = entries[(pc >> 2) & index_mask];
+  entry.valid = false;
+  return entry;
+}
+
+void DecodeCache::insert(uint32_t pc) {
+  Entry &entry = entries[(pc >> 2) & index_mask];
+  entry.valid = true;
+  entry.pc = pc;
+
+  // Grow the watched range to cover all four bytes of the instruction
+  if (pc < watch_begin) {
+    watch_begin = pc;
+  }
+  if (pc + 4 > watch_end) {
+    watch_end = pc + 4;
+  }
+}
+
+void DecodeCache::invalidate(uint32_t address, unsigned int n) {
+  // Any instruction starting up to three bytes before the write overlaps it
+  for (uint32_t pc = address - 3; pc != address + n; pc++) {
+    Entry &entry = entries[(pc >> 2) & index_mask];
+    if (entry.valid && entry.pc == pc) {
+      entry.valid = false;
+      invalidation_count++;
+    }
+  }
+}
+
+void DecodeCache::clear() {
+  for (unsigned int i = 0; i < entry_count; i++) {
+    entries[i].valid = false;
+  }
+  watch_begin = ~0u;
+  watch_end = 0;
+}
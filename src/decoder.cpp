@@ -0,0 +1,417 @@
+#include "decoder.h"
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RV32SIM_DECODER_AVX2
+#include <immintrin.h>
+#endif
+
+namespace RISC {
+
+namespace {
+
+/*
+=========================
+    Instruction Table
+=========================
+*/
+
+// Fields of the instruction word that identify an instruction
+const uint32_t MASK_OPCODE = 0x0000007F;
+const uint32_t MASK_FUNCT3 = 0x0000707F;
+const uint32_t MASK_FUNCT7 = 0xFE00707F;
+const uint32_t MASK_FUNCT12 = 0xFFF0707F;
+
+// One row per Opcode, in Opcode order. Illegal has a mask and match that no
+// word satisfies. JALR and FENCE accept any funct3.
+constexpr InstructionInfo instructions[] = {
+    {Opcode::Illegal, "illegal", Format::I, Syntax::None, 0, 1, 0, true},
+    // RType
+    {Opcode::Add, "add", Format::R, Syntax::Register, MASK_FUNCT7, 0x00000033,
+     0, false},
+    {Opcode::Sub, "sub", Format::R, Syntax::Register, MASK_FUNCT7, 0x40000033,
+     0, false},
+    {Opcode::Xor, "xor", Format::R, Syntax::Register, MASK_FUNCT7, 0x00004033,
+     0, false},
+    {Opcode::Or, "or", Format::R, Syntax::Register, MASK_FUNCT7, 0x00006033, 0,
+     false},
+    {Opcode::And, "and", Format::R, Syntax::Register, MASK_FUNCT7, 0x00007033,
+     0, false},
+    {Opcode::ShiftLeftLogi, "sll", Format::R, Syntax::Register, MASK_FUNCT7,
+     0x00001033, 0, false},
+    {Opcode::ShiftRightLogi, "srl", Format::R, Syntax::Register, MASK_FUNCT7,
+     0x00005033, 0, false},
+    {Opcode::ShiftRightArith, "sra", Format::R, Syntax::Register, MASK_FUNCT7,
+     0x40005033, 0, false},
+    {Opcode::SetLessThan, "slt", Format::R, Syntax::Register, MASK_FUNCT7,
+     0x00002033, 0, false},
+    {Opcode::SetLessThanUnsigned, "sltu", Format::R, Syntax::Register,
+     MASK_FUNCT7, 0x00003033, 0, false},
+    // IType
+    {Opcode::AddImm, "addi", Format::I, Syntax::Immediate, MASK_FUNCT3,
+     0x00000013, 0, false},
+    {Opcode::XorImm, "xori", Format::I, Syntax::Immediate, MASK_FUNCT3,
+     0x00004013, 0, false},
+    {Opcode::OrImm, "ori", Format::I, Syntax::Immediate, MASK_FUNCT3,
+     0x00006013, 0, false},
+    {Opcode::AndImm, "andi", Format::I, Syntax::Immediate, MASK_FUNCT3,
+     0x00007013, 0, false},
+    {Opcode::ShiftLeftLogiImm, "slli", Format::I, Syntax::Shift, MASK_FUNCT7,
+     0x00001013, 0, false},
+    {Opcode::ShiftRightLogiImm, "srli", Format::I, Syntax::Shift, MASK_FUNCT7,
+     0x00005013, 0, false},
+    {Opcode::ShiftRightArithImm, "srai", Format::I, Syntax::Shift, MASK_FUNCT7,
+     0x40005013, 0, false},
+    {Opcode::SetLessThanImm, "slti", Format::I, Syntax::Immediate, MASK_FUNCT3,
+     0x00002013, 0, false},
+    {Opcode::SetLessThanImmUnsigned, "sltiu", Format::I, Syntax::Immediate,
+     MASK_FUNCT3, 0x00003013, 0, false},
+    {Opcode::LoadWord, "lw", Format::I, Syntax::Load, MASK_FUNCT3, 0x00002003,
+     4, false},
+    {Opcode::LoadHalfWord, "lh", Format::I, Syntax::Load, MASK_FUNCT3,
+     0x00001003, 2, false},
+    {Opcode::LoadByte, "lb", Format::I, Syntax::Load, MASK_FUNCT3, 0x00000003,
+     1, false},
+    {Opcode::LoadUnsignedHalfWord, "lhu", Format::I, Syntax::Load, MASK_FUNCT3,
+     0x00005003, 2, false},
+    {Opcode::LoadUnsignedByte, "lbu", Format::I, Syntax::Load, MASK_FUNCT3,
+     0x00004003, 1, false},
+    {Opcode::JumpAndLinkReg, "jalr", Format::I, Syntax::Load, MASK_OPCODE,
+     0x00000067, 0, true},
+    {Opcode::Ecall, "ecall", Format::I, Syntax::None, MASK_FUNCT12, 0x00000073,
+     0, true},
+    {Opcode::Ebreak, "ebreak", Format::I, Syntax::None, MASK_FUNCT12,
+     0x00100073, 0, true},
+    {Opcode::Fence, "fence", Format::I, Syntax::None, MASK_OPCODE, 0x0000000F,
+     0, false},
+    // SType
+    {Opcode::SaveWord, "sw", Format::S, Syntax::Store, MASK_FUNCT3, 0x00002023,
+     4, false},
+    {Opcode::SaveHalfWord, "sh", Format::S, Syntax::Store, MASK_FUNCT3,
+     0x00001023, 2, false},
+    {Opcode::SaveByte, "sb", Format::S, Syntax::Store, MASK_FUNCT3, 0x00000023,
+     1, false},
+    // BType
+    {Opcode::BranchEqual, "beq", Format::B, Syntax::Branch, MASK_FUNCT3,
+     0x00000063, 0, true},
+    {Opcode::BranchNotEqual, "bne", Format::B, Syntax::Branch, MASK_FUNCT3,
+     0x00001063, 0, true},
+    {Opcode::BranchLessThan, "blt", Format::B, Syntax::Branch, MASK_FUNCT3,
+     0x00004063, 0, true},
+    {Opcode::BranchGreaterThanEqual, "bge", Format::B, Syntax::Branch,
+     MASK_FUNCT3, 0x00005063, 0, true},
+    {Opcode::BranchLessThanUnsigned, "bltu", Format::B, Syntax::Branch,
+     MASK_FUNCT3, 0x00006063, 0, true},
+    {Opcode::BranchGreaterThanEqualUnsigned, "bgeu", Format::B, Syntax::Branch,
+     MASK_FUNCT3, 0x00007063, 0, true},
+    // UType
+    {Opcode::LoadUpperImmediate, "lui", Format::U, Syntax::Upper, MASK_OPCODE,
+     0x00000037, 0, false},
+    {Opcode::AddUpperImmedateToPC, "auipc", Format::U, Syntax::Upper,
+     MASK_OPCODE, 0x00000017, 0, false},
+    // JType
+    {Opcode::JumpAndLink, "jal", Format::J, Syntax::Jump, MASK_OPCODE,
+     0x0000006F, 0, true}};
+
+constexpr unsigned int INSTRUCTION_COUNT =
+    sizeof(instructions) / sizeof(instructions[0]);
+
+static_assert(INSTRUCTION_COUNT == static_cast<unsigned int>(Opcode::Count),
+              "One instruction table row per opcode");
+
+constexpr bool inOpcodeOrder() {
+  for (unsigned int i = 0; i < INSTRUCTION_COUNT; i++) {
+    if (static_cast<unsigned int>(instructions[i].opcode) != i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(inOpcodeOrder(), "Instruction table rows are in Opcode order");
+
+/*
+=========================
+    Decode Table
+=========================
+*/
+
+// The first lookup is indexed by the opcode and funct3 fields. Rows sharing
+// a bucket, such as add and sub, are told apart by the rest of their masks.
+const unsigned int BUCKET_COUNT = 1 << 10;
+const unsigned int MAX_BUCKET_SIZE = 2;
+const unsigned int MAX_BUCKET_ROWS = 128;
+
+constexpr unsigned int bucketOf(uint32_t raw) {
+  return ((raw & 0x7F) << 3) | ((raw >> 12) & 0x7);
+}
+
+// True if words in \p bucket can match \p info
+constexpr bool inBucket(const InstructionInfo &info, unsigned int bucket) {
+  uint32_t fields = (bucket >> 3) | ((bucket & 0x7) << 12);
+  return (fields & info.mask & MASK_FUNCT3) == (info.match & MASK_FUNCT3);
+}
+
+struct DecodeTable {
+  uint8_t first[BUCKET_COUNT];
+  uint8_t size[BUCKET_COUNT];
+  Opcode rows[MAX_BUCKET_ROWS];
+};
+
+constexpr DecodeTable buildDecodeTable() {
+  DecodeTable table = {};
+  unsigned int next = 0;
+  for (unsigned int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+    table.first[bucket] = static_cast<uint8_t>(next);
+    for (unsigned int i = 0; i < INSTRUCTION_COUNT; i++) {
+      if (inBucket(instructions[i], bucket)) {
+        table.rows[next++] = instructions[i].opcode;
+      }
+    }
+    table.size[bucket] = static_cast<uint8_t>(next - table.first[bucket]);
+  }
+  return table;
+}
+
+constexpr DecodeTable decode_table = buildDecodeTable();
+
+constexpr bool bucketsFit() {
+  for (unsigned int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+    if (decode_table.size[bucket] > MAX_BUCKET_SIZE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(bucketsFit(), "Decoding takes at most MAX_BUCKET_SIZE compares");
+
+/*
+=========================
+    Vector Decode Table
+=========================
+*/
+
+// The decode table widened to 32-bit entries for vector gathers. An empty
+// slot holds Illegal, whose mask and match no word satisfies.
+const unsigned int OPCODE_SLOTS = 64;
+
+static_assert(INSTRUCTION_COUNT <= OPCODE_SLOTS, "Opcodes fit OPCODE_SLOTS");
+
+struct GatherTable {
+  int32_t first[BUCKET_COUNT];
+  int32_t second[BUCKET_COUNT];
+  int32_t mask[OPCODE_SLOTS];
+  int32_t match[OPCODE_SLOTS];
+};
+
+constexpr GatherTable buildGatherTable() {
+  GatherTable table = {};
+  for (unsigned int bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+    const Opcode *p_rows = decode_table.rows + decode_table.first[bucket];
+    unsigned int size = decode_table.size[bucket];
+    table.first[bucket] = size > 0 ? static_cast<int32_t>(p_rows[0]) : 0;
+    table.second[bucket] = size > 1 ? static_cast<int32_t>(p_rows[1]) : 0;
+  }
+  for (unsigned int i = 0; i < OPCODE_SLOTS; i++) {
+    const InstructionInfo &info = instructions[i < INSTRUCTION_COUNT ? i : 0];
+    table.mask[i] = static_cast<int32_t>(info.mask);
+    table.match[i] = static_cast<int32_t>(info.match);
+  }
+  return table;
+}
+
+static_assert(MAX_BUCKET_SIZE == 2, "The gather table holds two rows");
+
+constexpr GatherTable gather_table = buildGatherTable();
+
+#ifdef RV32SIM_DECODER_AVX2
+// Lanes of \p raw that are encodings of the opcodes in \p rows
+__attribute__((target("avx2"))) __m256i matchRows(__m256i raw, __m256i rows) {
+  __m256i mask = _mm256_i32gather_epi32(gather_table.mask, rows, 4);
+  __m256i match = _mm256_i32gather_epi32(gather_table.match, rows, 4);
+  return _mm256_cmpeq_epi32(_mm256_and_si256(raw, mask), match);
+}
+
+__attribute__((target("avx2"))) size_t
+classifyAvx2(const uint32_t *words, size_t count, Opcode *opcodes) {
+  const __m256i opcode_field = _mm256_set1_epi32(0x7F);
+  const __m256i funct3_field = _mm256_set1_epi32(0x7);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i raw =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + i));
+    __m256i bucket = _mm256_or_si256(
+        _mm256_slli_epi32(_mm256_and_si256(raw, opcode_field), 3),
+        _mm256_and_si256(_mm256_srli_epi32(raw, 12), funct3_field));
+    __m256i first = _mm256_i32gather_epi32(gather_table.first, bucket, 4);
+    __m256i second = _mm256_i32gather_epi32(gather_table.second, bucket, 4);
+
+    // The first row of a bucket that matches wins, as in the scalar lookup
+    __m256i result = _mm256_and_si256(second, matchRows(raw, second));
+    result = _mm256_blendv_epi8(result, first, matchRows(raw, first));
+
+    // Opcodes fit a byte; narrow each 128-bit half to four bytes
+    __m256i narrow = _mm256_packus_epi32(result, result);
+    narrow = _mm256_packus_epi16(narrow, narrow);
+    uint32_t low = _mm_cvtsi128_si32(_mm256_castsi256_si128(narrow));
+    uint32_t high = _mm_cvtsi128_si32(_mm256_extracti128_si256(narrow, 1));
+    std::memcpy(opcodes + i, &low, 4);
+    std::memcpy(opcodes + i + 4, &high, 4);
+  }
+  return i;
+}
+
+bool hasAvx2() {
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+}
+#endif
+
+/*
+=========================
+    Disassembly
+=========================
+*/
+
+std::string registerName(unsigned int index) {
+  return "x" + std::to_string(index);
+}
+
+std::string hex(uint32_t value) {
+  std::ostringstream out;
+  out << "0x" << std::hex << value;
+  return out.str();
+}
+
+uint32_t signExtend(uint32_t value, unsigned int bits) {
+  uint32_t sign = 1u << (bits - 1);
+  return (value ^ sign) - sign;
+}
+
+} // namespace
+
+const InstructionInfo &instructionInfo(Opcode opcode) {
+  return instructions[static_cast<unsigned int>(opcode)];
+}
+
+Opcode classifyInstruction(uint32_t raw) {
+  unsigned int bucket = bucketOf(raw);
+  const Opcode *p_rows = decode_table.rows + decode_table.first[bucket];
+  for (unsigned int i = 0; i < decode_table.size[bucket]; i++) {
+    const InstructionInfo &info = instructionInfo(p_rows[i]);
+    if ((raw & info.mask) == info.match) {
+      return info.opcode;
+    }
+  }
+  return Opcode::Illegal;
+}
+
+void classifyInstructions(const uint32_t *words, size_t count,
+                          Opcode *opcodes) {
+  static_assert(sizeof(Opcode) == 1, "Opcodes are stored as bytes");
+  size_t i = 0;
+#ifdef RV32SIM_DECODER_AVX2
+  if (hasAvx2()) {
+    i = classifyAvx2(words, count, opcodes);
+  }
+#endif
+  for (; i < count; i++) {
+    opcodes[i] = classifyInstruction(words[i]);
+  }
+}
+
+DecodedInstruction decodeInstruction(uint32_t raw) {
+  return decodeInstruction(raw, classifyInstruction(raw));
+}
+
+DecodedInstruction decodeInstruction(uint32_t raw, Opcode opcode) {
+  DecodedInstruction decoded;
+  decoded.raw = raw;
+  decoded.opcode = opcode;
+  decoded.rd = (raw >> 7) & 0x1F;
+  decoded.rs1 = (raw >> 15) & 0x1F;
+  decoded.rs2 = (raw >> 20) & 0x1F;
+
+  switch (instructionInfo(decoded.opcode).format) {
+  case Format::S:
+    // imm[11:5] | imm[4:0]
+    decoded.imm = signExtend(((raw >> 20) & 0xFE0) | ((raw >> 7) & 0x1F), 12);
+    break;
+  case Format::B:
+    // imm[12] | imm[10:5] | imm[4:1] | imm[11]
+    decoded.imm = signExtend(((raw >> 19) & 0x1000) | ((raw << 4) & 0x800) |
+                                 ((raw >> 20) & 0x7E0) | ((raw >> 7) & 0x1E),
+                             13);
+    break;
+  case Format::U:
+    // imm[31:12]
+    decoded.imm = raw & 0xFFFFF000;
+    break;
+  case Format::J:
+    // imm[20] | imm[10:1] | imm[11] | imm[19:12]
+    decoded.imm = signExtend(((raw >> 11) & 0x100000) | (raw & 0xFF000) |
+                                 ((raw >> 9) & 0x800) | ((raw >> 20) & 0x7FE),
+                             21);
+    break;
+  default:
+    // imm[11:0]
+    decoded.imm = signExtend(raw >> 20, 12);
+    break;
+  }
+  return decoded;
+}
+
+std::string disassemble(uint32_t raw, uint32_t pc) {
+  DecodedInstruction decoded = decodeInstruction(raw);
+  const InstructionInfo &info = instructionInfo(decoded.opcode);
+  int32_t imm = static_cast<int32_t>(decoded.imm);
+
+  std::ostringstream out;
+  if (decoded.opcode == Opcode::Illegal) {
+    out << ".word 0x" << std::hex << std::setw(8) << std::setfill('0') << raw;
+    return out.str();
+  }
+
+  out << info.mnemonic;
+  switch (info.syntax) {
+  case Syntax::None:
+    break;
+  case Syntax::Register:
+    out << " " << registerName(decoded.rd) << ", "
+        << registerName(decoded.rs1) << ", " << registerName(decoded.rs2);
+    break;
+  case Syntax::Immediate:
+    out << " " << registerName(decoded.rd) << ", "
+        << registerName(decoded.rs1) << ", " << imm;
+    break;
+  case Syntax::Shift:
+    out << " " << registerName(decoded.rd) << ", "
+        << registerName(decoded.rs1) << ", " << (decoded.imm & 0x1F);
+    break;
+  case Syntax::Load:
+    out << " " << registerName(decoded.rd) << ", " << imm << "("
+        << registerName(decoded.rs1) << ")";
+    break;
+  case Syntax::Store:
+    out << " " << registerName(decoded.rs2) << ", " << imm << "("
+        << registerName(decoded.rs1) << ")";
+    break;
+  case Syntax::Branch:
+    out << " " << registerName(decoded.rs1) << ", "
+        << registerName(decoded.rs2) << ", " << hex(pc + decoded.imm);
+    break;
+  case Syntax::Upper:
+    out << " " << registerName(decoded.rd) << ", " << hex(decoded.imm >> 12);
+    break;
+  case Syntax::Jump:
+    out << " " << registerName(decoded.rd) << ", " << hex(pc + decoded.imm);
+    break;
+  }
+  return out.str();
+}
+
+} // namespace RISC
@@ -0,0 +1,198 @@
+#include "elffile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Offsets and values from the ELF32 specification
+const uint8_t ELF_MAGIC[4] = {0x7F, 'E', 'L', 'F'};
+const uint8_t ELFCLASS32 = 1;
+const uint8_t ELFDATA2LSB = 1;
+const uint16_t ET_EXEC = 2;
+const uint16_t EM_RISCV = 243;
+const size_t EHDR_SIZE = 52;
+
+const uint32_t PT_LOAD = 1;
+const uint32_t PF_X = 1;
+const size_t PHDR_SIZE = 32;
+
+const uint32_t SHT_SYMTAB = 2;
+const size_t SHDR_SIZE = 40;
+const size_t SYM_SIZE = 16;
+const uint8_t STT_SECTION = 3;
+const uint8_t STT_FILE = 4;
+const uint16_t SHN_UNDEF = 0;
+
+} // namespace
+
+ElfFile::ElfFile(const std::string &_filename,
+                 std::shared_ptr<const MappedFile> _p_image)
+    : filename(_filename), p_image(_p_image), entry_point(0) {
+  if (!isElf(*p_image) || p_image->size() < EHDR_SIZE) {
+    throw std::runtime_error("Not an ELF file: " + filename);
+  }
+  const uint8_t *p_data = p_image->data();
+  if (p_data[4] != ELFCLASS32 || p_data[5] != ELFDATA2LSB ||
+      read16(16) != ET_EXEC || read16(18) != EM_RISCV) {
+    throw std::runtime_error(
+        "Not a little-endian ELF32 RISC-V executable: " + filename);
+  }
+
+  entry_point = read32(24);
+  readSegments(read32(28), read16(42), read16(44));
+  readSymbols(read32(32), read16(46), read16(48));
+}
+
+bool ElfFile::isElf(const MappedFile &image) {
+  return image.size() >= sizeof(ELF_MAGIC) &&
+         std::memcmp(image.data(), ELF_MAGIC, sizeof(ELF_MAGIC)) == 0;
+}
+
+const ElfSymbol *ElfFile::symbol(const std::string &name) const {
+  auto found = std::lower_bound(
+      by_name.begin(), by_name.end(), name,
+      [&](size_t index, const std::string &key) {
+        return symbol_table[index].name < key;
+      });
+  if (found == by_name.end() || symbol_table[*found].name != name) {
+    return nullptr;
+  }
+  return &symbol_table[*found];
+}
+
+const ElfSymbol *ElfFile::symbolAt(uint32_t address) const {
+  // The last symbol at or below the address
+  auto found = std::upper_bound(
+      symbol_table.begin(), symbol_table.end(), address,
+      [](uint32_t key, const ElfSymbol &symbol) {
+        return key < symbol.address;
+      });
+  if (found == symbol_table.begin()) {
+    return nullptr;
+  }
+  // Prefer a symbol whose extent covers the address, such as a function
+  // rather than a label at the same address
+  const ElfSymbol *p_closest = &*(found - 1);
+  for (auto it = found; it != symbol_table.begin(); --it) {
+    const ElfSymbol &symbol = *(it - 1);
+    if (symbol.address != p_closest->address) {
+      break;
+    }
+    if (address - symbol.address < symbol.size) {
+      return &symbol;
+    }
+  }
+  return p_closest;
+}
+
+void ElfFile::check(size_t offset, size_t size) const {
+  if (offset > p_image->size() || size > p_image->size() - offset) {
+    throw std::runtime_error("Truncated ELF file: " + filename);
+  }
+}
+
+uint32_t ElfFile::read32(size_t offset) const {
+  check(offset, 4);
+  const uint8_t *p = p_image->data() + offset;
+  return p[0] | (p[1] << 8) | (p[2] << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint16_t ElfFile::read16(size_t offset) const {
+  check(offset, 2);
+  const uint8_t *p = p_image->data() + offset;
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+void ElfFile::readSegments(uint32_t offset, uint16_t entry_size,
+                           uint16_t count) {
+  if (count != 0 && entry_size < PHDR_SIZE) {
+    throw std::runtime_error("Bad program header size in ELF file: " +
+                             filename);
+  }
+  for (uint16_t i = 0; i < count; i++) {
+    size_t header = offset + static_cast<size_t>(i) * entry_size;
+    check(header, PHDR_SIZE);
+    if (read32(header) != PT_LOAD) {
+      continue;
+    }
+    ElfSegment segment;
+    segment.file_offset = read32(header + 4);
+    segment.address = read32(header + 8);
+    segment.file_size = read32(header + 16);
+    segment.memory_size = read32(header + 20);
+    segment.executable = (read32(header + 24) & PF_X) != 0;
+    check(segment.file_offset, segment.file_size);
+    if (segment.file_size > segment.memory_size) {
+      throw std::runtime_error("Bad segment size in ELF file: " + filename);
+    }
+    load_segments.push_back(segment);
+  }
+}
+
+void ElfFile::readSymbols(uint32_t offset, uint16_t entry_size,
+                          uint16_t count) {
+  if (count != 0 && entry_size < SHDR_SIZE) {
+    throw std::runtime_error("Bad section header size in ELF file: " +
+                             filename);
+  }
+  for (uint16_t i = 0; i < count; i++) {
+    size_t header = offset + static_cast<size_t>(i) * entry_size;
+    check(header, SHDR_SIZE);
+    if (read32(header + 4) != SHT_SYMTAB) {
+      continue;
+    }
+    uint32_t table = read32(header + 16);
+    uint32_t table_size = read32(header + 20);
+    uint32_t link = read32(header + 24);
+    if (link >= count) {
+      throw std::runtime_error("Bad string table in ELF file: " + filename);
+    }
+    size_t strings_header = offset + static_cast<size_t>(link) * entry_size;
+    check(strings_header, SHDR_SIZE);
+    uint32_t strings = read32(strings_header + 16);
+    uint32_t strings_size = read32(strings_header + 20);
+    check(table, table_size);
+    check(strings, strings_size);
+
+    const char *p_strings =
+        reinterpret_cast<const char *>(p_image->data()) + strings;
+    for (uint32_t entry = table; entry + SYM_SIZE <= table + table_size;
+         entry += SYM_SIZE) {
+      uint32_t name = read32(entry);
+      uint8_t type = p_image->data()[entry + 12] & 0xF;
+      uint16_t section = read16(entry + 14);
+      if (name == 0 || name >= strings_size || section == SHN_UNDEF ||
+          type == STT_SECTION || type == STT_FILE) {
+        continue;
+      }
+      // Bounded by the string table, which need not end in a terminator
+      ElfSymbol symbol;
+      symbol.name.assign(p_strings + name,
+                         strnlen(p_strings + name, strings_size - name));
+      // Skip assembler temporaries such as .Lpcrel_hi0
+      if (symbol.name.compare(0, 2, ".L") == 0) {
+        continue;
+      }
+      symbol.address = read32(entry + 4);
+      symbol.size = read32(entry + 8);
+      symbol_table.push_back(symbol);
+    }
+  }
+
+  std::sort(symbol_table.begin(), symbol_table.end(),
+            [](const ElfSymbol &lhs, const ElfSymbol &rhs) {
+              return lhs.address != rhs.address ? lhs.address < rhs.address
+                                                : lhs.name < rhs.name;
+            });
+  by_name.resize(symbol_table.size());
+  for (size_t i = 0; i < by_name.size(); i++) {
+    by_name[i] = i;
+  }
+  std::stable_sort(by_name.begin(), by_name.end(),
+                   [&](size_t lhs, size_t rhs) {
+                     return symbol_table[lhs].name < symbol_table[rhs].name;
+                   });
+}
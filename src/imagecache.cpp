@@ -0,0 +1,83 @@
+#include "imagecache.h"
+
+#include <sys/stat.h>
+
+ImageCache &ImageCache::instance() {
+  static ImageCache cache;
+  return cache;
+}
+
+std::shared_ptr<const MappedFile>
+ImageCache::open(const std::string &filename) {
+  FileIdentity identity;
+  if (!identify(filename, identity)) {
+    // Not cacheable; let the caller see the failure
+    return std::make_shared<MappedFile>(filename);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = paths.find(filename);
+    if (found != paths.end() && found->second.identity == identity) {
+      return found->second.p_image;
+    }
+    // Another path to the same file
+    auto file = files.find(identity);
+    if (file != files.end()) {
+      if (std::shared_ptr<const MappedFile> p_cached = file->second.lock()) {
+        paths[filename] = PathEntry{identity, p_cached};
+        return p_cached;
+      }
+      files.erase(file);
+    }
+  }
+
+  // Map outside the lock, so that other threads opening cached images are
+  // not held up
+  std::shared_ptr<const MappedFile> p_image =
+      std::make_shared<MappedFile>(filename);
+  if (!p_image->isOpen()) {
+    return p_image;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  // Another thread may have mapped the file meanwhile
+  std::weak_ptr<const MappedFile> &p_file = files[identity];
+  if (std::shared_ptr<const MappedFile> p_cached = p_file.lock()) {
+    p_image = p_cached;
+  } else {
+    p_file = p_image;
+  }
+  paths[filename] = PathEntry{identity, p_image};
+  return p_image;
+}
+
+void ImageCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  paths.clear();
+  files.clear();
+}
+
+size_t ImageCache::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t count = 0;
+  for (const auto &file : files) {
+    count += !file.second.expired();
+  }
+  return count;
+}
+
+bool ImageCache::identify(const std::string &filename,
+                          FileIdentity &identity) {
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+    return false;
+  }
+  identity.device = static_cast<uint64_t>(info.st_dev);
+  identity.inode = static_cast<uint64_t>(info.st_ino);
+  identity.size = static_cast<uint64_t>(info.st_size);
+  identity.modified_ns =
+      static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+      info.st_mtim.tv_nsec;
+  return true;
+}
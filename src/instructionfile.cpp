@@ -1,16 +1,15 @@
 #include "instructionfile.h"
 
-InstructionFile::InstructionFile(std::string _memory_file)
-    : File(_memory_file) {}
+InstructionFile::InstructionFile(std::shared_ptr<MemoryFile> _p_memory)
+    : p_memory(_p_memory) {}
 
 std::bitset<32> InstructionFile::read(std::bitset<32> address) {
   u_int32_t address_long = address.to_ulong();
 
-  std::bitset<32> instruction = 0;
-  for (int i = 0; i < 4; i++) {
-    // Little Endian
-    std::bitset<8> instr_word = data.at(address_long + i);
-    instruction |= instr_word.to_ulong() << (i * 8);
+  if (!p_memory->isMapped(address_long) ||
+      !p_memory->isMapped(address_long + 3)) {
+    throw std::runtime_error("Address not found in memory: " +
+                             address.to_string());
   }
-  return instruction;
-}
\ No newline at end of file
+  return p_memory->readBytes(address, 4);
+}
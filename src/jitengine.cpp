@@ -0,0 +1,747 @@
+#include "jitengine.h"
+#include "decoder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define RV32SIM_JIT_NATIVE
+#include <sys/mman.h>
+#endif
+
+const unsigned int JitEngine::HOT_THRESHOLD;
+const size_t JitEngine::CODE_CACHE_SIZE;
+const unsigned int JitEngine::MAX_BLOCK_LENGTH;
+const size_t JitEngine::MAX_TRANSLATION_SIZE;
+
+namespace {
+
+typedef JitEngine::State State;
+
+// Translations start on a 16-byte boundary
+size_t alignCode(size_t offset) { return (offset + 15) & ~size_t(15); }
+
+// Points the rel32 at \p p_rel, which ends its jump, to \p target
+void patch(uint8_t *p_rel, const uint8_t *target) {
+  int32_t rel = static_cast<int32_t>(target - (p_rel + 4));
+  std::memcpy(p_rel, &rel, 4);
+}
+
+#ifdef RV32SIM_JIT_NATIVE
+
+/*
+=========================
+    Memory Access
+=========================
+*/
+
+// Called from translated code, which has no unwind information, so nothing
+// may be thrown through them.
+
+uint32_t loadWord(State *s, uint32_t address) noexcept {
+  return s->p_data_file->readBytes(address, 4).to_ulong();
+}
+
+uint32_t loadHalfWord(State *s, uint32_t address) noexcept {
+  return s->p_data_file->readBytes(address, 2, true).to_ulong();
+}
+
+uint32_t loadByte(State *s, uint32_t address) noexcept {
+  return s->p_data_file->readBytes(address, 1, true).to_ulong();
+}
+
+uint32_t loadUnsignedHalfWord(State *s, uint32_t address) noexcept {
+  return s->p_data_file->readBytes(address, 2).to_ulong();
+}
+
+uint32_t loadUnsignedByte(State *s, uint32_t address) noexcept {
+  return s->p_data_file->readBytes(address, 1).to_ulong();
+}
+
+void saveWord(State *s, uint32_t address, uint32_t value) noexcept {
+  s->p_data_file->writeBytes(address, value, 4);
+}
+
+void saveHalfWord(State *s, uint32_t address, uint32_t value) noexcept {
+  s->p_data_file->writeBytes(address, value, 2);
+}
+
+void saveByte(State *s, uint32_t address, uint32_t value) noexcept {
+  s->p_data_file->writeBytes(address, value, 1);
+}
+
+/*
+=========================
+    x86-64 Emitter
+=========================
+*/
+
+enum Reg : uint8_t { EAX = 0, ECX = 1, EDX = 2, EBX = 3, ESI = 6, EDI = 7 };
+
+// The /digit of the group 1 instructions; op r32, r/m32 is (op << 3) | 3
+enum AluOp : uint8_t { ADD = 0, OR = 1, AND = 4, SUB = 5, XOR = 6, CMP = 7 };
+
+enum ShiftOp : uint8_t { SHL = 4, SHR = 5, SAR = 7 };
+
+enum Condition : uint8_t {
+  BELOW = 0x2,
+  ABOVE_EQUAL = 0x3,
+  EQUAL = 0x4,
+  NOT_EQUAL = 0x5,
+  LESS = 0xC,
+  GREATER_EQUAL = 0xD
+};
+
+const uint32_t PC_OFFSET = offsetof(State, pc);
+const uint32_t BUDGET_OFFSET = offsetof(State, budget);
+const uint32_t EXIT_OFFSET = offsetof(State, p_exit);
+const uint32_t MODIFIED_OFFSET = offsetof(State, code_modified);
+
+// Writes machine code at a cursor. Translated code holds the State in rbx
+// and the budget in r12, both callee-saved, so they survive the calls into
+// the memory helpers.
+class Emitter {
+public:
+  explicit Emitter(uint8_t *_p) : p(_p) {}
+
+  uint8_t *position() const { return p; }
+
+  // Saves the callee-saved registers and jumps to the translation in rsi
+  // with the State in rdi
+  void enter() {
+    byte(0x53);                     // push rbx
+    bytes({0x41, 0x54});            // push r12
+    bytes({0x48, 0x83, 0xEC, 0x08}); // sub rsp, 8 (keeps calls aligned)
+    bytes({0x48, 0x89, 0xFB});      // mov rbx, rdi
+    bytes({0x4C, 0x8B, 0xA3});      // mov r12, [rbx + budget]
+    word(BUDGET_OFFSET);
+    bytes({0xFF, 0xE6}); // jmp rsi
+  }
+
+  // Returns to the engine, with the exit to link in rax
+  void leave() {
+    bytes({0x4C, 0x89, 0xA3}); // mov [rbx + budget], r12
+    word(BUDGET_OFFSET);
+    bytes({0x48, 0x89, 0x83}); // mov [rbx + p_exit], rax
+    word(EXIT_OFFSET);
+    bytes({0x48, 0x83, 0xC4, 0x08}); // add rsp, 8
+    bytes({0x41, 0x5C});             // pop r12
+    byte(0x5B);                      // pop rbx
+    byte(0xC3);                      // ret
+  }
+
+  // mov reg, x[r]
+  void loadGuest(Reg reg, unsigned int r) {
+    byte(0x8B);
+    guest(reg, r);
+  }
+
+  // mov x[r], reg
+  void storeGuest(unsigned int r, Reg reg) {
+    byte(0x89);
+    guest(reg, r);
+  }
+
+  // mov x[r], imm
+  void storeGuestImm(unsigned int r, uint32_t imm) {
+    byte(0xC7);
+    guest(0, r);
+    word(imm);
+  }
+
+  // op reg, x[r]
+  void aluGuest(AluOp op, Reg reg, unsigned int r) {
+    byte(static_cast<uint8_t>(op << 3 | 3));
+    guest(reg, r);
+  }
+
+  // op reg, imm
+  void aluImm(AluOp op, Reg reg, uint32_t imm) {
+    byte(0x81);
+    byte(static_cast<uint8_t>(0xC0 | op << 3 | reg));
+    word(imm);
+  }
+
+  // op x[r], imm
+  void aluGuestImm(AluOp op, unsigned int r, uint32_t imm) {
+    byte(0x81);
+    guest(op, r);
+    word(imm);
+  }
+
+  // op reg, cl
+  void shift(ShiftOp op, Reg reg) {
+    byte(0xD3);
+    byte(static_cast<uint8_t>(0xC0 | op << 3 | reg));
+  }
+
+  // op reg, n
+  void shift(ShiftOp op, Reg reg, uint8_t n) {
+    byte(0xC1);
+    byte(static_cast<uint8_t>(0xC0 | op << 3 | reg));
+    byte(n);
+  }
+
+  // eax = condition ? 1 : 0
+  void set(Condition condition) {
+    bytes({0x0F, static_cast<uint8_t>(0x90 | condition), 0xC0}); // setcc al
+    bytes({0x0F, 0xB6, 0xC0}); // movzx eax, al
+  }
+
+  // Calls \p p_function with the State as its first argument
+  void call(const void *p_function) {
+    bytes({0x48, 0x89, 0xDF}); // mov rdi, rbx
+    bytes({0x48, 0xB8});       // mov rax, p_function
+    quad(reinterpret_cast<uint64_t>(p_function));
+    bytes({0xFF, 0xD0}); // call rax
+  }
+
+  // op r12, imm
+  void budget(AluOp op, uint32_t imm) {
+    bytes({0x49, 0x81, static_cast<uint8_t>(0xC4 | op << 3)});
+    word(imm);
+  }
+
+  // cmp byte [rbx + code_modified], 0
+  void testModified() {
+    bytes({0x80, 0xBB});
+    word(MODIFIED_OFFSET);
+    byte(0);
+  }
+
+  // mov [rbx + pc], imm
+  void storePc(uint32_t pc) {
+    bytes({0xC7, 0x83});
+    word(PC_OFFSET);
+    word(pc);
+  }
+
+  // mov [rbx + pc], reg
+  void storePc(Reg reg) {
+    bytes({0x89, static_cast<uint8_t>(0x83 | reg << 3)});
+    word(PC_OFFSET);
+  }
+
+  // jcc with its target left to patch(); returns the rel32
+  uint8_t *jump(Condition condition) {
+    bytes({0x0F, static_cast<uint8_t>(0x80 | condition)});
+    word(0);
+    return p - 4;
+  }
+
+  // jmp with its target left to patch(); until then it falls through
+  uint8_t *jump() {
+    byte(0xE9);
+    word(0);
+    return p - 4;
+  }
+
+  void jump(const uint8_t *target) { patch(jump(), target); }
+
+  // Leaves for \p pc without a link
+  void exit(uint32_t pc, const uint8_t *p_leave) {
+    storePc(pc);
+    exit(p_leave);
+  }
+
+  // Leaves for the PC already stored, without a link
+  void exit(const uint8_t *p_leave) {
+    bytes({0x31, 0xC0}); // xor eax, eax
+    jump(p_leave);
+  }
+
+  // Leaves for \p pc through a jump that initially falls through to the
+  // exit, and that is patched to go straight to the translation of \p pc
+  // once there is one
+  void exitLinked(uint32_t pc, const uint8_t *p_leave) {
+    uint8_t *p_link = jump();
+    storePc(pc);
+    bytes({0x48, 0xB8}); // mov rax, p_link
+    quad(reinterpret_cast<uint64_t>(p_link));
+    jump(p_leave);
+  }
+
+private:
+  uint8_t *p;
+
+  void byte(uint8_t b) { *p++ = b; }
+
+  void bytes(std::initializer_list<uint8_t> list) {
+    for (uint8_t b : list) {
+      byte(b);
+    }
+  }
+
+  void word(uint32_t w) {
+    std::memcpy(p, &w, 4);
+    p += 4;
+  }
+
+  void quad(uint64_t q) {
+    std::memcpy(p, &q, 8);
+    p += 8;
+  }
+
+  // The ModRM and displacement of x[r], [rbx + 4 * r]
+  void guest(uint8_t reg, unsigned int r) {
+    byte(static_cast<uint8_t>(0x40 | reg << 3 | EBX));
+    byte(static_cast<uint8_t>(4 * r));
+  }
+};
+
+/*
+=========================
+    Translation
+=========================
+*/
+
+bool isTranslatable(RISC::Opcode opcode) {
+  return opcode != RISC::Opcode::Illegal && opcode != RISC::Opcode::Ecall &&
+         opcode != RISC::Opcode::Ebreak;
+}
+
+// An exit taken when a store overwrote decoded code
+struct ModifiedExit {
+  uint8_t *p_rel;
+  // Instructions of the block after the store
+  unsigned int refund;
+  uint32_t next_pc;
+};
+
+void emitRType(Emitter &e, const RISC::DecodedInstruction &d) {
+  if (d.rd == 0) {
+    return;
+  }
+  switch (d.opcode) {
+  case RISC::Opcode::ShiftLeftLogi:
+  case RISC::Opcode::ShiftRightLogi:
+  case RISC::Opcode::ShiftRightArith:
+    // x86 masks 32-bit shift counts to five bits, as RV32I does
+    e.loadGuest(ECX, d.rs2);
+    e.loadGuest(EAX, d.rs1);
+    e.shift(d.opcode == RISC::Opcode::ShiftLeftLogi    ? SHL
+            : d.opcode == RISC::Opcode::ShiftRightLogi ? SHR
+                                                       : SAR,
+            EAX);
+    break;
+  case RISC::Opcode::SetLessThan:
+  case RISC::Opcode::SetLessThanUnsigned:
+    e.loadGuest(EAX, d.rs1);
+    e.aluGuest(CMP, EAX, d.rs2);
+    e.set(d.opcode == RISC::Opcode::SetLessThan ? LESS : BELOW);
+    break;
+  default:
+    e.loadGuest(EAX, d.rs1);
+    e.aluGuest(d.opcode == RISC::Opcode::Add   ? ADD
+               : d.opcode == RISC::Opcode::Sub ? SUB
+               : d.opcode == RISC::Opcode::Xor ? XOR
+               : d.opcode == RISC::Opcode::Or  ? OR
+                                               : AND,
+               EAX, d.rs2);
+    break;
+  }
+  e.storeGuest(d.rd, EAX);
+}
+
+void emitIType(Emitter &e, const RISC::DecodedInstruction &d) {
+  if (d.rd == 0) {
+    return;
+  }
+  switch (d.opcode) {
+  case RISC::Opcode::AddImm:
+    if (d.rs1 == 0) {
+      e.storeGuestImm(d.rd, d.imm);
+    } else if (d.rs1 == d.rd) {
+      e.aluGuestImm(ADD, d.rd, d.imm);
+    } else {
+      e.loadGuest(EAX, d.rs1);
+      e.aluImm(ADD, EAX, d.imm);
+      e.storeGuest(d.rd, EAX);
+    }
+    return;
+  case RISC::Opcode::ShiftLeftLogiImm:
+  case RISC::Opcode::ShiftRightLogiImm:
+  case RISC::Opcode::ShiftRightArithImm:
+    e.loadGuest(EAX, d.rs1);
+    e.shift(d.opcode == RISC::Opcode::ShiftLeftLogiImm    ? SHL
+            : d.opcode == RISC::Opcode::ShiftRightLogiImm ? SHR
+                                                          : SAR,
+            EAX, static_cast<uint8_t>(d.imm & 0x1F));
+    break;
+  case RISC::Opcode::SetLessThanImm:
+  case RISC::Opcode::SetLessThanImmUnsigned:
+    e.loadGuest(EAX, d.rs1);
+    e.aluImm(CMP, EAX, d.imm);
+    e.set(d.opcode == RISC::Opcode::SetLessThanImm ? LESS : BELOW);
+    break;
+  default:
+    e.loadGuest(EAX, d.rs1);
+    e.aluImm(d.opcode == RISC::Opcode::XorImm  ? XOR
+             : d.opcode == RISC::Opcode::OrImm ? OR
+                                               : AND,
+             EAX, d.imm);
+    break;
+  }
+  e.storeGuest(d.rd, EAX);
+}
+
+void emitLoad(Emitter &e, const RISC::DecodedInstruction &d) {
+  if (d.rd == 0) {
+    return;
+  }
+  const void *p_helper;
+  switch (d.opcode) {
+  case RISC::Opcode::LoadWord:
+    p_helper = reinterpret_cast<const void *>(loadWord);
+    break;
+  case RISC::Opcode::LoadHalfWord:
+    p_helper = reinterpret_cast<const void *>(loadHalfWord);
+    break;
+  case RISC::Opcode::LoadByte:
+    p_helper = reinterpret_cast<const void *>(loadByte);
+    break;
+  case RISC::Opcode::LoadUnsignedHalfWord:
+    p_helper = reinterpret_cast<const void *>(loadUnsignedHalfWord);
+    break;
+  default:
+    p_helper = reinterpret_cast<const void *>(loadUnsignedByte);
+    break;
+  }
+  e.loadGuest(ESI, d.rs1);
+  if (d.imm != 0) {
+    e.aluImm(ADD, ESI, d.imm);
+  }
+  e.call(p_helper);
+  e.storeGuest(d.rd, EAX);
+}
+
+void emitStore(Emitter &e, const RISC::DecodedInstruction &d) {
+  const void *p_helper;
+  switch (d.opcode) {
+  case RISC::Opcode::SaveWord:
+    p_helper = reinterpret_cast<const void *>(saveWord);
+    break;
+  case RISC::Opcode::SaveHalfWord:
+    p_helper = reinterpret_cast<const void *>(saveHalfWord);
+    break;
+  default:
+    p_helper = reinterpret_cast<const void *>(saveByte);
+    break;
+  }
+  e.loadGuest(ESI, d.rs1);
+  if (d.imm != 0) {
+    e.aluImm(ADD, ESI, d.imm);
+  }
+  e.loadGuest(EDX, d.rs2);
+  e.call(p_helper);
+}
+
+Condition branchCondition(RISC::Opcode opcode) {
+  switch (opcode) {
+  case RISC::Opcode::BranchEqual:
+    return EQUAL;
+  case RISC::Opcode::BranchNotEqual:
+    return NOT_EQUAL;
+  case RISC::Opcode::BranchLessThan:
+    return LESS;
+  case RISC::Opcode::BranchGreaterThanEqual:
+    return GREATER_EQUAL;
+  case RISC::Opcode::BranchLessThanUnsigned:
+    return BELOW;
+  default:
+    return ABOVE_EQUAL;
+  }
+}
+
+#endif // RV32SIM_JIT_NATIVE
+
+} // namespace
+
+JitEngine::JitEngine(std::shared_ptr<InstructionFile> _p_instruction_file,
+                     std::shared_ptr<MemoryFile> _p_data_file)
+    : p_instruction_file(_p_instruction_file), p_data_file(_p_data_file),
+      interpreter(_p_instruction_file, _p_data_file), translated(0),
+      p_predecode(nullptr), p_code_cache(nullptr), p_enter(nullptr),
+      p_leave(nullptr), code_start(0), code_used(0) {
+  state.code_modified = false;
+#ifdef RV32SIM_JIT_NATIVE
+  void *p_memory = mmap(nullptr, CODE_CACHE_SIZE,
+                        PROT_READ | PROT_WRITE | PROT_EXEC,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p_memory == MAP_FAILED) {
+    // Hosts that forbid writable code run everything in the BlockEngine
+    return;
+  }
+  p_code_cache = static_cast<uint8_t *>(p_memory);
+  Emitter e(p_code_cache);
+  p_enter = reinterpret_cast<Entry>(e.position());
+  e.enter();
+  p_leave = e.position();
+  e.leave();
+  code_start = alignCode(e.position() - p_code_cache);
+  code_used = code_start;
+#endif
+}
+
+JitEngine::~JitEngine() {
+#ifdef RV32SIM_JIT_NATIVE
+  if (p_code_cache != nullptr) {
+    munmap(p_code_cache, CODE_CACHE_SIZE);
+  }
+#endif
+}
+
+bool JitEngine::run(uint32_t &pc, uint32_t *registers,
+                    unsigned long &retired, unsigned long budget,
+                    bool ignore_breakpoint) {
+  std::copy(registers, registers + 32, state.x);
+  state.x[0] = 0;
+  state.pc = pc;
+  state.p_exit = nullptr;
+  state.p_data_file = p_data_file.get();
+  state.code_modified = false;
+
+  bool at_breakpoint = false;
+  try {
+    // The exit that left the last translated block, to link to the next one
+    uint8_t *p_link = nullptr;
+    bool first = true;
+    while (budget > 0) {
+      // Translations end before breakpoints and are not linked to them, so
+      // they can only be reached here
+      if (!breakpoints.empty() && !(ignore_breakpoint && first) &&
+          breakpoints.count(state.pc) != 0) {
+        at_breakpoint = true;
+        break;
+      }
+      first = false;
+
+      if (isNative() && code_used + MAX_TRANSLATION_SIZE > CODE_CACHE_SIZE) {
+        flush();
+        p_link = nullptr;
+      }
+
+      Translation &translation = translations[state.pc];
+      if (!translation.watched) {
+        watch(state.pc);
+        translation.watched = true;
+      }
+      if (translation.p_code == nullptr && !translation.interpret_only &&
+          isNative() && ++translation.count >= HOT_THRESHOLD) {
+        translate(state.pc, translation);
+      }
+
+      if (translation.p_code != nullptr && translation.length <= budget) {
+        if (p_link != nullptr) {
+          patch(p_link, translation.p_code);
+        }
+        state.budget = static_cast<int64_t>(std::min<unsigned long>(
+            budget, std::numeric_limits<int64_t>::max()));
+        int64_t before = state.budget;
+        p_enter(&state, translation.p_code);
+        unsigned long completed =
+            static_cast<unsigned long>(before - state.budget);
+        retired += completed;
+        budget -= completed;
+        p_link = state.p_exit;
+      } else {
+        unsigned long before = retired;
+        interpret(retired, budget);
+        budget -= retired - before;
+        p_link = nullptr;
+      }
+
+      if (state.code_modified) {
+        flush();
+        p_link = nullptr;
+      }
+    }
+  } catch (...) {
+    pc = state.pc;
+    std::copy(state.x, state.x + 32, registers);
+    if (state.code_modified) {
+      flush();
+    }
+    throw;
+  }
+
+  pc = state.pc;
+  std::copy(state.x, state.x + 32, registers);
+  return at_breakpoint;
+}
+
+void JitEngine::interpret(unsigned long &retired, unsigned long budget) {
+  // A block that traps on its first word still has to run to raise it
+  unsigned int length = std::max(interpreter.block(state.pc).length, 1u);
+  unsigned long count = std::min<unsigned long>(budget, length);
+  interpreter.run(state.pc, state.x, retired, count, true);
+}
+
+void JitEngine::translate(uint32_t pc, Translation &translation) {
+#ifdef RV32SIM_JIT_NATIVE
+  std::vector<RISC::DecodedInstruction> code;
+  uint32_t address = pc;
+  while (code.size() < MAX_BLOCK_LENGTH &&
+         (address == pc || breakpoints.count(address) == 0)) {
+    uint32_t raw;
+    try {
+      raw = p_instruction_file->read(address).to_ulong();
+    } catch (const std::exception &) {
+      break;
+    }
+    RISC::DecodedInstruction decoded =
+        p_predecode != nullptr
+            ? RISC::decodeInstruction(raw, p_predecode->opcode(address, raw))
+            : RISC::decodeInstruction(raw);
+    if (!isTranslatable(decoded.opcode)) {
+      break;
+    }
+    code.push_back(decoded);
+    address += 4;
+    if (RISC::endsBlock(decoded.opcode)) {
+      break;
+    }
+  }
+  if (code.empty()) {
+    translation.interpret_only = true;
+    return;
+  }
+
+  unsigned int length = static_cast<unsigned int>(code.size());
+  uint8_t *p_start = p_code_cache + code_used;
+  Emitter e(p_start);
+
+  // Run the whole block or none of it
+  e.budget(CMP, length);
+  uint8_t *p_no_budget = e.jump(LESS);
+  e.budget(SUB, length);
+
+  std::vector<ModifiedExit> modified_exits;
+  bool ended = false;
+  for (unsigned int i = 0; i < length; i++) {
+    const RISC::DecodedInstruction &d = code[i];
+    uint32_t instruction_pc = pc + 4 * i;
+    const RISC::InstructionInfo &info = RISC::instructionInfo(d.opcode);
+
+    if (info.syntax == RISC::Syntax::Store) {
+      emitStore(e, d);
+      e.testModified();
+      modified_exits.push_back(
+          {e.jump(NOT_EQUAL), length - i - 1, instruction_pc + 4});
+    } else if (info.access_size != 0) {
+      emitLoad(e, d);
+    } else if (d.opcode >= RISC::Opcode::Add &&
+               d.opcode <= RISC::Opcode::SetLessThanUnsigned) {
+      emitRType(e, d);
+    } else if (d.opcode >= RISC::Opcode::AddImm &&
+               d.opcode <= RISC::Opcode::SetLessThanImmUnsigned) {
+      emitIType(e, d);
+    } else if (d.opcode == RISC::Opcode::LoadUpperImmediate) {
+      if (d.rd != 0) {
+        e.storeGuestImm(d.rd, d.imm);
+      }
+    } else if (d.opcode == RISC::Opcode::AddUpperImmedateToPC) {
+      if (d.rd != 0) {
+        e.storeGuestImm(d.rd, instruction_pc + d.imm);
+      }
+    } else if (d.opcode == RISC::Opcode::JumpAndLink) {
+      if (d.rd != 0) {
+        e.storeGuestImm(d.rd, instruction_pc + 4);
+      }
+      e.exitLinked(instruction_pc + d.imm, p_leave);
+      ended = true;
+    } else if (d.opcode == RISC::Opcode::JumpAndLinkReg) {
+      // The target is read before rd is written, as rd may be rs1
+      e.loadGuest(EAX, d.rs1);
+      e.aluImm(ADD, EAX, d.imm);
+      e.storePc(EAX);
+      if (d.rd != 0) {
+        e.storeGuestImm(d.rd, instruction_pc + 4);
+      }
+      e.exit(p_leave);
+      ended = true;
+    } else if (info.syntax == RISC::Syntax::Branch) {
+      e.loadGuest(EAX, d.rs1);
+      e.aluGuest(CMP, EAX, d.rs2);
+      uint8_t *p_taken = e.jump(branchCondition(d.opcode));
+      e.exitLinked(instruction_pc + 4, p_leave);
+      patch(p_taken, e.position());
+      e.exitLinked(instruction_pc + d.imm, p_leave);
+      ended = true;
+    }
+    // Fence needs no code, as translated code runs on one thread
+  }
+  if (!ended) {
+    // Stopped at the length limit, a breakpoint or an untranslatable word
+    e.exitLinked(address, p_leave);
+  }
+
+  // Exits that are rarely taken go after the block
+  patch(p_no_budget, e.position());
+  e.exit(pc, p_leave);
+  for (const ModifiedExit &modified : modified_exits) {
+    patch(modified.p_rel, e.position());
+    if (modified.refund > 0) {
+      e.budget(ADD, modified.refund);
+    }
+    e.exit(modified.next_pc, p_leave);
+  }
+
+  code_used = alignCode(e.position() - p_code_cache);
+  translation.p_code = p_start;
+  translation.length = length;
+  translated++;
+#else
+  translation.interpret_only = true;
+#endif
+}
+
+void JitEngine::flush() {
+  translations.clear();
+  translated = 0;
+  code_words.clear();
+  code_used = code_start;
+  interpreter.flush();
+  watch_begin = ~0u;
+  watch_end = 0;
+  state.code_modified = false;
+}
+
+void JitEngine::setBreakpoints(const std::set<uint32_t> &_breakpoints) {
+  breakpoints = _breakpoints;
+  interpreter.setBreakpoints(breakpoints);
+  flush();
+}
+
+void JitEngine::setPredecodeTable(const PredecodeTable *_p_predecode) {
+  p_predecode = _p_predecode;
+  interpreter.setPredecodeTable(p_predecode);
+}
+
+void JitEngine::watch(uint32_t pc) {
+  // The BlockEngine's block spans the translation of the same PC, and also
+  // the word that ends it
+  const BlockEngine::Block &block = interpreter.block(pc);
+  uint32_t end = block.ops.back().pc + 4;
+  for (uint32_t address = pc; address != end; address += 4) {
+    code_words.insert(address >> 2);
+  }
+  watch_begin = std::min(watch_begin, pc);
+  watch_end = std::max(watch_end, end);
+}
+
+void JitEngine::onWrite(uint32_t address, unsigned int n) {
+  // The watch range spans all decoded code, so also check the words, which
+  // keeps data stored between blocks from discarding them
+  if (code_words.count(address >> 2) == 0 &&
+      code_words.count((address + n - 1) >> 2) == 0) {
+    return;
+  }
+  state.code_modified = true;
+  // Ends the block the BlockEngine is running, if any
+  interpreter.onWrite(address, n);
+}
@@ -1,34 +1,517 @@
+#include "batchrunner.h"
 #include "controlunit.h"
+#include "imagecache.h"
+#include "options.h"
+
+#include <cstring>
+#include <iomanip>
+
+// Prints \p size bytes of code loaded at \p address as assembly, with a
+// label line wherever \p p_elf has a symbol
+void disassembleWords(const uint8_t *p_bytes, size_t size, uint32_t address,
+                      const ElfFile *p_elf) {
+  const std::vector<ElfSymbol> *p_symbols =
+      p_elf ? &p_elf->symbols() : nullptr;
+  size_t next_symbol = 0;
+
+  for (size_t offset = 0; offset + 4 <= size; offset += 4, address += 4) {
+    while (p_symbols && next_symbol < p_symbols->size() &&
+           (*p_symbols)[next_symbol].address <= address) {
+      const ElfSymbol &symbol = (*p_symbols)[next_symbol++];
+      if (symbol.address == address) {
+        std::cout << "\n<" << symbol.name << ">:\n";
+      }
+    }
+    // Little Endian
+    const uint8_t *bytes = p_bytes + offset;
+    uint32_t raw = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+                   (static_cast<uint32_t>(bytes[3]) << 24);
+    std::cout << std::hex << std::setfill('0') << std::setw(8) << address
+              << ":  " << std::setw(8) << raw << "  " << std::dec
+              << RISC::disassemble(raw, address) << "\n";
+  }
+}
+
+// Prints every word of the program image as assembly, or the executable
+// segments of an ELF file
+int disassembleFile(const std::string &bin_file) {
+  std::shared_ptr<const MappedFile> p_image =
+      ImageCache::instance().open(bin_file);
+  if (!p_image->isOpen()) {
+    std::cerr << "Error: could not open file " << bin_file << std::endl;
+    return 1;
+  }
+  if (!ElfFile::isElf(*p_image)) {
+    disassembleWords(p_image->data(), p_image->size(), 0, nullptr);
+    return 0;
+  }
+
+  try {
+    ElfFile elf(bin_file, p_image);
+    for (const ElfSegment &segment : elf.segments()) {
+      if (segment.executable) {
+        disassembleWords(p_image->data() + segment.file_offset,
+                         segment.file_size, segment.address, &elf);
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Parses BEGIN:END, end exclusive, with BEGIN not above END
+bool parseRange(const std::string &text, TraceRange &range) {
+  size_t colon = text.find(':');
+  return colon != std::string::npos &&
+         parseAddress(text.substr(0, colon), range.begin) &&
+         parseAddress(text.substr(colon + 1), range.end) &&
+         range.begin <= range.end;
+}
+
+// Worker threads of a batch, far beyond any host's hardware threads
+const unsigned long MAX_JOBS = 1024;
+
+// Cycles of a memory access, kept small enough that the stall cycles of an
+// access cannot overflow
+const unsigned long MAX_MEMORY_LATENCY = 1000000;
+
+// Options that only apply to a single run, by prefix. Batch mode rejects
+// them rather than ignoring them.
+const char *const SINGLE_RUN_OPTIONS[] = {
+    "--disassemble", "--decode-stats", "--predecode", "--signature=",
+    "--signature-range=", "--stats", "--pipeline", "--no-forwarding",
+    "--predictor", "--return-stack=", "--caches", "--cache-", "--l1i=",
+    "--l1d=", "--l2=", "--memory-latency=", "--save-snapshot=",
+    "--snapshot-at=", "--restore-snapshot=", "--trace"};
+
+bool isSingleRunOption(const std::string &arg) {
+  for (const char *p_option : SINGLE_RUN_OPTIONS) {
+    if (arg.compare(0, std::strlen(p_option), p_option) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reports an option whose value could not be parsed
+void badValue(const std::string &arg) {
+  std::cerr << "Error: bad value in " << arg << std::endl;
+}
+
+// Writes the state of \p cu to \p filename
+bool saveSnapshot(ControlUnit &cu, const std::string &filename) {
+  try {
+    cu.snapshot().save(filename);
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Runs every binary in \p paths in parallel and reports the results
+int runBatch(const std::vector<std::string> &paths, const BatchOptions &options,
+             const std::string &report_file) {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::vector<TestResult> results;
+  try {
+    BatchRunner runner(options);
+    results = runner.run(BatchRunner::collectBinaries(paths));
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  BatchRunner::printReport(results, seconds, std::cerr);
+  if (!report_file.empty()) {
+    std::ofstream file(report_file);
+    if (!file.is_open()) {
+      std::cerr << "Error: could not open file " << report_file << std::endl;
+      return 1;
+    }
+    BatchRunner::writeJson(results, seconds, file);
+  }
+
+  for (const TestResult &result : results) {
+    if (!result.passed) {
+      return 1;
+    }
+  }
+  return 0;
+}
 
 int main(int argc, char **argv) {
-  if (argc < 2) {
-    std::cerr << "Usage: " << argv[0] << " <bin_file>" << std::endl;
+  std::vector<std::string> inputs;
+  MemoryBackend backend = MemoryBackend::Paged;
+  bool decode_cache = true;
+  bool decode_stats = false;
+  bool predecode = false;
+  Engine engine = Engine::Interpreter;
+  unsigned long max_instructions = ControlUnit::UNLIMITED;
+  double timeout = 0;
+  bool disassemble = false;
+  bool stats = false;
+  std::string signature_file = "DUT-rv32sim.signature";
+  std::string stats_json;
+  bool pipeline = false;
+  PipelineConfig pipeline_config;
+  std::string pipeline_json;
+  bool caches = false;
+  CacheHierarchyConfig cache_config;
+  std::string cache_json;
+  bool batch = false;
+  BatchOptions batch_options;
+  std::string report_file;
+  std::string save_snapshot;
+  unsigned long snapshot_at = ControlUnit::UNLIMITED;
+  std::string restore_snapshot;
+  std::string trace_file;
+  std::vector<TraceRange> trace_ranges;
+  bool has_signature_range = false;
+  TraceRange signature_range = {0, 0};
+
+  std::string single_run_option;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (single_run_option.empty() && isSingleRunOption(arg)) {
+      single_run_option = arg;
+    }
+    if (arg == "--map-memory") {
+      // Original ordered-map storage, handy when inspecting memory contents
+      backend = MemoryBackend::Map;
+    } else if (arg == "--no-decode-cache") {
+      decode_cache = false;
+    } else if (arg == "--decode-stats") {
+      decode_stats = true;
+    } else if (arg == "--predecode") {
+      // Classify the code before running, rejecting reachable illegal words
+      predecode = true;
+    } else if (arg == "--disassemble") {
+      disassemble = true;
+    } else if (arg.compare(0, 12, "--signature=") == 0) {
+      signature_file = arg.substr(12);
+    } else if (arg == "--stats") {
+      stats = true;
+    } else if (arg.compare(0, 13, "--stats-json=") == 0) {
+      stats_json = arg.substr(13);
+    } else if (arg == "--pipeline") {
+      pipeline = true;
+    } else if (arg == "--no-forwarding") {
+      pipeline_config.forwarding = false;
+    } else if (arg == "--predictor=not-taken") {
+      pipeline_config.predictor = PredictorKind::NotTaken;
+    } else if (arg == "--predictor=bimodal") {
+      pipeline_config.predictor = PredictorKind::Bimodal;
+    } else if (arg == "--predictor=gshare") {
+      pipeline_config.predictor = PredictorKind::GShare;
+    } else if (arg.compare(0, 17, "--predictor-bits=") == 0) {
+      unsigned long bits;
+      if (!parseCount(arg.substr(17), bits, MAX_PREDICTOR_INDEX_BITS) ||
+          bits == 0) {
+        badValue(arg);
+        inputs.clear();
+        break;
+      }
+      pipeline_config.predictor_bits = static_cast<unsigned int>(bits);
+    } else if (arg.compare(0, 15, "--return-stack=") == 0) {
+      // Entries of the return address stack
+      unsigned long depth;
+      if (!parseCount(arg.substr(15), depth, ReturnAddressStack::MAX_DEPTH)) {
+        badValue(arg);
+        inputs.clear();
+        break;
+      }
+      pipeline_config.return_stack_depth = static_cast<unsigned int>(depth);
+    } else if (arg == "--caches") {
+      caches = true;
+    } else if (arg.compare(0, 6, "--l1i=") == 0 ||
+               arg.compare(0, 6, "--l1d=") == 0 ||
+               arg.compare(0, 5, "--l2=") == 0) {
+      size_t equals = arg.find('=');
+      std::string level = arg.substr(2, equals - 2);
+      CacheConfig &config = level == "l1i"   ? cache_config.l1i
+                            : level == "l1d" ? cache_config.l1d
+                                             : cache_config.l2;
+      try {
+        config = CacheConfig::parse(arg.substr(equals + 1), config);
+        cache_config.has_l2 = cache_config.has_l2 || level == "l2";
+      } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+      }
+      caches = true;
+    } else if (arg.compare(0, 17, "--memory-latency=") == 0) {
+      unsigned long latency;
+      if (!parseCount(arg.substr(17), latency, MAX_MEMORY_LATENCY)) {
+        badValue(arg);
+        inputs.clear();
+        break;
+      }
+      cache_config.memory_latency = static_cast<unsigned int>(latency);
+    } else if (arg == "--cache-pcs") {
+      cache_config.per_pc = true;
+    } else if (arg.compare(0, 13, "--cache-json=") == 0) {
+      cache_json = arg.substr(13);
+    } else if (arg.compare(0, 16, "--pipeline-json=") == 0) {
+      pipeline_json = arg.substr(16);
+    } else if (arg == "--engine=interpreter") {
+      engine = Engine::Interpreter;
+    } else if (arg == "--engine=block") {
+      engine = Engine::Block;
+    } else if (arg == "--engine=jit") {
+      engine = Engine::Jit;
+    } else if (arg.compare(0, 19, "--max-instructions=") == 0) {
+      if (!parseCount(arg.substr(19), max_instructions)) {
+        badValue(arg);
+        inputs.clear();
+        break;
+      }
+    } else if (arg.compare(0, 10, "--timeout=") == 0) {
+      // Seconds of wall-clock time
+      if (!parseSeconds(arg.substr(10), timeout)) {
+        badValue(arg);
+        inputs.clear();
+        break;
+      }
+    } else if (arg == "--batch") {
+      batch = true;
+    } else if (arg.compare(0, 7, "--list=") == 0) {
+      // Binaries to run in batch mode, one path per line
+      std::ifstream list(arg.substr(7));
+      if (!list.is_open()) {
+        std::cerr << "Error: could not open file " << arg.substr(7)
+                  << std::endl;
+        return 1;
+      }
+      for (std::string line; std::getline(list, line);) {
+        if (!line.empty()) {
+          inputs.push_back(line);
+        }
+      }
+      batch = true;
+    } else if (arg.compare(0, 7, "--jobs=") == 0) {
+      unsigned long jobs;
+      if (!parseCount(arg.substr(7), jobs, MAX_JOBS)) {
+        badValue(arg);
+        inputs.clear();
+        break;
+      }
+      batch_options.jobs = static_cast<unsigned int>(jobs);
+    } else if (arg.compare(0, 16, "--signature-dir=") == 0) {
+      batch_options.signature_dir = arg.substr(16);
+    } else if (arg.compare(0, 9, "--report=") == 0) {
+      report_file = arg.substr(9);
+    } else if (arg.compare(0, 16, "--save-snapshot=") == 0) {
+      save_snapshot = arg.substr(16);
+    } else if (arg.compare(0, 14, "--snapshot-at=") == 0) {
+      // Instructions completed in total when the snapshot is taken
+      if (!parseCount(arg.substr(14), snapshot_at)) {
+        badValue(arg);
+        inputs.clear();
+        break;
+      }
+    } else if (arg.compare(0, 19, "--restore-snapshot=") == 0) {
+      restore_snapshot = arg.substr(19);
+    } else if (arg.compare(0, 18, "--signature-range=") == 0) {
+      if (!parseRange(arg.substr(18), signature_range) ||
+          !MemoryFile::isValidSignatureRange(signature_range.begin,
+                                             signature_range.end)) {
+        std::cerr << "Error: bad signature range " << arg.substr(18)
+                  << ", expected word-aligned BEGIN:END with BEGIN <= END"
+                  << std::endl;
+        inputs.clear();
+        break;
+      }
+      has_signature_range = true;
+    } else if (arg.compare(0, 8, "--trace=") == 0) {
+      trace_file = arg.substr(8);
+    } else if (arg.compare(0, 14, "--trace-range=") == 0) {
+      TraceRange range;
+      if (!parseRange(arg.substr(14), range)) {
+        inputs.clear();
+        break;
+      }
+      trace_ranges.push_back(range);
+    } else if (arg.compare(0, 2, "--") == 0) {
+      inputs.clear();
+      break;
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+
+  if (batch && !single_run_option.empty()) {
+    std::cerr << "Error: " << single_run_option
+              << " cannot be used with --batch" << std::endl;
+    return 1;
+  }
+
+  // A snapshot holds the whole program, so the binary is optional
+  if (!restore_snapshot.empty() && !batch && inputs.empty()) {
+    inputs.push_back("");
+  }
+
+  if (inputs.empty() || (!batch && inputs.size() != 1)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--disassemble] [--map-memory] [--no-decode-cache]"
+                 " [--decode-stats] [--predecode] [--stats] [--stats-json=FILE]"
+                 " [--pipeline] [--pipeline-json=FILE] [--no-forwarding]"
+                 " [--predictor=not-taken|bimodal|gshare]"
+                 " [--predictor-bits=N] [--return-stack=N]"
+                 " [--caches] [--cache-json=FILE] [--l1i=CACHE]"
+                 " [--l1d=CACHE] [--l2=CACHE] [--memory-latency=N]"
+                 " [--cache-pcs]"
+                 " [--engine=interpreter|block|jit]"
+                 " [--max-instructions=N]"
+                 " [--timeout=SECONDS] [--signature=FILE]"
+                 " [--signature-range=BEGIN:END]"
+                 " [--save-snapshot=FILE [--snapshot-at=N]]"
+                 " [--restore-snapshot=FILE]"
+                 " [--trace=FILE [--trace-range=BEGIN:END]...] <bin_file>\n"
+              << "       " << argv[0]
+              << " --batch [--jobs=N] [--signature-dir=DIR] [--report=FILE]"
+                 " [--list=FILE] [--engine=interpreter|block|jit]"
+                 " [--max-instructions=N] [--timeout=SECONDS]"
+                 " <bin_file|directory>...\n"
+              << "CACHE is SIZE:WAYS:LINE[:lru|plru|random][:wb|wt]"
+                 "[:latency=N], with sizes in bytes or a k or m suffix"
+              << std::endl;
     return 1;
   }
 
-  std::string bin_file = argv[1];
+  if (batch) {
+    batch_options.engine = engine;
+    batch_options.backend = backend;
+    batch_options.decode_cache = decode_cache;
+    batch_options.max_instructions = max_instructions;
+    batch_options.timeout = timeout;
+    return runBatch(inputs, batch_options, report_file);
+  }
+
+  std::string bin_file = inputs[0];
+
+  if (disassemble) {
+    return disassembleFile(bin_file);
+  }
 
-  ControlUnit cu(bin_file);
-  while (true) {
+  std::unique_ptr<ControlUnit> p_cu;
+  try {
+    p_cu.reset(new ControlUnit(bin_file, backend));
+    if (!restore_snapshot.empty()) {
+      p_cu->restore(Snapshot::load(restore_snapshot));
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  ControlUnit &cu = *p_cu;
+  if (has_signature_range) {
+    cu.setSignatureRange(signature_range.begin, signature_range.end);
+  }
+  cu.setDecodeCacheEnabled(decode_cache);
+  cu.setEngine(engine);
+  if (predecode) {
     try {
-      cu.step();
-    } catch (const EcallTrap &e) {
-      // Exit on ecall
-      return 0;
-    } catch (const EbreakTrap &e) {
-      // Save signature for debugging and continue on ebreak
-      cu.signature();
+      cu.predecode();
     } catch (const std::exception &e) {
-      // Save signature and dump state and exit on other exceptions
       std::cerr << "Error: " << e.what() << std::endl;
-      cu.signature();
       return 1;
-    } catch (...) {
-      std::cerr << "Unknown error occurred while executing instructions"
-                << std::endl;
+    }
+  }
+  cu.setCycleLimit(max_instructions);
+  if (timeout > 0) {
+    cu.setDeadline(std::chrono::steady_clock::now() +
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::duration<double>(timeout)));
+  }
+
+  cu.setStatisticsEnabled(stats || !stats_json.empty());
+  try {
+    cu.setPipelineEnabled(pipeline || !pipeline_json.empty(),
+                          pipeline_config);
+    cu.setCachesEnabled(caches || !cache_json.empty(), cache_config);
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  if (!trace_file.empty()) {
+    try {
+      cu.startTrace(trace_file, trace_ranges);
+    } catch (const std::exception &e) {
+      std::cerr << "Error: " << e.what() << std::endl;
       return 1;
     }
   }
 
-  return 0;
+  // Without --snapshot-at, the snapshot is taken once the program stops
+  bool snapshot_pending = !save_snapshot.empty();
+  int exit_code = -1;
+  while (exit_code < 0) {
+    unsigned long budget = ControlUnit::UNLIMITED;
+    if (snapshot_pending && snapshot_at != ControlUnit::UNLIMITED) {
+      budget = snapshot_at - std::min(snapshot_at, cu.cycleCount());
+    }
+    RunResult result = cu.runProgram(signature_file, budget, [&]() {
+      if (stats) {
+        cu.statistics()->print(std::cerr);
+      }
+    });
+    if (snapshot_pending && cu.cycleCount() >= snapshot_at) {
+      snapshot_pending = false;
+      if (!saveSnapshot(cu, save_snapshot)) {
+        return 1;
+      }
+    }
+    exit_code = cu.exitCode(result, std::cerr);
+  }
+
+  if (snapshot_pending && !saveSnapshot(cu, save_snapshot)) {
+    return 1;
+  }
+  if (decode_stats && cu.decodeCache()) {
+    std::cerr << "decode cache: " << cu.decodeCache()->hits() << " hits, "
+              << cu.decodeCache()->misses() << " misses, "
+              << cu.decodeCache()->invalidations() << " invalidations"
+              << std::endl;
+  }
+  if (stats) {
+    cu.statistics()->print(std::cerr);
+  }
+  if (!stats_json.empty()) {
+    std::ofstream file(stats_json);
+    if (!file.is_open()) {
+      std::cerr << "Error: could not open file " << stats_json << std::endl;
+      return 1;
+    }
+    cu.statistics()->writeJson(file);
+  }
+  if (pipeline) {
+    cu.pipeline()->print(std::cerr);
+  }
+  if (!pipeline_json.empty()) {
+    std::ofstream file(pipeline_json);
+    if (!file.is_open()) {
+      std::cerr << "Error: could not open file " << pipeline_json << std::endl;
+      return 1;
+    }
+    cu.pipeline()->writeJson(file);
+  }
+  if (caches) {
+    cu.caches()->print(std::cerr);
+  }
+  if (!cache_json.empty()) {
+    std::ofstream file(cache_json);
+    if (!file.is_open()) {
+      std::cerr << "Error: could not open file " << cache_json << std::endl;
+      return 1;
+    }
+    cu.caches()->writeJson(file);
+  }
+  return exit_code;
 }
@@ -0,0 +1,40 @@
+#include "mappedfile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &filename)
+    : is_open(false), p_data(nullptr), length(0) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    return;
+  }
+
+  is_open = true;
+  length = static_cast<size_t>(info.st_size);
+  if (length > 0) {
+    void *p_map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p_map == MAP_FAILED) {
+      is_open = false;
+      length = 0;
+    } else {
+      p_data = static_cast<const uint8_t *>(p_map);
+    }
+  }
+  // The mapping stays valid after the descriptor is closed
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (p_data != nullptr) {
+    munmap(const_cast<uint8_t *>(p_data), length);
+  }
+}
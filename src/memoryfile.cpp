@@ -1,7 +1,25 @@
 #include "memoryfile.h"
-#include <iomanip>
 
-MemoryFile::MemoryFile(std::string _memory_file) : File(_memory_file) {}
+MemoryFile::MemoryFile(std::string _memory_file, MemoryBackend _backend)
+    : File(_memory_file, _backend == MemoryBackend::Map), backend(_backend),
+      p_write_observer(nullptr), has_signature_range(false),
+      signature_begin(0), signature_end(0) {
+  if (backend == MemoryBackend::Paged) {
+    pages.loadFile(memory_file);
+  }
+}
+
+void MemoryFile::loadSegment(std::shared_ptr<const MappedFile> p_image,
+                             size_t offset, size_t size, uint32_t address) {
+  if (backend == MemoryBackend::Paged) {
+    pages.attach(p_image, offset, size, address);
+    return;
+  }
+  const uint8_t *p_bytes = p_image->data() + offset;
+  for (size_t i = 0; i < size; i++) {
+    data[std::bitset<32>(address + i)] = p_bytes[i];
+  }
+}
 
 std::bitset<32> MemoryFile::readBytes(std::bitset<32> address, unsigned int N,
                                       bool sign_extend) {
@@ -9,10 +27,14 @@ std::bitset<32> MemoryFile::readBytes(std::bitset<32> address, unsigned int N,
   uint32_t current_address = address.to_ulong();
   uint32_t value = 0;
 
-  for (int i = 0; i < N; i++) {
-    current_byte = data[current_address].to_ulong();
-    value |= current_byte << (i * 8);
-    current_address++;
+  if (backend == MemoryBackend::Paged) {
+    value = pages.read(current_address, N);
+  } else {
+    for (int i = 0; i < N; i++) {
+      current_byte = data[current_address].to_ulong();
+      value |= current_byte << (i * 8);
+      current_address++;
+    }
   }
 
   if (sign_extend) {
@@ -32,6 +54,17 @@ void MemoryFile::writeBytes(std::bitset<32> address, std::bitset<32> _value,
   uint32_t current_address = address.to_ulong();
   uint32_t value = _value.to_ulong();
 
+  if (p_write_observer != nullptr &&
+      current_address < p_write_observer->watch_end &&
+      current_address + N > p_write_observer->watch_begin) {
+    p_write_observer->onWrite(current_address, N);
+  }
+
+  if (backend == MemoryBackend::Paged) {
+    pages.write(current_address, value, N);
+    return;
+  }
+
   for (int i = 0; i < N; i++) {
     current_byte = value >> (i * 8) & 0xFF;
     data[current_address] = current_byte;
@@ -39,31 +72,182 @@ void MemoryFile::writeBytes(std::bitset<32> address, std::bitset<32> _value,
   }
 }
 
-std::string MemoryFile::signature() {
+bool MemoryFile::isMapped(uint32_t address) {
+  if (backend == MemoryBackend::Paged) {
+    return pages.isMapped(address);
+  }
+  return data.count(address) != 0;
+}
+
+namespace {
+
+const uint32_t SIGNATURE_CANARY = 0x6f5ca309;
+
+// Appends \p word as 8 lower-case hex digits and a newline
+void appendWord(std::string &out, uint32_t word) {
+  static const char DIGITS[] = "0123456789abcdef";
+  char line[9];
+  for (int i = 7; i >= 0; i--) {
+    line[i] = DIGITS[word & 0xF];
+    word >>= 4;
+  }
+  line[8] = '\n';
+  out.append(line, sizeof(line));
+}
+
+} // namespace
+
+template <typename F> void MemoryFile::forEachWord(F visit) {
+  if (backend == MemoryBackend::Paged) {
+    pages.forEachPage([&](uint32_t base, const uint8_t *bytes) {
+      for (uint32_t offset = 0; offset < PagedMemory::PAGE_SIZE; offset += 4) {
+        uint32_t word = bytes[offset] | (bytes[offset + 1] << 8) |
+                        (bytes[offset + 2] << 16) |
+                        (static_cast<uint32_t>(bytes[offset + 3]) << 24);
+        if (!visit(base + offset, word)) {
+          return false;
+        }
+      }
+      return true;
+    });
+    return;
+  }
+
+  // Every four bytes of the map make a word, as they did in File::dump
   int i = 0;
-  bool should_write = false;
-  std::stringstream stream;
-  std::bitset<32> final_memory;
+  uint32_t address = 0;
+  uint32_t word = 0;
   for (auto &datum : data) {
-    std::bitset<8> mem = datum.second;
-    final_memory |= mem.to_ulong() << (i * 8);
-    i++;
-    if (i == 4) {
-      if (final_memory == 0x6f5ca309) {
-        if (should_write) {
-          stream << std::setw(8) << std::setfill('0') << std::hex
-                 << final_memory.to_ulong() << std::endl;
-          break;
+    if (i == 0) {
+      address = datum.first.to_ulong();
+    }
+    word |= static_cast<uint32_t>(datum.second.to_ulong()) << (i * 8);
+    if (++i == 4) {
+      if (!visit(address, word)) {
+        return;
+      }
+      word = 0;
+      i = 0;
+    }
+  }
+}
+
+uint32_t MemoryFile::peekWord(uint32_t address) {
+  if (backend == MemoryBackend::Paged) {
+    return pages.read(address, 4);
+  }
+  uint32_t word = 0;
+  for (uint32_t i = 0; i < 4; i++) {
+    auto found = data.find(address + i);
+    if (found != data.end()) {
+      word |= static_cast<uint32_t>(found->second.to_ulong()) << (i * 8);
+    }
+  }
+  return word;
+}
+
+bool MemoryFile::findSignatureRange() {
+  has_signature_range = false;
+  bool started = false;
+  forEachWord([&](uint32_t address, uint32_t word) {
+    if (word != SIGNATURE_CANARY) {
+      return true;
+    }
+    if (started) {
+      setSignatureRange(signature_begin, address + 4);
+      return false;
+    }
+    started = true;
+    signature_begin = address;
+    return true;
+  });
+  return has_signature_range;
+}
+
+std::string MemoryFile::signature() {
+  std::string signature;
+  if (!has_signature_range) {
+    // Search for the canaries, dumping as we go in case the end is missing
+    bool started = false;
+    forEachWord([&](uint32_t address, uint32_t word) {
+      if (word == SIGNATURE_CANARY) {
+        if (started) {
+          appendWord(signature, word);
+          setSignatureRange(signature_begin, address + 4);
+          return false;
         }
-        should_write = true;
+        started = true;
+        signature_begin = address;
       }
-      if (should_write) {
-        stream << std::setw(8) << std::setfill('0') << std::hex
-               << final_memory.to_ulong() << std::endl;
+      if (started) {
+        appendWord(signature, word);
       }
-      final_memory = 0;
-      i = 0;
+      return true;
+    });
+    return signature;
+  }
+
+  // Counting words rather than comparing addresses cannot wrap at the top
+  // of the address space
+  uint32_t count = (signature_end - signature_begin) / 4;
+  signature.reserve(static_cast<size_t>(count) * 9);
+  for (uint32_t i = 0; i < count; i++) {
+    appendWord(signature, peekWord(signature_begin + 4 * i));
+  }
+  return signature;
+}
+
+void MemoryFile::setSignatureRange(uint32_t begin, uint32_t end) {
+  if (!isValidSignatureRange(begin, end)) {
+    std::ostringstream message;
+    message << "Bad signature range: 0x" << std::hex << begin << ":0x" << end
+            << " (the bounds must be word aligned and in order)";
+    throw std::runtime_error(message.str());
+  }
+  signature_begin = begin;
+  signature_end = end;
+  has_signature_range = true;
+}
+
+std::vector<PagedMemory::SharedPage> MemoryFile::snapshot() {
+  if (backend == MemoryBackend::Paged) {
+    return pages.snapshot();
+  }
+
+  // Gather the bytes of the map into the pages that contain them
+  std::vector<PagedMemory::SharedPage> snapshot;
+  uint8_t *p_page = nullptr;
+  for (auto &datum : data) {
+    uint32_t address = datum.first.to_ulong();
+    uint32_t number = address >> PagedMemory::PAGE_BITS;
+    if (snapshot.empty() || snapshot.back().number != number) {
+      p_page = new uint8_t[PagedMemory::PAGE_SIZE]();
+      snapshot.push_back(
+          {number, std::shared_ptr<const uint8_t>(
+                       p_page, std::default_delete<uint8_t[]>())});
+    }
+    p_page[address & PagedMemory::PAGE_MASK] = datum.second.to_ulong();
+  }
+  return snapshot;
+}
+
+void MemoryFile::restore(const std::vector<PagedMemory::SharedPage> &pages) {
+  if (backend == MemoryBackend::Paged) {
+    this->pages.restore(pages);
+    return;
+  }
+
+  // The map holds whole pages from now on
+  data.clear();
+  for (const PagedMemory::SharedPage &page : pages) {
+    uint32_t base = page.number << PagedMemory::PAGE_BITS;
+    for (uint32_t offset = 0; offset < PagedMemory::PAGE_SIZE; offset++) {
+      data.emplace_hint(data.end(), std::bitset<32>(base + offset),
+                        std::bitset<8>(page.p_bytes.get()[offset]));
     }
   }
-  return stream.str();
-}
\ No newline at end of file
+}
+
+void MemoryFile::setWriteObserver(WriteObserver *p_observer) {
+  p_write_observer = p_observer;
+}
@@ -0,0 +1,456 @@
+#include "alu.h"
+#include "cache.h"
+#include "immgenunit.h"
+#include "maskingunit.hpp"
+#include "memoryfile.h"
+#include "pipeline.h"
+#include "registerfile.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Times the simulator's building blocks in isolation and reports ns/op as
+// JSON, so a regression in the full simulator can be traced to a primitive.
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Keeps the compiler from optimising away a result nothing else reads
+template <typename T> inline void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Inputs cycle through a fixed table so that results cannot be folded into
+// constants, while the table stays in the L1 cache
+const unsigned int INPUT_COUNT = 256;
+const unsigned int INPUT_MASK = INPUT_COUNT - 1;
+
+struct Inputs {
+  std::bitset<32> words[INPUT_COUNT];
+  std::bitset<32> shamts[INPUT_COUNT];
+  std::bitset<5> registers[INPUT_COUNT];
+  std::bitset<12> imm12[INPUT_COUNT];
+  std::bitset<20> imm20[INPUT_COUNT];
+  uint32_t addresses[INPUT_COUNT];
+
+  Inputs() {
+    // xorshift32, for the same inputs on every run
+    uint32_t state = 0x2545F491;
+    for (unsigned int i = 0; i < INPUT_COUNT; i++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      words[i] = state;
+      shamts[i] = state >> 27;
+      registers[i] = state >> 7;
+      imm12[i] = state >> 20;
+      imm20[i] = state >> 12;
+      // Aligned addresses within the first 64 KiB
+      addresses[i] = state & 0xFFFC;
+    }
+  }
+};
+
+struct Options {
+  std::string filter;
+  unsigned int repetitions = 10;
+  double min_time = 0.02;
+  std::string output;
+};
+
+struct Result {
+  std::string name;
+  unsigned long iterations;
+  std::vector<double> samples;
+};
+
+class Runner {
+public:
+  explicit Runner(const Options &_options) : options(_options) {}
+
+  /// \brief Times \p op, called with the iteration number.
+  ///
+  /// The op first runs for one repetition's worth of time as warm-up, which
+  /// also calibrates the number of iterations per repetition. Each repetition
+  /// then records one ns/op sample.
+  template <typename Op> void run(const std::string &name, Op op) {
+    if (name.find(options.filter) == std::string::npos) {
+      return;
+    }
+
+    unsigned long iterations = 1;
+    while (true) {
+      double seconds = time(op, iterations);
+      if (seconds >= options.min_time) {
+        break;
+      }
+      // Aim a little past the target so that calibration converges quickly
+      double scale = seconds > 0 ? 1.5 * options.min_time / seconds : 100;
+      iterations = static_cast<unsigned long>(
+          iterations * std::min(100.0, std::max(2.0, scale)));
+    }
+
+    Result result = {name, iterations, {}};
+    for (unsigned int i = 0; i < options.repetitions; i++) {
+      result.samples.push_back(time(op, iterations) * 1e9 / iterations);
+    }
+    results.push_back(result);
+    std::cerr << name << ": " << median(result.samples) << " ns/op"
+              << std::endl;
+  }
+
+  void report(std::ostream &out) const {
+    out << "{\n  \"alu\": \"" << ALU_NAME << "\",\n"
+        << "  \"repetitions\": " << options.repetitions << ",\n"
+        << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+      const Result &result = results[i];
+      out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.name
+          << "\", \"iterations\": " << result.iterations
+          << ", \"ns_per_op\": " << median(result.samples)
+          << ", \"min_ns_per_op\": "
+          << *std::min_element(result.samples.begin(), result.samples.end())
+          << ", \"max_ns_per_op\": "
+          << *std::max_element(result.samples.begin(), result.samples.end())
+          << "}";
+    }
+    out << "\n  ]\n}\n";
+  }
+
+private:
+#ifdef RV32SIM_NATIVE_ALU
+  static constexpr const char *ALU_NAME = "native";
+#else
+  static constexpr const char *ALU_NAME = "gate-level";
+#endif
+
+  Options options;
+  std::vector<Result> results;
+
+  template <typename Op> static double time(Op &op, unsigned long iterations) {
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < iterations; i++) {
+      op(i);
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  static double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    size_t middle = samples.size() / 2;
+    if (samples.size() % 2 == 0) {
+      return (samples[middle - 1] + samples[middle]) / 2;
+    }
+    return samples[middle];
+  }
+};
+
+/*
+=========================
+    ALU
+=========================
+*/
+
+void benchmarkALU(Runner &runner, const Inputs &in) {
+  runner.run("alu/add", [&](unsigned long i) {
+    keep(ALU::add(in.words[i & INPUT_MASK], in.words[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("alu/negate", [&](unsigned long i) {
+    keep(ALU::negate(in.words[i & INPUT_MASK]));
+  });
+  runner.run("alu/lessThanSigned", [&](unsigned long i) {
+    keep(ALU::lessThanSigned(in.words[i & INPUT_MASK],
+                             in.words[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("alu/lessThanUnsigned", [&](unsigned long i) {
+    keep(ALU::lessThanUnsigned(in.words[i & INPUT_MASK],
+                               in.words[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("alu/greaterThanEqualSigned", [&](unsigned long i) {
+    keep(ALU::greaterThanEqualSigned(in.words[i & INPUT_MASK],
+                                     in.words[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("alu/greaterThanEqualUnsigned", [&](unsigned long i) {
+    keep(ALU::greaterThanEqualUnsigned(in.words[i & INPUT_MASK],
+                                       in.words[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("alu/arithmeticRightShift", [&](unsigned long i) {
+    keep(ALU::arithmeticRightShift(in.words[i & INPUT_MASK],
+                                   in.shamts[i & INPUT_MASK]));
+  });
+  runner.run("alu/hardwareLeftShift", [&](unsigned long i) {
+    keep(ALU::hardwareLeftShift(in.words[i & INPUT_MASK],
+                                in.shamts[i & INPUT_MASK]));
+  });
+  runner.run("alu/hardwareRightShift", [&](unsigned long i) {
+    keep(ALU::hardwareRightShift(in.words[i & INPUT_MASK],
+                                 in.shamts[i & INPUT_MASK]));
+  });
+  runner.run("alu/hardwareIsEqual", [&](unsigned long i) {
+    keep(ALU::hardwareIsEqual(in.words[i & INPUT_MASK],
+                              in.words[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("alu/bitwiseAnd", [&](unsigned long i) {
+    keep(ALU::bitwiseAnd(in.words[i & INPUT_MASK],
+                         in.words[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("alu/bitwiseOr", [&](unsigned long i) {
+    keep(ALU::bitwiseOr(in.words[i & INPUT_MASK],
+                        in.words[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("alu/bitwiseXor", [&](unsigned long i) {
+    keep(ALU::bitwiseXor(in.words[i & INPUT_MASK],
+                         in.words[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("alu/maskLowFive", [&](unsigned long i) {
+    keep(ALU::maskLowFive(in.words[i & INPUT_MASK]));
+  });
+}
+
+/*
+=========================
+    MaskingUnit
+=========================
+*/
+
+// The field widths and positions the instruction formats extract
+void benchmarkMaskingUnit(Runner &runner, const Inputs &in) {
+  runner.run("masking/hardwareMaskBits<1,32>", [&](unsigned long i) {
+    keep(MaskingUnit::hardwareMaskBits<1, 32>(in.words[i & INPUT_MASK], 31,
+                                              1));
+  });
+  runner.run("masking/hardwareMaskBits<5,32>", [&](unsigned long i) {
+    keep(MaskingUnit::hardwareMaskBits<5, 32>(in.words[i & INPUT_MASK], 15,
+                                              5));
+  });
+  runner.run("masking/hardwareMaskBits<8,32>", [&](unsigned long i) {
+    keep(MaskingUnit::hardwareMaskBits<8, 32>(in.words[i & INPUT_MASK], 12,
+                                              8));
+  });
+  runner.run("masking/hardwareMaskBits<12,32>", [&](unsigned long i) {
+    keep(MaskingUnit::hardwareMaskBits<12, 32>(in.words[i & INPUT_MASK], 20,
+                                               12));
+  });
+  runner.run("masking/hardwareMaskBits<20,32>", [&](unsigned long i) {
+    keep(MaskingUnit::hardwareMaskBits<20, 32>(in.words[i & INPUT_MASK], 12,
+                                               20));
+  });
+  runner.run("masking/concatBits<1,1>", [&](unsigned long i) {
+    keep(MaskingUnit::concatBits<1, 1>(std::bitset<1>(i),
+                                       std::bitset<1>(i >> 1)));
+  });
+  runner.run("masking/concatBits<5,7>", [&](unsigned long i) {
+    keep(MaskingUnit::concatBits<5, 7>(in.registers[i & INPUT_MASK],
+                                       std::bitset<7>(i)));
+  });
+  runner.run("masking/concatBits<10,2>", [&](unsigned long i) {
+    keep(MaskingUnit::concatBits<10, 2>(std::bitset<10>(i),
+                                        std::bitset<2>(i >> 10)));
+  });
+  runner.run("masking/concatBits<11,9>", [&](unsigned long i) {
+    keep(MaskingUnit::concatBits<11, 9>(std::bitset<11>(i),
+                                        std::bitset<9>(i >> 11)));
+  });
+  runner.run("masking/extract<ImmB>", [&](unsigned long i) {
+    keep(MaskingUnit::extract<12, Fields::ImmB0, Fields::ImmB1, Fields::ImmB2,
+                              Fields::ImmB3>(in.words[i & INPUT_MASK]));
+  });
+  runner.run("masking/extract<ImmJ>", [&](unsigned long i) {
+    keep(MaskingUnit::extract<20, Fields::ImmJ0, Fields::ImmJ1, Fields::ImmJ2,
+                              Fields::ImmJ3>(in.words[i & INPUT_MASK]));
+  });
+}
+
+/*
+=========================
+    ImmGenUnit
+=========================
+*/
+
+void benchmarkImmGenUnit(Runner &runner, const Inputs &in) {
+  ImmGenUnit igu;
+  runner.run("immgen/signExtend<12>", [&](unsigned long i) {
+    keep(igu.signExtend(in.imm12[i & INPUT_MASK]));
+  });
+  runner.run("immgen/signExtend<20>", [&](unsigned long i) {
+    keep(igu.signExtend(in.imm20[i & INPUT_MASK]));
+  });
+  runner.run("immgen/generateLong", [&](unsigned long i) {
+    keep(igu.generateLong(in.imm20[i & INPUT_MASK]));
+  });
+  runner.run("immgen/zeroExtend", [&](unsigned long i) {
+    keep(igu.zeroExtend(in.registers[i & INPUT_MASK]));
+  });
+}
+
+/*
+=========================
+    Files
+=========================
+*/
+
+void benchmarkMemoryFile(Runner &runner, const Inputs &in,
+                         MemoryBackend backend, const std::string &prefix) {
+  MemoryFile memory("", backend);
+  // Touch every address the benchmarks use, so reads find mapped data
+  for (unsigned int i = 0; i < INPUT_COUNT; i++) {
+    memory.writeBytes(in.addresses[i], in.words[i], 4);
+  }
+
+  for (unsigned int n : {1u, 2u, 4u}) {
+    runner.run(prefix + "/readBytes" + std::to_string(n),
+               [&](unsigned long i) {
+                 keep(memory.readBytes(in.addresses[i & INPUT_MASK], n));
+               });
+    runner.run(prefix + "/writeBytes" + std::to_string(n),
+               [&](unsigned long i) {
+                 memory.writeBytes(in.addresses[i & INPUT_MASK],
+                                   in.words[i & INPUT_MASK], n);
+               });
+  }
+}
+
+void benchmarkRegisterFile(Runner &runner, const Inputs &in) {
+  RegisterFile registers;
+  runner.run("registerfile/read", [&](unsigned long i) {
+    keep(registers.read(in.registers[i & INPUT_MASK],
+                        in.registers[(i + 1) & INPUT_MASK]));
+  });
+  runner.run("registerfile/write", [&](unsigned long i) {
+    registers.write(in.registers[i & INPUT_MASK], in.words[i & INPUT_MASK]);
+  });
+}
+
+/*
+=========================
+    Trace
+=========================
+*/
+
+// The cost on the simulation thread, with the writer thread draining to
+// /dev/null
+void benchmarkTrace(Runner &runner, const Inputs &in) {
+  TraceWriter trace("/dev/null", {{0x100, 0x200}});
+  runner.run("trace/covers", [&](unsigned long i) {
+    keep(trace.covers(in.addresses[i & INPUT_MASK]));
+  });
+  runner.run("trace/record", [&](unsigned long i) {
+    TraceRecord record = {};
+    record.pc = static_cast<uint32_t>(i * 4);
+    record.raw = in.words[i & INPUT_MASK].to_ulong();
+    record.rd = 1 + (i & 15);
+    record.rd_value = in.words[(i + 1) & INPUT_MASK].to_ulong();
+    trace.record(record);
+  });
+}
+
+/*
+=========================
+    Pipeline
+=========================
+*/
+
+// Random words are mostly illegal, so time a fixed mix of real instructions
+void benchmarkPipeline(Runner &runner, const Inputs &in) {
+  const uint32_t PROGRAM[] = {
+      0x00100293, // addi x5, x0, 1
+      0x0002a303, // lw x6, 0(x5)
+      0x00130393, // addi x7, x6, 1
+      0x00538433, // add x8, x7, x5
+      0x0082a023, // sw x8, 0(x5)
+      0xfe0416e3, // bnez x8, -20
+  };
+  const unsigned int LENGTH = sizeof(PROGRAM) / sizeof(PROGRAM[0]);
+  RISC::DecodedInstruction decoded[LENGTH];
+  for (unsigned int i = 0; i < LENGTH; i++) {
+    decoded[i] = RISC::decodeInstruction(PROGRAM[i]);
+  }
+
+  PipelineModel pipeline;
+  runner.run("pipeline/retire", [&](unsigned long i) {
+    unsigned int index = i % LENGTH;
+    uint32_t pc = index * 4;
+    // The branch is taken when the input says so
+    bool taken = index == LENGTH - 1 && (in.words[i & INPUT_MASK][0]);
+    uint32_t next_pc = taken ? 0 : pc + 4;
+    pipeline.retire(decoded[index], pc, next_pc, taken);
+  });
+  keep(pipeline.cycles());
+}
+
+/*
+=========================
+    Caches
+=========================
+*/
+
+void benchmarkCaches(Runner &runner, const Inputs &in) {
+  CacheHierarchyConfig config;
+  config.has_l2 = true;
+  CacheHierarchy caches(config);
+  // Sequential fetches mostly stay within a line
+  runner.run("cache/fetch", [&](unsigned long i) {
+    keep(caches.fetch(static_cast<uint32_t>(i * 4) & 0x3FFF));
+  });
+  // The inputs span 64 KiB, four times the data cache
+  runner.run("cache/access", [&](unsigned long i) {
+    keep(caches.access(0, in.addresses[i & INPUT_MASK], 4, i & 1));
+  });
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 9, "--filter=") == 0) {
+      options.filter = arg.substr(9);
+    } else if (arg.compare(0, 14, "--repetitions=") == 0) {
+      options.repetitions = std::max(1, std::stoi(arg.substr(14)));
+    } else if (arg.compare(0, 11, "--min-time=") == 0) {
+      // Seconds per repetition
+      options.min_time = std::stod(arg.substr(11));
+    } else if (arg.compare(0, 9, "--output=") == 0) {
+      options.output = arg.substr(9);
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--filter=SUBSTRING] [--repetitions=N]"
+                   " [--min-time=SECONDS] [--output=FILE]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  Inputs inputs;
+  Runner runner(options);
+  benchmarkALU(runner, inputs);
+  benchmarkMaskingUnit(runner, inputs);
+  benchmarkImmGenUnit(runner, inputs);
+  benchmarkMemoryFile(runner, inputs, MemoryBackend::Paged, "memory/paged");
+  benchmarkMemoryFile(runner, inputs, MemoryBackend::Map, "memory/map");
+  benchmarkRegisterFile(runner, inputs);
+  benchmarkTrace(runner, inputs);
+  benchmarkPipeline(runner, inputs);
+  benchmarkCaches(runner, inputs);
+
+  if (options.output.empty()) {
+    runner.report(std::cout);
+    return 0;
+  }
+  std::ofstream file(options.output);
+  if (!file.is_open()) {
+    std::cerr << "Error: could not open " << options.output << std::endl;
+    return 1;
+  }
+  runner.report(file);
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include "options.h"
+
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// stoul and stod skip leading space and take a sign, which options should
+// not have
+bool startsWithDigit(const std::string &text) {
+  return !text.empty() &&
+         std::isdigit(static_cast<unsigned char>(text[0])) != 0;
+}
+
+} // namespace
+
+bool parseCount(const std::string &text, unsigned long &value,
+                unsigned long max) {
+  if (!startsWithDigit(text)) {
+    return false;
+  }
+  try {
+    size_t length;
+    unsigned long number = std::stoul(text, &length, 10);
+    if (length != text.size() || number > max) {
+      return false;
+    }
+    value = number;
+    return true;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool parseSeconds(const std::string &text, double &seconds) {
+  if (!startsWithDigit(text) && text.compare(0, 1, ".") != 0) {
+    return false;
+  }
+  try {
+    size_t length;
+    double number = std::stod(text, &length);
+    if (length != text.size() || !std::isfinite(number)) {
+      return false;
+    }
+    seconds = number;
+    return true;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool parseAddress(const std::string &text, uint32_t &address) {
+  if (!startsWithDigit(text)) {
+    return false;
+  }
+  try {
+    size_t length;
+    // Base 0 takes the 0x prefix
+    unsigned long value = std::stoul(text, &length, 0);
+    if (length != text.size() || value > 0xFFFFFFFFul) {
+      return false;
+    }
+    address = static_cast<uint32_t>(value);
+    return true;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
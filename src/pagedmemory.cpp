@@ -0,0 +1,165 @@
+#include "pagedmemory.h"
+#include "imagecache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+PagedMemory::PagedMemory()
+    : last_read_number(~0u), p_last_read(nullptr), last_write_number(~0u),
+      p_last_write(nullptr) {}
+
+PagedMemory::PageEntry *PagedMemory::lookup(uint32_t page_number) const {
+  const std::unique_ptr<PageTable> &p_table =
+      directory[page_number >> TABLE_BITS];
+  if (!p_table) {
+    return nullptr;
+  }
+  return &p_table->pages[page_number & TABLE_MASK];
+}
+
+PagedMemory::PageEntry &PagedMemory::entry(uint32_t page_number) {
+  std::unique_ptr<PageTable> &p_table = directory[page_number >> TABLE_BITS];
+  if (!p_table) {
+    p_table.reset(new PageTable());
+  }
+  return p_table->pages[page_number & TABLE_MASK];
+}
+
+uint8_t *PagedMemory::makeWritable(uint32_t page_number) {
+  PageEntry &page = entry(page_number);
+  if (!page.p_owned) {
+    // Either a fresh page, or the first write to a shared page
+    page.p_owned.reset(new Page());
+    if (page.p_bytes != nullptr) {
+      std::memcpy(page.p_owned->bytes, page.p_bytes, PAGE_SIZE);
+    } else {
+      std::memset(page.p_owned->bytes, 0, PAGE_SIZE);
+    }
+    page.p_bytes = page.p_owned->bytes;
+    page.p_shared.reset();
+    if (last_read_number == page_number) {
+      p_last_read = page.p_bytes;
+    }
+  }
+
+  last_write_number = page_number;
+  p_last_write = page.p_bytes;
+  return p_last_write;
+}
+
+void PagedMemory::load(const uint8_t *bytes, size_t size, uint32_t base) {
+  size_t copied = 0;
+  while (copied < size) {
+    uint32_t address = base + copied;
+    uint32_t offset = address & PAGE_MASK;
+    size_t chunk = std::min<size_t>(PAGE_SIZE - offset, size - copied);
+    std::memcpy(findWritablePage(address) + offset, bytes + copied, chunk);
+    copied += chunk;
+  }
+}
+
+void PagedMemory::share(uint32_t page_number,
+                        std::shared_ptr<const uint8_t> p_bytes) {
+  PageEntry &page = entry(page_number);
+  page.p_owned.reset();
+  // Shared pages are never written through; writes copy the page first
+  page.p_bytes = const_cast<uint8_t *>(p_bytes.get());
+  page.p_shared = std::move(p_bytes);
+  if (last_read_number == page_number) {
+    last_read_number = ~0u;
+  }
+  if (last_write_number == page_number) {
+    last_write_number = ~0u;
+  }
+}
+
+void PagedMemory::attach(std::shared_ptr<const MappedFile> p_image,
+                         uint32_t base) {
+  attach(p_image, 0, p_image->size(), base);
+}
+
+void PagedMemory::attach(std::shared_ptr<const MappedFile> p_image,
+                         size_t offset, size_t size, uint32_t address) {
+  size_t copied = 0;
+  while (copied < size) {
+    uint32_t page_offset = (address + copied) & PAGE_MASK;
+    size_t chunk = std::min<size_t>(PAGE_SIZE - page_offset, size - copied);
+    size_t position = offset + copied;
+    // The mapping is zero-filled past the end of the file, so a final
+    // partial page can be shared too
+    bool whole_page = chunk == PAGE_SIZE || position + chunk == p_image->size();
+    if (page_offset == 0 && (position & PAGE_MASK) == 0 && whole_page) {
+      // Each page keeps the whole mapping alive
+      share((address + copied) >> PAGE_BITS,
+            std::shared_ptr<const uint8_t>(p_image,
+                                           p_image->data() + position));
+    } else {
+      load(p_image->data() + position, chunk, address + copied);
+    }
+    copied += chunk;
+  }
+}
+
+size_t PagedMemory::loadFile(const std::string &filename, uint32_t base) {
+  std::shared_ptr<const MappedFile> p_image =
+      ImageCache::instance().open(filename);
+  if (p_image->isOpen() && (base & PAGE_MASK) == 0) {
+    attach(p_image, base);
+    return p_image->size();
+  }
+
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    return 0;
+  }
+
+  size_t loaded = 0;
+  uint8_t buffer[PAGE_SIZE];
+  while (file.read(reinterpret_cast<char *>(buffer), PAGE_SIZE) ||
+         file.gcount() > 0) {
+    size_t chunk = static_cast<size_t>(file.gcount());
+    load(buffer, chunk, base + loaded);
+    loaded += chunk;
+  }
+  return loaded;
+}
+
+bool PagedMemory::isMapped(uint32_t address) {
+  return findPage(address) != nullptr;
+}
+
+std::vector<PagedMemory::SharedPage> PagedMemory::snapshot() {
+  std::vector<SharedPage> pages;
+  for (uint32_t i = 0; i < TABLE_SIZE; i++) {
+    if (!directory[i]) {
+      continue;
+    }
+    for (uint32_t j = 0; j < TABLE_SIZE; j++) {
+      PageEntry &page = directory[i]->pages[j];
+      if (page.p_bytes == nullptr) {
+        continue;
+      }
+      if (page.p_owned) {
+        std::shared_ptr<const Page> p_page(std::move(page.p_owned));
+        page.p_shared = std::shared_ptr<const uint8_t>(p_page, p_page->bytes);
+      }
+      pages.push_back({(i << TABLE_BITS) | j, page.p_shared});
+    }
+  }
+
+  // Pages that were private are read-only now
+  last_write_number = ~0u;
+  return pages;
+}
+
+void PagedMemory::restore(const std::vector<SharedPage> &pages) {
+  for (std::unique_ptr<PageTable> &p_table : directory) {
+    p_table.reset();
+  }
+  last_read_number = ~0u;
+  last_write_number = ~0u;
+  for (const SharedPage &page : pages) {
+    share(page.number, page.p_bytes);
+  }
+}
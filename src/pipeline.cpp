@@ -0,0 +1,312 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+
+const unsigned int PipelineModel::STAGES;
+
+namespace {
+
+const unsigned int OPCODE_COUNT =
+    static_cast<unsigned int>(RISC::Opcode::Count);
+
+const char *const CAUSE_NAMES[] = {
+    "load-use",      "data hazard",       "branch",    "jump",
+    "indirect jump", "instruction cache", "data cache"};
+const char *const CAUSE_KEYS[] = {
+    "load_use",      "data_hazard",       "branch",    "jump",
+    "indirect_jump", "instruction_cache", "data_cache"};
+
+// Instructions flushed when fetch is redirected in decode, and in execute
+const unsigned int REDIRECT_PENALTY = 1;
+const unsigned int MISPREDICT_PENALTY = 2;
+
+// Calls and returns link through x1 or x5
+bool isLink(uint8_t reg) { return reg == 1 || reg == 5; }
+
+double percent(unsigned long part, unsigned long whole) {
+  return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+} // namespace
+
+PipelineModel::PipelineModel(const PipelineConfig &_config)
+    : configuration(_config),
+      p_predictor(makeBranchPredictor(_config.predictor,
+                                      _config.predictor_bits)),
+      return_stack(_config.return_stack_depth) {
+  for (unsigned int i = 0; i < OPCODE_COUNT; i++) {
+    const RISC::InstructionInfo &info =
+        RISC::instructionInfo(static_cast<RISC::Opcode>(i));
+    bool has_operands = info.syntax != RISC::Syntax::None;
+    Timing &timing = timings[i];
+    timing.reads_rs1 = has_operands && (info.format == RISC::Format::R ||
+                                        info.format == RISC::Format::I ||
+                                        info.format == RISC::Format::S ||
+                                        info.format == RISC::Format::B);
+    timing.reads_rs2 = info.format == RISC::Format::R ||
+                       info.format == RISC::Format::S ||
+                       info.format == RISC::Format::B;
+    timing.writes_rd = has_operands && info.format != RISC::Format::S &&
+                       info.format != RISC::Format::B;
+    timing.is_load =
+        info.syntax == RISC::Syntax::Load && info.access_size != 0;
+    timing.is_branch = info.syntax == RISC::Syntax::Branch;
+  }
+  reset();
+}
+
+void PipelineModel::reset() {
+  retired = 0;
+  // The first instruction is fetched in cycle 0 and decoded in cycle 1
+  execute_cycle = 1;
+  flush_cycles = 0;
+  flush_cause = StallCause::Branch;
+  memory_cycles = 0;
+  written = 0;
+  std::fill(produced, produced + 32, 0);
+  std::fill(ready, ready + 32, 0);
+  std::fill(produced_by_load, produced_by_load + 32, false);
+  std::fill(stall_cycles, stall_cycles + CAUSES, 0);
+  std::fill(stall_events, stall_events + CAUSES, 0);
+  forward_counts = Forwards();
+  p_predictor->reset();
+  return_stack.clear();
+  branch_totals = BranchCounts();
+  branches.clear();
+  return_totals = BranchCounts();
+}
+
+void PipelineModel::setBranchPredictor(
+    std::shared_ptr<BranchPredictor> predictor) {
+  p_predictor = predictor;
+}
+
+void PipelineModel::retire(const RISC::DecodedInstruction &decoded,
+                           uint32_t pc, uint32_t next_pc, bool taken,
+                           unsigned int fetch_stall,
+                           unsigned int memory_stall) {
+  const Timing &timing = timings[static_cast<unsigned int>(decoded.opcode)];
+
+  // Bubbles left by a flush and by cache misses come first; a data hazard
+  // can only add to them
+  unsigned long cycle =
+      execute_cycle + 1 + flush_cycles + memory_cycles + fetch_stall;
+  if (flush_cycles > 0) {
+    stall_cycles[static_cast<unsigned int>(flush_cause)] += flush_cycles;
+    stall_events[static_cast<unsigned int>(flush_cause)]++;
+  }
+  if (memory_cycles > 0) {
+    stall_cycles[static_cast<unsigned int>(StallCause::DataCache)] +=
+        memory_cycles;
+    stall_events[static_cast<unsigned int>(StallCause::DataCache)]++;
+  }
+  if (fetch_stall > 0) {
+    stall_cycles[static_cast<unsigned int>(StallCause::InstructionCache)] +=
+        fetch_stall;
+    stall_events[static_cast<unsigned int>(StallCause::InstructionCache)]++;
+  }
+
+  unsigned long operands = 0;
+  bool from_load = false;
+  if (timing.reads_rs1 && ready[decoded.rs1] > operands) {
+    operands = ready[decoded.rs1];
+    from_load = produced_by_load[decoded.rs1];
+  }
+  if (timing.reads_rs2 && ready[decoded.rs2] > operands) {
+    operands = ready[decoded.rs2];
+    from_load = produced_by_load[decoded.rs2];
+  }
+  if (operands > cycle) {
+    StallCause cause = configuration.forwarding && from_load
+                           ? StallCause::LoadUse
+                           : StallCause::DataHazard;
+    stall_cycles[static_cast<unsigned int>(cause)] += operands - cycle;
+    stall_events[static_cast<unsigned int>(cause)]++;
+    cycle = operands;
+  }
+
+  if (configuration.forwarding) {
+    if (timing.reads_rs1) {
+      countForward(decoded.rs1, cycle);
+    }
+    if (timing.reads_rs2 && decoded.rs2 != decoded.rs1) {
+      countForward(decoded.rs2, cycle);
+    }
+  }
+
+  // x0 is never written, so it is always ready
+  if (timing.writes_rd && decoded.rd != 0) {
+    written |= 1u << decoded.rd;
+    produced[decoded.rd] = cycle;
+    produced_by_load[decoded.rd] = timing.is_load;
+    if (!configuration.forwarding) {
+      // Written back two cycles later, and read in the same cycle by decode
+      ready[decoded.rd] = cycle + 3;
+    } else {
+      // A loaded value is forwarded after memory access, anything else
+      // after execute
+      ready[decoded.rd] = cycle + (timing.is_load ? 2 : 1);
+    }
+    // A data cache miss delays the result and everything behind it alike
+    ready[decoded.rd] += memory_stall;
+  }
+  memory_cycles = memory_stall;
+
+  flush_cycles = 0;
+  if (timing.is_branch) {
+    bool predicted = p_predictor->predict(pc);
+    p_predictor->update(pc, taken);
+    BranchCounts &counts = branches[pc];
+    counts.executed++;
+    branch_totals.executed++;
+    if (predicted != taken) {
+      counts.mispredicted++;
+      branch_totals.mispredicted++;
+      flush_cycles = MISPREDICT_PENALTY;
+    } else if (taken) {
+      flush_cycles = REDIRECT_PENALTY;
+    }
+    flush_cause = StallCause::Branch;
+  } else if (decoded.opcode == RISC::Opcode::JumpAndLink) {
+    if (isLink(decoded.rd)) {
+      return_stack.push(pc + 4);
+    }
+    flush_cycles = next_pc != pc + 4 ? REDIRECT_PENALTY : 0;
+    flush_cause = StallCause::Jump;
+  } else if (decoded.opcode == RISC::Opcode::JumpAndLinkReg) {
+    flush_cycles = predictJumpRegister(decoded, pc, next_pc);
+    flush_cause = StallCause::IndirectJump;
+  }
+
+  execute_cycle = cycle;
+  retired++;
+}
+
+void PipelineModel::countForward(uint8_t reg, unsigned long cycle) {
+  if ((written >> reg & 1) == 0) {
+    return;
+  }
+  // Later readers find the value in the register file
+  unsigned long distance = cycle - produced[reg];
+  if (distance == 1) {
+    forward_counts.ex_mem++;
+  } else if (distance == 2) {
+    forward_counts.mem_wb++;
+  }
+}
+
+unsigned int
+PipelineModel::predictJumpRegister(const RISC::DecodedInstruction &decoded,
+                                   uint32_t pc, uint32_t next_pc) {
+  // A jalr linking through the register it jumps through is a call only
+  bool links = isLink(decoded.rd);
+  bool returns = isLink(decoded.rs1) && !(links && decoded.rd == decoded.rs1);
+  uint32_t target = 0;
+  bool predicted = returns && return_stack.pop(target);
+  if (links) {
+    return_stack.push(pc + 4);
+  }
+
+  if (returns && return_stack.depth() > 0) {
+    return_totals.executed++;
+    if (!predicted || target != next_pc) {
+      return_totals.mispredicted++;
+    }
+  }
+  if (!predicted) {
+    // Fetch went on sequentially
+    return next_pc == pc + 4 ? 0 : MISPREDICT_PENALTY;
+  }
+  if (target != next_pc) {
+    return MISPREDICT_PENALTY;
+  }
+  return next_pc == pc + 4 ? 0 : REDIRECT_PENALTY;
+}
+
+unsigned long PipelineModel::cycles() const {
+  // Memory access and write back follow the last execute
+  return retired == 0 ? 0 : execute_cycle + 3 + memory_cycles;
+}
+
+double PipelineModel::cpi() const {
+  return retired == 0 ? 0 : static_cast<double>(cycles()) / retired;
+}
+
+void PipelineModel::print(std::ostream &out) const {
+  unsigned long total = cycles();
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  out << "pipeline: " << STAGES << " stages, forwarding "
+      << (configuration.forwarding ? "on" : "off") << "\n"
+      << "cycles: " << total << "\n"
+      << "instructions: " << retired << "\n"
+      << "CPI: " << cpi() << "\n"
+      << "stalls (cycles, events, % of cycles):\n";
+  for (unsigned int i = 0; i < CAUSES; i++) {
+    out << "  " << std::left << std::setw(18) << CAUSE_NAMES[i] << std::right
+        << std::setw(12) << stall_cycles[i] << std::setw(12)
+        << stall_events[i] << "  " << std::setw(7)
+        << percent(stall_cycles[i], total) << "%\n";
+  }
+  if (configuration.forwarding) {
+    out << "forwarded operands: " << forward_counts.ex_mem << " from EX/MEM, "
+        << forward_counts.mem_wb << " from MEM/WB\n";
+  }
+
+  out << "branch predictor: " << p_predictor->name() << "\n"
+      << "  conditional branches: " << branch_totals.executed << ", "
+      << branch_totals.mispredicted << " mispredicted ("
+      << percent(branch_totals.executed - branch_totals.mispredicted,
+                 branch_totals.executed)
+      << "% correct)\n";
+  if (return_stack.depth() > 0) {
+    out << "  returns: " << return_totals.executed << ", "
+        << return_totals.mispredicted
+        << " mispredicted (return address stack of " << return_stack.depth()
+        << " entries)\n";
+  }
+  out << "branches (pc, executed, mispredicted, % correct):\n";
+  std::map<uint32_t, BranchCounts> sorted(branches.begin(), branches.end());
+  for (const auto &branch : sorted) {
+    const BranchCounts &counts = branch.second;
+    out << "  0x" << std::hex << std::setfill('0') << std::setw(8)
+        << branch.first << std::dec << std::setfill(' ') << std::setw(12)
+        << counts.executed << std::setw(12) << counts.mispredicted << "  "
+        << std::setw(7)
+        << percent(counts.executed - counts.mispredicted, counts.executed)
+        << "%\n";
+  }
+  out.flags(flags);
+}
+
+void PipelineModel::writeJson(std::ostream &out) const {
+  out << "{\n  \"stages\": " << STAGES << ",\n  \"forwarding\": "
+      << (configuration.forwarding ? "true" : "false")
+      << ",\n  \"cycles\": " << cycles()
+      << ",\n  \"instructions\": " << retired << ",\n  \"cpi\": " << cpi()
+      << ",\n  \"stalls\": {";
+  for (unsigned int i = 0; i < CAUSES; i++) {
+    out << (i == 0 ? "\n" : ",\n") << "    \"" << CAUSE_KEYS[i]
+        << "\": {\"cycles\": " << stall_cycles[i]
+        << ", \"events\": " << stall_events[i] << "}";
+  }
+  out << "\n  },\n  \"forwards\": {\"ex_mem\": " << forward_counts.ex_mem
+      << ", \"mem_wb\": " << forward_counts.mem_wb
+      << "},\n  \"predictor\": \"" << p_predictor->name()
+      << "\",\n  \"branches\": {\"executed\": " << branch_totals.executed
+      << ", \"mispredicted\": " << branch_totals.mispredicted
+      << "},\n  \"returns\": {\"executed\": " << return_totals.executed
+      << ", \"mispredicted\": " << return_totals.mispredicted
+      << "},\n  \"branch_pcs\": [";
+  bool first = true;
+  std::map<uint32_t, BranchCounts> sorted(branches.begin(), branches.end());
+  for (const auto &branch : sorted) {
+    out << (first ? "\n" : ",\n") << "    {\"pc\": " << branch.first
+        << ", \"executed\": " << branch.second.executed
+        << ", \"mispredicted\": " << branch.second.mispredicted << "}";
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+}
@@ -0,0 +1,111 @@
+#include "predecodetable.h"
+
+#include <algorithm>
+#include <map>
+
+namespace {
+const size_t CHUNK_WORDS = 1024;
+}
+
+void PredecodeTable::addRegion(std::shared_ptr<const MappedFile> p_image,
+                               size_t offset, size_t size, uint32_t address) {
+  if (offset > p_image->size()) {
+    return;
+  }
+  size_t count = std::min(size, p_image->size() - offset) / 4;
+  if (count == 0) {
+    return;
+  }
+
+  Region region;
+  region.address = address;
+  region.p_bytes = p_image->data() + offset;
+  region.opcodes.resize(count);
+
+  if (reinterpret_cast<uintptr_t>(region.p_bytes) % 4 == 0) {
+    RISC::classifyInstructions(
+        reinterpret_cast<const uint32_t *>(region.p_bytes), count,
+        region.opcodes.data());
+  } else {
+    // Classify an aligned copy, a chunk at a time
+    uint32_t words[CHUNK_WORDS];
+    for (size_t i = 0; i < count; i += CHUNK_WORDS) {
+      size_t n = std::min<size_t>(CHUNK_WORDS, count - i);
+      std::memcpy(words, region.p_bytes + 4 * i, 4 * n);
+      RISC::classifyInstructions(words, n, region.opcodes.data() + i);
+    }
+  }
+
+  images.push_back(p_image);
+  code_regions.push_back(std::move(region));
+}
+
+const PredecodeTable::Region *PredecodeTable::regionOf(uint32_t pc) const {
+  for (const Region &region : code_regions) {
+    uint32_t offset = pc - region.address;
+    if (offset < 4 * region.opcodes.size() && (offset & 3) == 0) {
+      return &region;
+    }
+  }
+  return nullptr;
+}
+
+bool PredecodeTable::firstReachableIllegal(uint32_t entry, uint32_t &address,
+                                           uint32_t &raw) const {
+  std::map<const Region *, std::vector<bool>> visited;
+  for (const Region &region : code_regions) {
+    visited[&region].resize(region.opcodes.size());
+  }
+
+  bool found = false;
+  std::vector<uint32_t> pending = {entry};
+  while (!pending.empty()) {
+    uint32_t pc = pending.back();
+    pending.pop_back();
+    const Region *p_region = regionOf(pc);
+    if (p_region == nullptr) {
+      continue;
+    }
+    size_t index = (pc - p_region->address) >> 2;
+    std::vector<bool>::reference seen = visited[p_region][index];
+    if (seen) {
+      continue;
+    }
+    seen = true;
+
+    RISC::Opcode opcode = p_region->opcodes[index];
+    if (opcode == RISC::Opcode::Illegal) {
+      if (!found || pc < address) {
+        address = pc;
+        raw = p_region->word(index);
+      }
+      found = true;
+      continue;
+    }
+
+    RISC::DecodedInstruction decoded =
+        RISC::decodeInstruction(p_region->word(index), opcode);
+    const RISC::InstructionInfo &info = RISC::instructionInfo(opcode);
+    if (info.syntax == RISC::Syntax::Branch ||
+        opcode == RISC::Opcode::JumpAndLink) {
+      pending.push_back(pc + decoded.imm);
+    }
+    // Calls return after themselves and ebreak resumes after itself. The
+    // target of jalr is not known, and ecall ends the run, often followed
+    // by the program's data.
+    bool jumps = opcode == RISC::Opcode::JumpAndLink ||
+                 opcode == RISC::Opcode::JumpAndLinkReg;
+    if (opcode != RISC::Opcode::Ecall && (!jumps || decoded.rd != 0)) {
+      pending.push_back(pc + 4);
+    }
+  }
+  return found;
+}
+
+size_t PredecodeTable::wordCount() const {
+  size_t count = 0;
+  for (const Region &region : code_regions) {
+    count += region.opcodes.size();
+  }
+  return count;
+}
@@ -1,20 +1,54 @@
 #include "registerfile.h"
+#include "mappedfile.h"
 
-RegisterFile::RegisterFile(std::string _memory_file) : File(_memory_file) {
-  for (int i = 0; i < 32; i++) {
-    data.insert({std::bitset<5>(i), std::bitset<32>(0)});
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+const unsigned int RegisterFile::REGISTER_COUNT;
+
+RegisterFile::RegisterFile(std::string _memory_file)
+    : memory_file(_memory_file) {
+  std::fill(values, values + REGISTER_COUNT, 0);
+
+  MappedFile image(memory_file);
+  if (image.isOpen()) {
+    size_t count = std::min<size_t>(image.size(), REGISTER_COUNT);
+    std::copy(image.data(), image.data() + count, values);
+    values[0] = 0;
   }
 }
 
-std::pair<std::bitset<32>, std::bitset<32>>
-RegisterFile::read(std::bitset<5> reg1, std::bitset<5> reg2) {
-  return std::pair<std::bitset<32>, std::bitset<32>>{data.at(reg1),
-                                                     data.at(reg2)};
+void RegisterFile::copyTo(uint32_t *_values) const {
+  std::copy(values, values + REGISTER_COUNT, _values);
 }
 
-void RegisterFile::write(std::bitset<5> reg, std::bitset<32> value) {
-  if (reg == std::bitset<5>(0)) {
-    return;
+void RegisterFile::copyFrom(const uint32_t *_values) {
+  std::copy(_values, _values + REGISTER_COUNT, values);
+  values[0] = 0;
+}
+
+void RegisterFile::print(std::string prefix) const {
+  for (unsigned int i = 0; i < REGISTER_COUNT; i++) {
+    std::cout << prefix << std::setw(5) << std::setfill(' ') << std::dec << i
+              << ": " << std::setw(32) << std::setfill('0') << std::hex
+              << values[i] << std::endl;
   }
-  data.at(reg) = value;
-}
\ No newline at end of file
+}
+
+void RegisterFile::dump(std::streamsize size, std::string filename) const {
+  if (filename.empty()) {
+    filename = memory_file;
+  }
+
+  std::ofstream file(filename, std::ios::app | std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open/create memory file: " + filename);
+  }
+
+  for (unsigned int i = 0; i < REGISTER_COUNT; i++) {
+    unsigned long value = values[i];
+    file.write(reinterpret_cast<const char *>(&value), size);
+  }
+}
@@ -8,77 +8,80 @@ namespace RISC {
 */
 
 void RType::fetch(std::bitset<32> instruction,
-                  std::shared_ptr<MaskingUnit> p_mu) {
-  rs2 = p_mu->hardwareMaskBits<5, 32>(instruction, 20, 5);
-  rs1 = p_mu->hardwareMaskBits<5, 32>(instruction, 15, 5);
-  rd = p_mu->hardwareMaskBits<5, 32>(instruction, 7, 5);
+                  const std::shared_ptr<MaskingUnit> &p_mu) {
+  rs2 = p_mu->extract<5, Fields::Rs2>(instruction);
+  rs1 = p_mu->extract<5, Fields::Rs1>(instruction);
+  rd = p_mu->extract<5, Fields::Rd>(instruction);
 }
 
-void RType::decode(std::shared_ptr<RegisterFile> p_reg_file,
-                   std::shared_ptr<ImmGenUnit> p_igu) {
+void RType::decode(const std::shared_ptr<RegisterFile> &p_reg_file) {
   auto registers = p_reg_file->read(rs1, rs2);
   rs1_val = registers.first;
   rs2_val = registers.second;
 }
 
-void RType::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void RType::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   pc = p_alu->add(pc, FOUR);
 }
 
-void RType::writeBack(std::shared_ptr<RegisterFile> p_reg_file) {
+void RType::writeBack(const std::shared_ptr<RegisterFile> &p_reg_file) {
   p_reg_file->write(rd, result);
 }
 
-void Add::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void Add::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->add(rs1_val, rs2_val);
   RType::execute(p_alu, pc);
 }
 
-void Sub::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void Sub::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   std::bitset<32> negated = p_alu->negate(rs2_val);
   result = p_alu->add(rs1_val, negated);
   RType::execute(p_alu, pc);
 }
 
-void Xor::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void Xor::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->bitwiseXor(rs1_val, rs2_val);
   RType::execute(p_alu, pc);
 }
 
-void Or::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void Or::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->bitwiseOr(rs1_val, rs2_val);
   RType::execute(p_alu, pc);
 }
 
-void And::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void And::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->bitwiseAnd(rs1_val, rs2_val);
   RType::execute(p_alu, pc);
 }
 
-void ShiftLeftLogi::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void ShiftLeftLogi::execute(const std::shared_ptr<ALU> &p_alu,
+                            std::bitset<32> &pc) {
   rs2_val = p_alu->maskLowFive(rs2_val);
   result = p_alu->hardwareLeftShift(rs1_val, rs2_val);
   RType::execute(p_alu, pc);
 }
 
-void ShiftRightLogi::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void ShiftRightLogi::execute(const std::shared_ptr<ALU> &p_alu,
+                             std::bitset<32> &pc) {
   rs2_val = p_alu->maskLowFive(rs2_val);
   result = p_alu->hardwareRightShift(rs1_val, rs2_val);
   RType::execute(p_alu, pc);
 }
 
-void ShiftRightArith::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void ShiftRightArith::execute(const std::shared_ptr<ALU> &p_alu,
+                              std::bitset<32> &pc) {
   rs2_val = p_alu->maskLowFive(rs2_val);
   result = p_alu->arithmeticRightShift(rs1_val, rs2_val);
   RType::execute(p_alu, pc);
 }
 
-void SetLessThan::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void SetLessThan::execute(const std::shared_ptr<ALU> &p_alu,
+                          std::bitset<32> &pc) {
   result = p_alu->lessThanSigned(rs1_val, rs2_val);
   RType::execute(p_alu, pc);
 }
 
-void SetLessThanUnsigned::execute(std::shared_ptr<ALU> p_alu,
+void SetLessThanUnsigned::execute(const std::shared_ptr<ALU> &p_alu,
                                   std::bitset<32> &pc) {
   result = p_alu->lessThanUnsigned(rs1_val, rs2_val);
   RType::execute(p_alu, pc);
@@ -91,146 +94,152 @@ void SetLessThanUnsigned::execute(std::shared_ptr<ALU> p_alu,
 */
 
 void IType::fetch(std::bitset<32> instruction,
-                  std::shared_ptr<MaskingUnit> p_mu) {
-  rs1 = p_mu->hardwareMaskBits<5, 32>(instruction, 15, 5);
-  rd = p_mu->hardwareMaskBits<5, 32>(instruction, 7, 5);
-  imm = p_mu->hardwareMaskBits<12, 32>(instruction, 20, 12);
+                  const std::shared_ptr<MaskingUnit> &p_mu) {
+  rs1 = p_mu->extract<5, Fields::Rs1>(instruction);
+  rd = p_mu->extract<5, Fields::Rd>(instruction);
+  imm = p_mu->extract<12, Fields::ImmI>(instruction);
 }
 
-void IType::decode(std::shared_ptr<RegisterFile> p_reg_file,
-                   std::shared_ptr<ImmGenUnit> p_igu) {
-  std::pair<std::bitset<32>, std::bitset<32>> registers =
-      p_reg_file->read(rs1, REG_ZERO);
-  rs1_val = registers.first;
+void IType::generateImmediate(const std::shared_ptr<ImmGenUnit> &p_igu) {
   imm_val = p_igu->signExtend(imm);
 }
 
-void IType::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void IType::decode(const std::shared_ptr<RegisterFile> &p_reg_file) {
+  rs1_val = p_reg_file->read(rs1);
+}
+
+void IType::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   pc = p_alu->add(pc, FOUR);
 }
 
-void IType::writeBack(std::shared_ptr<RegisterFile> p_reg_file) {
+void IType::writeBack(const std::shared_ptr<RegisterFile> &p_reg_file) {
   p_reg_file->write(rd, result);
 }
 
-void AddImm::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void AddImm::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->add(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
-void XorImm::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void XorImm::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->bitwiseXor(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
-void OrImm::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void OrImm::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->bitwiseOr(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
-void AndImm::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void AndImm::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->bitwiseAnd(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
-void ShiftLeftLogiImm::execute(std::shared_ptr<ALU> p_alu,
+void ShiftLeftLogiImm::execute(const std::shared_ptr<ALU> &p_alu,
                                std::bitset<32> &pc) {
-  imm_val = p_alu->maskLowFive(imm_val);
-  result = p_alu->hardwareLeftShift(rs1_val, imm_val);
+  std::bitset<32> shamt = p_alu->maskLowFive(imm_val);
+  result = p_alu->hardwareLeftShift(rs1_val, shamt);
   IType::execute(p_alu, pc);
 }
-void ShiftRightLogiImm::execute(std::shared_ptr<ALU> p_alu,
+void ShiftRightLogiImm::execute(const std::shared_ptr<ALU> &p_alu,
                                 std::bitset<32> &pc) {
-  imm_val = p_alu->maskLowFive(imm_val);
-  result = p_alu->hardwareRightShift(rs1_val, imm_val);
+  std::bitset<32> shamt = p_alu->maskLowFive(imm_val);
+  result = p_alu->hardwareRightShift(rs1_val, shamt);
   IType::execute(p_alu, pc);
 }
-void ShiftRightArithImm::execute(std::shared_ptr<ALU> p_alu,
+void ShiftRightArithImm::execute(const std::shared_ptr<ALU> &p_alu,
                                  std::bitset<32> &pc) {
-  imm_val = p_alu->maskLowFive(imm_val);
-  result = p_alu->arithmeticRightShift(rs1_val, imm_val);
+  std::bitset<32> shamt = p_alu->maskLowFive(imm_val);
+  result = p_alu->arithmeticRightShift(rs1_val, shamt);
   IType::execute(p_alu, pc);
 }
-void SetLessThanImm::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void SetLessThanImm::execute(const std::shared_ptr<ALU> &p_alu,
+                             std::bitset<32> &pc) {
   // bool to bitset<32> implicit conversion
   result = p_alu->lessThanSigned(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
-void SetLessThanImmUnsigned::execute(std::shared_ptr<ALU> p_alu,
+void SetLessThanImmUnsigned::execute(const std::shared_ptr<ALU> &p_alu,
                                      std::bitset<32> &pc) {
   // bool to bitset<32> implicit conversion
   result = p_alu->lessThanUnsigned(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
-void LoadWord::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void LoadWord::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->add(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
-void LoadWord::accessMemory(std::shared_ptr<MemoryFile> p_data_file) {
+void LoadWord::accessMemory(const std::shared_ptr<MemoryFile> &p_data_file) {
   result = p_data_file->readBytes(result, 4);
 }
 
-void LoadHalfWord::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void LoadHalfWord::execute(const std::shared_ptr<ALU> &p_alu,
+                           std::bitset<32> &pc) {
   result = p_alu->add(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
-void LoadHalfWord::accessMemory(std::shared_ptr<MemoryFile> p_data_file) {
+void LoadHalfWord::accessMemory(
+    const std::shared_ptr<MemoryFile> &p_data_file) {
   result = p_data_file->readBytes(result, 2, true);
 }
 
-void LoadByte::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void LoadByte::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->add(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
-void LoadByte::accessMemory(std::shared_ptr<MemoryFile> p_data_file) {
+void LoadByte::accessMemory(const std::shared_ptr<MemoryFile> &p_data_file) {
   result = p_data_file->readBytes(result, 1, true);
 }
 
-void LoadUnsignedHalfWord::execute(std::shared_ptr<ALU> p_alu,
+void LoadUnsignedHalfWord::execute(const std::shared_ptr<ALU> &p_alu,
                                    std::bitset<32> &pc) {
   result = p_alu->add(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
 void LoadUnsignedHalfWord::accessMemory(
-    std::shared_ptr<MemoryFile> p_data_file) {
+    const std::shared_ptr<MemoryFile> &p_data_file) {
   result = p_data_file->readBytes(result, 2);
 }
 
-void LoadUnsignedByte::execute(std::shared_ptr<ALU> p_alu,
+void LoadUnsignedByte::execute(const std::shared_ptr<ALU> &p_alu,
                                std::bitset<32> &pc) {
   result = p_alu->add(rs1_val, imm_val);
   IType::execute(p_alu, pc);
 }
 
-void LoadUnsignedByte::accessMemory(std::shared_ptr<MemoryFile> p_data_file) {
+void LoadUnsignedByte::accessMemory(
+    const std::shared_ptr<MemoryFile> &p_data_file) {
   result = p_data_file->readBytes(result, 1);
 }
 
-void JumpAndLinkReg::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void JumpAndLinkReg::execute(const std::shared_ptr<ALU> &p_alu,
+                             std::bitset<32> &pc) {
   result = p_alu->add(pc, FOUR);
   std::bitset<32> offset = p_alu->add(rs1_val, imm_val);
   pc = offset;
 }
 
-void JumpAndLinkReg::writeBack(std::shared_ptr<RegisterFile> p_reg_file) {
+void JumpAndLinkReg::writeBack(
+    const std::shared_ptr<RegisterFile> &p_reg_file) {
   p_reg_file->write(rd, result);
 }
 
-void Ecall::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void Ecall::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   throw EcallTrap();
 }
 
-void Ebreak::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void Ebreak::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   IType::execute(p_alu, pc);
   throw EbreakTrap();
 }
 
-void Fence::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void Fence::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   // No operation
   pc = p_alu->add(pc, FOUR);
 }
@@ -242,38 +251,38 @@ void Fence::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
 */
 
 void SType::fetch(std::bitset<32> instruction,
-                  std::shared_ptr<MaskingUnit> p_mu) {
-  rs2 = p_mu->hardwareMaskBits<5, 32>(instruction, 20, 5);
-  rs1 = p_mu->hardwareMaskBits<5, 32>(instruction, 15, 5);
+                  const std::shared_ptr<MaskingUnit> &p_mu) {
+  rs2 = p_mu->extract<5, Fields::Rs2>(instruction);
+  rs1 = p_mu->extract<5, Fields::Rs1>(instruction);
+  imm = p_mu->extract<12, Fields::ImmS0, Fields::ImmS1>(instruction);
+}
 
-  std::bitset<7> imm1 = p_mu->hardwareMaskBits<7, 32>(instruction, 25, 7);
-  std::bitset<5> imm0 = p_mu->hardwareMaskBits<5, 32>(instruction, 7, 5);
-  imm = p_mu->concatBits<5, 7>(imm0, imm1);
+void SType::generateImmediate(const std::shared_ptr<ImmGenUnit> &p_igu) {
+  imm_val = p_igu->signExtend(imm);
 }
 
-void SType::decode(std::shared_ptr<RegisterFile> p_reg_file,
-                   std::shared_ptr<ImmGenUnit> p_igu) {
+void SType::decode(const std::shared_ptr<RegisterFile> &p_reg_file) {
   std::pair<std::bitset<32>, std::bitset<32>> registers =
       p_reg_file->read(rs1, rs2);
   rs1_val = registers.first;
   rs2_val = registers.second;
-  imm_val = p_igu->signExtend(imm);
 }
 
-void SType::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void SType::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->add(rs1_val, imm_val);
   pc = p_alu->add(pc, FOUR);
 }
 
-void SaveWord::accessMemory(std::shared_ptr<MemoryFile> p_data_file) {
+void SaveWord::accessMemory(const std::shared_ptr<MemoryFile> &p_data_file) {
   p_data_file->writeBytes(result, rs2_val, 4);
 }
 
-void SaveHalfWord::accessMemory(std::shared_ptr<MemoryFile> p_data_file) {
+void SaveHalfWord::accessMemory(
+    const std::shared_ptr<MemoryFile> &p_data_file) {
   p_data_file->writeBytes(result, rs2_val, 2);
 }
 
-void SaveByte::accessMemory(std::shared_ptr<MemoryFile> p_data_file) {
+void SaveByte::accessMemory(const std::shared_ptr<MemoryFile> &p_data_file) {
   p_data_file->writeBytes(result, rs2_val, 1);
 }
 
@@ -284,84 +293,89 @@ void SaveByte::accessMemory(std::shared_ptr<MemoryFile> p_data_file) {
 */
 
 void BType::fetch(std::bitset<32> instruction,
-                  std::shared_ptr<MaskingUnit> p_mu) {
-  rs2 = p_mu->hardwareMaskBits<5, 32>(instruction, 20, 5);
-  rs1 = p_mu->hardwareMaskBits<5, 32>(instruction, 15, 5);
+                  const std::shared_ptr<MaskingUnit> &p_mu) {
+  rs2 = p_mu->extract<5, Fields::Rs2>(instruction);
+  rs1 = p_mu->extract<5, Fields::Rs1>(instruction);
+  imm = p_mu->extract<12, Fields::ImmB0, Fields::ImmB1, Fields::ImmB2,
+                      Fields::ImmB3>(instruction);
+}
 
-  std::bitset<1> imm3 = p_mu->hardwareMaskBits<1, 32>(instruction, 31, 1);
-  std::bitset<6> imm1 = p_mu->hardwareMaskBits<6, 32>(instruction, 25, 6);
-  std::bitset<4> imm0 = p_mu->hardwareMaskBits<4, 32>(instruction, 8, 4);
-  std::bitset<1> imm2 = p_mu->hardwareMaskBits<1, 32>(instruction, 7, 1);
-  std::bitset<10> low_bits = p_mu->concatBits<4, 6>(imm0, imm1);
-  std::bitset<2> high_bits = p_mu->concatBits<1, 1>(imm2, imm3);
-  imm = p_mu->concatBits<10, 2>(low_bits, high_bits);
+void BType::generateImmediate(const std::shared_ptr<ImmGenUnit> &p_igu) {
+  imm_val = p_igu->signExtend(imm);
 }
 
-void BType::decode(std::shared_ptr<RegisterFile> p_reg_file,
-                   std::shared_ptr<ImmGenUnit> p_igu) {
+void BType::decode(const std::shared_ptr<RegisterFile> &p_reg_file) {
   std::pair<std::bitset<32>, std::bitset<32>> registers =
       p_reg_file->read(rs1, rs2);
   rs1_val = registers.first;
   rs2_val = registers.second;
-  imm_val = p_igu->signExtend(imm);
 }
 
-void BType::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
-  imm_val = p_alu->hardwareLeftShift(imm_val, ONE);
+void BType::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
+  offset = p_alu->hardwareLeftShift(imm_val, ONE);
 }
 
-void BranchEqual::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void BranchEqual::execute(const std::shared_ptr<ALU> &p_alu,
+                          std::bitset<32> &pc) {
   BType::execute(p_alu, pc);
-  if (p_alu->hardwareIsEqual(rs1_val, rs2_val)) {
-    pc = p_alu->add(pc, imm_val);
+  taken = p_alu->hardwareIsEqual(rs1_val, rs2_val);
+  if (taken) {
+    pc = p_alu->add(pc, offset);
   } else {
     pc = p_alu->add(pc, FOUR);
   }
 }
 
-void BranchNotEqual::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void BranchNotEqual::execute(const std::shared_ptr<ALU> &p_alu,
+                             std::bitset<32> &pc) {
   BType::execute(p_alu, pc);
-  if (!p_alu->hardwareIsEqual(rs1_val, rs2_val)) {
-    pc = p_alu->add(pc, imm_val);
+  taken = !p_alu->hardwareIsEqual(rs1_val, rs2_val);
+  if (taken) {
+    pc = p_alu->add(pc, offset);
   } else {
     pc = p_alu->add(pc, FOUR);
   }
 }
 
-void BranchLessThan::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void BranchLessThan::execute(const std::shared_ptr<ALU> &p_alu,
+                             std::bitset<32> &pc) {
   BType::execute(p_alu, pc);
-  if (p_alu->lessThanSigned(rs1_val, rs2_val)) {
-    pc = p_alu->add(pc, imm_val);
+  taken = p_alu->lessThanSigned(rs1_val, rs2_val);
+  if (taken) {
+    pc = p_alu->add(pc, offset);
   } else {
     pc = p_alu->add(pc, FOUR);
   }
 }
 
-void BranchLessThanUnsigned::execute(std::shared_ptr<ALU> p_alu,
+void BranchLessThanUnsigned::execute(const std::shared_ptr<ALU> &p_alu,
                                      std::bitset<32> &pc) {
   BType::execute(p_alu, pc);
-  if (p_alu->lessThanUnsigned(rs1_val, rs2_val)) {
-    pc = p_alu->add(pc, imm_val);
+  taken = p_alu->lessThanUnsigned(rs1_val, rs2_val);
+  if (taken) {
+    pc = p_alu->add(pc, offset);
   } else {
     pc = p_alu->add(pc, FOUR);
   }
 }
 
-void BranchGreaterThanEqual::execute(std::shared_ptr<ALU> p_alu,
+void BranchGreaterThanEqual::execute(const std::shared_ptr<ALU> &p_alu,
                                      std::bitset<32> &pc) {
   BType::execute(p_alu, pc);
-  if (p_alu->greaterThanEqualSigned(rs2_val, rs1_val)) {
-    pc = p_alu->add(pc, imm_val);
+  taken = p_alu->greaterThanEqualSigned(rs2_val, rs1_val);
+  if (taken) {
+    pc = p_alu->add(pc, offset);
   } else {
     pc = p_alu->add(pc, FOUR);
   }
 }
 
-void BranchGreaterThanEqualUnsigned::execute(std::shared_ptr<ALU> p_alu,
+void BranchGreaterThanEqualUnsigned::execute(const std::shared_ptr<ALU> &p_alu,
                                              std::bitset<32> &pc) {
   BType::execute(p_alu, pc);
-  if (p_alu->greaterThanEqualUnsigned(rs2_val, rs1_val)) {
-    pc = p_alu->add(pc, imm_val);
+  taken = p_alu->greaterThanEqualUnsigned(rs2_val, rs1_val);
+  if (taken) {
+    pc = p_alu->add(pc, offset);
   } else {
     pc = p_alu->add(pc, FOUR);
   }
@@ -374,27 +388,26 @@ void BranchGreaterThanEqualUnsigned::execute(std::shared_ptr<ALU> p_alu,
 */
 
 void UType::fetch(std::bitset<32> instruction,
-                  std::shared_ptr<MaskingUnit> p_mu) {
-  rd = p_mu->hardwareMaskBits<5, 32>(instruction, 7, 5);
-  imm_long = p_mu->hardwareMaskBits<20, 32>(instruction, 12, 20);
+                  const std::shared_ptr<MaskingUnit> &p_mu) {
+  rd = p_mu->extract<5, Fields::Rd>(instruction);
+  imm_long = p_mu->extract<20, Fields::ImmU>(instruction);
 }
 
-void UType::decode(std::shared_ptr<RegisterFile> p_reg_file,
-                   std::shared_ptr<ImmGenUnit> p_igu) {
+void UType::generateImmediate(const std::shared_ptr<ImmGenUnit> &p_igu) {
   imm_val = p_igu->generateLong(imm_long);
 }
 
-void UType::writeBack(std::shared_ptr<RegisterFile> p_reg_file) {
+void UType::writeBack(const std::shared_ptr<RegisterFile> &p_reg_file) {
   p_reg_file->write(rd, result);
 }
 
-void LoadUpperImmediate::execute(std::shared_ptr<ALU> p_alu,
+void LoadUpperImmediate::execute(const std::shared_ptr<ALU> &p_alu,
                                  std::bitset<32> &pc) {
   result = imm_val;
   pc = p_alu->add(pc, FOUR);
 }
 
-void AddUpperImmedateToPC::execute(std::shared_ptr<ALU> p_alu,
+void AddUpperImmedateToPC::execute(const std::shared_ptr<ALU> &p_alu,
                                    std::bitset<32> &pc) {
   result = p_alu->add(pc, imm_val);
   pc = p_alu->add(pc, FOUR);
@@ -407,31 +420,130 @@ void AddUpperImmedateToPC::execute(std::shared_ptr<ALU> p_alu,
 */
 
 void JType::fetch(std::bitset<32> instruction,
-                  std::shared_ptr<MaskingUnit> p_mu) {
-  rd = p_mu->hardwareMaskBits<5, 32>(instruction, 7, 5);
-
-  std::bitset<1> imm3 = p_mu->hardwareMaskBits<1, 32>(instruction, 31, 1);
-  std::bitset<10> imm0 = p_mu->hardwareMaskBits<10, 32>(instruction, 21, 10);
-  std::bitset<1> imm1 = p_mu->hardwareMaskBits<1, 32>(instruction, 20, 1);
-  std::bitset<8> imm2 = p_mu->hardwareMaskBits<8, 32>(instruction, 12, 8);
-  std::bitset<11> low_bits = p_mu->concatBits<10, 1>(imm0, imm1);
-  std::bitset<9> high_bits = p_mu->concatBits<8, 1>(imm2, imm3);
-  imm_long = p_mu->concatBits<11, 9>(low_bits, high_bits);
+                  const std::shared_ptr<MaskingUnit> &p_mu) {
+  rd = p_mu->extract<5, Fields::Rd>(instruction);
+  imm_long = p_mu->extract<20, Fields::ImmJ0, Fields::ImmJ1, Fields::ImmJ2,
+                           Fields::ImmJ3>(instruction);
 }
 
-void JType::decode(std::shared_ptr<RegisterFile> p_reg_file,
-                   std::shared_ptr<ImmGenUnit> p_igu) {
+void JType::generateImmediate(const std::shared_ptr<ImmGenUnit> &p_igu) {
   imm_val = p_igu->signExtend(imm_long);
 }
 
-void JType::execute(std::shared_ptr<ALU> p_alu, std::bitset<32> &pc) {
+void JType::execute(const std::shared_ptr<ALU> &p_alu, std::bitset<32> &pc) {
   result = p_alu->add(pc, FOUR);
   std::bitset<32> imm_val_shifted = p_alu->add(imm_val, imm_val);
   pc = p_alu->add(pc, imm_val_shifted);
 }
 
-void JType::writeBack(std::shared_ptr<RegisterFile> p_reg_file) {
+void JType::writeBack(const std::shared_ptr<RegisterFile> &p_reg_file) {
   p_reg_file->write(rd, result);
 }
 
+/*
+=========================
+    Instruction Storage
+=========================
+*/
+
+Instruction *InstructionSlot::emplace(Opcode opcode) {
+  switch (opcode) {
+  // RType
+  case Opcode::Add:
+    return construct<Add>();
+  case Opcode::Sub:
+    return construct<Sub>();
+  case Opcode::Xor:
+    return construct<Xor>();
+  case Opcode::Or:
+    return construct<Or>();
+  case Opcode::And:
+    return construct<And>();
+  case Opcode::ShiftLeftLogi:
+    return construct<ShiftLeftLogi>();
+  case Opcode::ShiftRightLogi:
+    return construct<ShiftRightLogi>();
+  case Opcode::ShiftRightArith:
+    return construct<ShiftRightArith>();
+  case Opcode::SetLessThan:
+    return construct<SetLessThan>();
+  case Opcode::SetLessThanUnsigned:
+    return construct<SetLessThanUnsigned>();
+  // IType
+  case Opcode::AddImm:
+    return construct<AddImm>();
+  case Opcode::XorImm:
+    return construct<XorImm>();
+  case Opcode::OrImm:
+    return construct<OrImm>();
+  case Opcode::AndImm:
+    return construct<AndImm>();
+  case Opcode::ShiftLeftLogiImm:
+    return construct<ShiftLeftLogiImm>();
+  case Opcode::ShiftRightLogiImm:
+    return construct<ShiftRightLogiImm>();
+  case Opcode::ShiftRightArithImm:
+    return construct<ShiftRightArithImm>();
+  case Opcode::SetLessThanImm:
+    return construct<SetLessThanImm>();
+  case Opcode::SetLessThanImmUnsigned:
+    return construct<SetLessThanImmUnsigned>();
+  case Opcode::LoadWord:
+    return construct<LoadWord>();
+  case Opcode::LoadHalfWord:
+    return construct<LoadHalfWord>();
+  case Opcode::LoadByte:
+    return construct<LoadByte>();
+  case Opcode::LoadUnsignedHalfWord:
+    return construct<LoadUnsignedHalfWord>();
+  case Opcode::LoadUnsignedByte:
+    return construct<LoadUnsignedByte>();
+  case Opcode::JumpAndLinkReg:
+    return construct<JumpAndLinkReg>();
+  case Opcode::Ecall:
+    return construct<Ecall>();
+  case Opcode::Ebreak:
+    return construct<Ebreak>();
+  case Opcode::Fence:
+    return construct<Fence>();
+  // SType
+  case Opcode::SaveWord:
+    return construct<SaveWord>();
+  case Opcode::SaveHalfWord:
+    return construct<SaveHalfWord>();
+  case Opcode::SaveByte:
+    return construct<SaveByte>();
+  // BType
+  case Opcode::BranchEqual:
+    return construct<BranchEqual>();
+  case Opcode::BranchNotEqual:
+    return construct<BranchNotEqual>();
+  case Opcode::BranchLessThan:
+    return construct<BranchLessThan>();
+  case Opcode::BranchGreaterThanEqual:
+    return construct<BranchGreaterThanEqual>();
+  case Opcode::BranchLessThanUnsigned:
+    return construct<BranchLessThanUnsigned>();
+  case Opcode::BranchGreaterThanEqualUnsigned:
+    return construct<BranchGreaterThanEqualUnsigned>();
+  // UType
+  case Opcode::LoadUpperImmediate:
+    return construct<LoadUpperImmediate>();
+  case Opcode::AddUpperImmedateToPC:
+    return construct<AddUpperImmedateToPC>();
+  // JType
+  case Opcode::JumpAndLink:
+    return construct<JumpAndLink>();
+  default:
+    throw std::runtime_error("Cannot construct an illegal instruction");
+  }
+}
+
+void InstructionSlot::clear() {
+  if (p_instruction) {
+    p_instruction->~Instruction();
+    p_instruction = nullptr;
+  }
+}
+
 } // namespace RISC
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "snapshot.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+const uint32_t Snapshot::VERSION;
+
+namespace {
+
+const char MAGIC[8] = {'R', 'V', '3', '2', 'S', 'N', 'A', 'P'};
+
+void writeWord(std::ostream &out, uint64_t value, unsigned int n) {
+  char bytes[8];
+  for (unsigned int i = 0; i < n; i++) {
+    bytes[i] = static_cast<char>(value >> (i * 8));
+  }
+  out.write(bytes, n);
+}
+
+uint64_t readWord(std::istream &in, unsigned int n,
+                  const std::string &filename) {
+  unsigned char bytes[8];
+  if (!in.read(reinterpret_cast<char *>(bytes), n)) {
+    throw std::runtime_error("Truncated snapshot file: " + filename);
+  }
+  uint64_t value = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    value |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+  }
+  return value;
+}
+
+// Every all-zero page of every loaded snapshot shares this one
+std::shared_ptr<const uint8_t> zeroPage() {
+  static const std::shared_ptr<const uint8_t> p_zero(
+      new uint8_t[PagedMemory::PAGE_SIZE](), std::default_delete<uint8_t[]>());
+  return p_zero;
+}
+
+} // namespace
+
+void Snapshot::save(const std::string &filename) const {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open/create snapshot file: " +
+                             filename);
+  }
+
+  file.write(MAGIC, sizeof(MAGIC));
+  writeWord(file, VERSION, 4);
+  writeWord(file, pc, 4);
+  writeWord(file, cycles, 8);
+  for (uint32_t value : registers) {
+    writeWord(file, value, 4);
+  }
+
+  writeWord(file, pages.size(), 4);
+  for (const PagedMemory::SharedPage &page : pages) {
+    const uint8_t *p_bytes = page.p_bytes.get();
+    uint32_t length = PagedMemory::PAGE_SIZE;
+    while (length > 0 && p_bytes[length - 1] == 0) {
+      length--;
+    }
+    writeWord(file, page.number, 4);
+    writeWord(file, length, 4);
+    file.write(reinterpret_cast<const char *>(p_bytes), length);
+  }
+
+  if (!file) {
+    throw std::runtime_error("Could not write snapshot file: " + filename);
+  }
+}
+
+Snapshot Snapshot::load(const std::string &filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open snapshot file: " + filename);
+  }
+
+  char magic[sizeof(MAGIC)];
+  if (!file.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error("Not a snapshot file: " + filename);
+  }
+  uint32_t version = readWord(file, 4, filename);
+  if (version != VERSION) {
+    throw std::runtime_error("Unsupported snapshot version " +
+                             std::to_string(version) + ": " + filename);
+  }
+
+  Snapshot snapshot;
+  snapshot.pc = readWord(file, 4, filename);
+  snapshot.cycles = readWord(file, 8, filename);
+  for (uint32_t &value : snapshot.registers) {
+    value = readWord(file, 4, filename);
+  }
+
+  uint32_t page_count = readWord(file, 4, filename);
+  snapshot.pages.reserve(page_count);
+  for (uint32_t i = 0; i < page_count; i++) {
+    uint32_t number = readWord(file, 4, filename);
+    uint32_t length = readWord(file, 4, filename);
+    if (length > PagedMemory::PAGE_SIZE ||
+        number >= (1u << (32 - PagedMemory::PAGE_BITS))) {
+      throw std::runtime_error("Corrupt snapshot file: " + filename);
+    }
+    if (length == 0) {
+      snapshot.pages.push_back({number, zeroPage()});
+      continue;
+    }
+    uint8_t *p_bytes = new uint8_t[PagedMemory::PAGE_SIZE]();
+    std::shared_ptr<const uint8_t> p_page(p_bytes,
+                                          std::default_delete<uint8_t[]>());
+    if (!file.read(reinterpret_cast<char *>(p_bytes), length)) {
+      throw std::runtime_error("Truncated snapshot file: " + filename);
+    }
+    snapshot.pages.push_back({number, p_page});
+  }
+  return snapshot;
+}
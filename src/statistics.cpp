@@ -0,0 +1,136 @@
+#include "statistics.h"
+
+#include <iomanip>
+#include <map>
+
+namespace {
+
+const unsigned int OPCODE_COUNT =
+    static_cast<unsigned int>(RISC::Opcode::Count);
+
+const RISC::InstructionInfo &infoAt(unsigned int index) {
+  return RISC::instructionInfo(static_cast<RISC::Opcode>(index));
+}
+
+} // namespace
+
+Statistics::Statistics() {
+  for (unsigned int i = 0; i < OPCODE_COUNT; i++) {
+    is_branch[i] = infoAt(i).syntax == RISC::Syntax::Branch;
+  }
+  reset();
+}
+
+void Statistics::retire(const RISC::Opcode *opcodes, unsigned int count,
+                        uint32_t last_pc, bool taken) {
+  for (unsigned int i = 0; i + 1 < count; i++) {
+    retire(opcodes[i]);
+  }
+  if (count > 0) {
+    retire(opcodes[count - 1], last_pc, taken);
+  }
+}
+
+void Statistics::reset() {
+  for (unsigned int i = 0; i < OPCODE_COUNT; i++) {
+    opcode_counts[i] = 0;
+  }
+  branches.clear();
+  start = std::chrono::steady_clock::now();
+}
+
+unsigned long Statistics::retired() const {
+  unsigned long total = 0;
+  for (unsigned int i = 0; i < OPCODE_COUNT; i++) {
+    total += opcode_counts[i];
+  }
+  return total;
+}
+
+double Statistics::wallTime() const {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+void Statistics::memoryTotals(bool stores, unsigned long &count,
+                              unsigned long &bytes) const {
+  count = 0;
+  bytes = 0;
+  for (unsigned int i = 0; i < OPCODE_COUNT; i++) {
+    const RISC::InstructionInfo &info = infoAt(i);
+    if (info.access_size != 0 &&
+        (info.syntax == RISC::Syntax::Store) == stores) {
+      count += opcode_counts[i];
+      bytes += opcode_counts[i] * info.access_size;
+    }
+  }
+}
+
+void Statistics::print(std::ostream &out) const {
+  unsigned long total = retired();
+  double seconds = wallTime();
+  unsigned long loads, load_bytes, stores, store_bytes;
+  memoryTotals(false, loads, load_bytes);
+  memoryTotals(true, stores, store_bytes);
+
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  out << "instructions: " << total << "\n"
+      << "wall time: " << seconds << " s ("
+      << (seconds > 0 ? total / seconds / 1e6 : 0) << " MIPS)\n"
+      << "loads: " << loads << " (" << load_bytes << " bytes)\n"
+      << "stores: " << stores << " (" << store_bytes << " bytes)\n"
+      << "instruction mix:\n";
+  for (unsigned int i = 0; i < OPCODE_COUNT; i++) {
+    if (opcode_counts[i] == 0) {
+      continue;
+    }
+    out << "  " << std::left << std::setw(8) << infoAt(i).mnemonic
+        << std::right << std::setw(12) << opcode_counts[i] << "  "
+        << std::setw(7) << 100.0 * opcode_counts[i] / total << "%\n";
+  }
+  out << "branches (pc, taken, not taken):\n";
+  std::map<uint32_t, BranchCounts> sorted(branches.begin(), branches.end());
+  for (const auto &branch : sorted) {
+    out << "  0x" << std::hex << std::setfill('0') << std::setw(8)
+        << branch.first << std::dec << std::setfill(' ') << std::setw(12)
+        << branch.second.taken << std::setw(12) << branch.second.not_taken
+        << "\n";
+  }
+  out.flags(flags);
+}
+
+void Statistics::writeJson(std::ostream &out) const {
+  unsigned long total = retired();
+  double seconds = wallTime();
+  unsigned long loads, load_bytes, stores, store_bytes;
+  memoryTotals(false, loads, load_bytes);
+  memoryTotals(true, stores, store_bytes);
+
+  out << "{\n  \"instructions\": " << total
+      << ",\n  \"wall_time_seconds\": " << seconds
+      << ",\n  \"mips\": " << (seconds > 0 ? total / seconds / 1e6 : 0)
+      << ",\n  \"loads\": {\"count\": " << loads << ", \"bytes\": "
+      << load_bytes << "},\n  \"stores\": {\"count\": " << stores
+      << ", \"bytes\": " << store_bytes << "},\n  \"opcodes\": {";
+  bool first = true;
+  for (unsigned int i = 0; i < OPCODE_COUNT; i++) {
+    if (opcode_counts[i] == 0) {
+      continue;
+    }
+    out << (first ? "\n" : ",\n") << "    \"" << infoAt(i).mnemonic
+        << "\": " << opcode_counts[i];
+    first = false;
+  }
+  out << "\n  },\n  \"branches\": [";
+  first = true;
+  std::map<uint32_t, BranchCounts> sorted(branches.begin(), branches.end());
+  for (const auto &branch : sorted) {
+    out << (first ? "\n" : ",\n") << "    {\"pc\": " << branch.first
+        << ", \"taken\": " << branch.second.taken
+        << ", \"not_taken\": " << branch.second.not_taken << "}";
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+}
@@ -0,0 +1,467 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef RV32SIM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+const uint32_t TraceWriter::VERSION;
+
+namespace {
+
+const char MAGIC[8] = {'R', 'V', '3', '2', 'T', 'R', 'C', 'E'};
+
+// Bits of the byte that starts every encoded record
+const uint8_t HAS_PC = 0x01;
+const uint8_t HAS_RAW = 0x02;
+const uint8_t HAS_RD = 0x04;
+const uint8_t HAS_MEM = 0x08;
+const uint8_t IS_STORE = 0x10;
+// log2 of the access size
+const unsigned int SIZE_SHIFT = 5;
+
+// Records drained by the writer thread at a time
+const size_t BATCH_SIZE = 4096;
+
+// How the records after the header are stored, in version 2 files
+const uint8_t UNCOMPRESSED = 0;
+const uint8_t ZLIB = 1;
+
+// Bytes passed to and taken from zlib at a time
+const size_t CHUNK_SIZE = 64 * 1024;
+
+// Maps small negative differences to small unsigned numbers
+uint32_t zigzag(uint32_t value) {
+  return (value << 1) ^ (0u - (value >> 31));
+}
+
+uint32_t unzigzag(uint32_t value) { return (value >> 1) ^ (0u - (value & 1)); }
+
+// An encoded record is at most a header, three 5-byte varints, the
+// instruction word and the register number
+const size_t MAX_ENCODED_SIZE = 1 + 3 * 5 + 4 + 1;
+
+uint8_t *putVarint(uint8_t *p_out, uint32_t value) {
+  while (value >= 0x80) {
+    *p_out++ = static_cast<uint8_t>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  *p_out++ = static_cast<uint8_t>(value);
+  return p_out;
+}
+
+} // namespace
+
+/// \brief The context records are delta-encoded against. The encoder and
+/// the decoder update it identically after every record.
+class TraceCodec {
+public:
+  static const unsigned int RAW_CACHE_BITS = 12;
+
+  uint32_t next_pc = 0;
+  uint32_t registers[32] = {};
+  uint32_t mem_address = 0;
+  // The last instruction word seen at each PC, direct mapped
+  struct RawEntry {
+    uint32_t pc = ~0u;
+    uint32_t raw = 0;
+  } raws[1u << RAW_CACHE_BITS];
+
+  RawEntry &rawEntry(uint32_t pc) {
+    return raws[(pc >> 2) & ((1u << RAW_CACHE_BITS) - 1)];
+  }
+
+  void update(const TraceRecord &record) {
+    next_pc = record.pc + 4;
+    RawEntry &entry = rawEntry(record.pc);
+    entry.pc = record.pc;
+    entry.raw = record.raw;
+    if (record.rd != 0) {
+      registers[record.rd] = record.rd_value;
+    }
+    if (record.mem_size != 0) {
+      mem_address = record.mem_address;
+    }
+  }
+
+  /// \brief Encodes \p record into at most MAX_ENCODED_SIZE bytes at
+  /// \p p_out.
+  /// \returns The end of the encoded record.
+  uint8_t *encode(const TraceRecord &record, uint8_t *p_out) {
+    RawEntry &entry = rawEntry(record.pc);
+    uint8_t header = 0;
+    if (record.pc != next_pc) {
+      header |= HAS_PC;
+    }
+    if (entry.pc != record.pc || entry.raw != record.raw) {
+      header |= HAS_RAW;
+    }
+    if (record.rd != 0) {
+      header |= HAS_RD;
+    }
+    if (record.mem_size != 0) {
+      header |= HAS_MEM | (record.mem_size == 4   ? 2u << SIZE_SHIFT
+                           : record.mem_size == 2 ? 1u << SIZE_SHIFT
+                                                  : 0);
+      if (record.is_store) {
+        header |= IS_STORE;
+      }
+    }
+
+    *p_out++ = header;
+    if (header & HAS_PC) {
+      p_out = putVarint(p_out, zigzag(record.pc - next_pc));
+    }
+    if (header & HAS_RAW) {
+      for (unsigned int i = 0; i < 4; i++) {
+        *p_out++ = static_cast<uint8_t>(record.raw >> (i * 8));
+      }
+    }
+    if (header & HAS_RD) {
+      *p_out++ = record.rd;
+      p_out = putVarint(p_out, zigzag(record.rd_value - registers[record.rd]));
+    }
+    if (header & HAS_MEM) {
+      p_out = putVarint(p_out, zigzag(record.mem_address - mem_address));
+      p_out = putVarint(p_out, record.mem_value);
+    }
+    update(record);
+    return p_out;
+  }
+};
+
+/*
+=========================
+    Compression
+=========================
+*/
+
+#ifdef RV32SIM_HAVE_ZLIB
+
+class TraceDeflater {
+public:
+  explicit TraceDeflater(std::ostream &_out)
+      : out(_out), buffer(new uint8_t[CHUNK_SIZE]) {
+    stream = z_stream();
+    // The fastest level already shrinks loops to a fraction, and keeps the
+    // writer thread ahead of the simulation
+    if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK) {
+      throw std::runtime_error("Could not initialize trace compression");
+    }
+  }
+  ~TraceDeflater() { deflateEnd(&stream); }
+
+  /// \brief Compresses \p size bytes at \p data and writes what zlib
+  /// produces.
+  void write(const uint8_t *data, size_t size) { run(data, size, Z_NO_FLUSH); }
+
+  /// \brief Writes the end of the compressed stream.
+  void finish() { run(nullptr, 0, Z_FINISH); }
+
+private:
+  std::ostream &out;
+  std::unique_ptr<uint8_t[]> buffer;
+  z_stream stream;
+
+  void run(const uint8_t *data, size_t size, int flush) {
+    stream.next_in = const_cast<Bytef *>(data);
+    stream.avail_in = static_cast<uInt>(size);
+    int status;
+    do {
+      stream.next_out = buffer.get();
+      stream.avail_out = static_cast<uInt>(CHUNK_SIZE);
+      status = deflate(&stream, flush);
+      out.write(reinterpret_cast<const char *>(buffer.get()),
+                CHUNK_SIZE - stream.avail_out);
+    } while (stream.avail_out == 0 ||
+             (flush == Z_FINISH && status != Z_STREAM_END));
+  }
+};
+
+class TraceInflater {
+public:
+  TraceInflater(std::istream &_in, const std::string &_filename)
+      : in(_in), filename(_filename), input(new uint8_t[CHUNK_SIZE]),
+        output(new uint8_t[CHUNK_SIZE]), p_next(nullptr), p_end(nullptr),
+        ended(false) {
+    stream = z_stream();
+    if (inflateInit(&stream) != Z_OK) {
+      throw std::runtime_error("Could not initialize trace decompression");
+    }
+  }
+  ~TraceInflater() { inflateEnd(&stream); }
+
+  /// \returns The next decompressed byte, or EOF after the last one.
+  int get() {
+    if (p_next == p_end && !refill()) {
+      return EOF;
+    }
+    return *p_next++;
+  }
+
+private:
+  std::istream &in;
+  std::string filename;
+  std::unique_ptr<uint8_t[]> input;
+  std::unique_ptr<uint8_t[]> output;
+  const uint8_t *p_next;
+  const uint8_t *p_end;
+  bool ended;
+  z_stream stream;
+
+  // Decompresses more bytes into the output buffer
+  // \returns False at the end of the compressed stream.
+  bool refill() {
+    while (!ended) {
+      if (stream.avail_in == 0) {
+        in.read(reinterpret_cast<char *>(input.get()), CHUNK_SIZE);
+        if (in.gcount() == 0) {
+          throw std::runtime_error("Truncated trace file: " + filename);
+        }
+        stream.next_in = input.get();
+        stream.avail_in = static_cast<uInt>(in.gcount());
+      }
+      stream.next_out = output.get();
+      stream.avail_out = static_cast<uInt>(CHUNK_SIZE);
+      int status = inflate(&stream, Z_NO_FLUSH);
+      if (status == Z_STREAM_END) {
+        ended = true;
+      } else if (status != Z_OK && status != Z_BUF_ERROR) {
+        throw std::runtime_error("Corrupt trace file: " + filename);
+      }
+      p_next = output.get();
+      p_end = output.get() + (CHUNK_SIZE - stream.avail_out);
+      if (p_next != p_end) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+#else
+
+// Without zlib, traces are written uncompressed and compressed ones are
+// rejected, so neither class is ever created
+class TraceDeflater {
+public:
+  void write(const uint8_t *, size_t) {}
+  void finish() {}
+};
+
+class TraceInflater {
+public:
+  int get() { return EOF; }
+};
+
+#endif // RV32SIM_HAVE_ZLIB
+
+/*
+=========================
+    TraceBuffer
+=========================
+*/
+
+TraceBuffer::TraceBuffer(unsigned int capacity_bits)
+    : records(new TraceRecord[size_t(1) << capacity_bits]),
+      mask((size_t(1) << capacity_bits) - 1), head(0), cached_tail(0),
+      tail(0), cached_head(0) {}
+
+size_t TraceBuffer::pop(TraceRecord *out, size_t max) {
+  size_t current = tail.load(std::memory_order_relaxed);
+  if (current == cached_head) {
+    cached_head = head.load(std::memory_order_acquire);
+  }
+  size_t count = std::min(max, cached_head - current);
+  for (size_t i = 0; i < count; i++) {
+    out[i] = records[(current + i) & mask];
+  }
+  tail.store(current + count, std::memory_order_release);
+  return count;
+}
+
+/*
+=========================
+    TraceWriter
+=========================
+*/
+
+TraceWriter::TraceWriter(const std::string &filename,
+                         const std::vector<TraceRange> &_ranges)
+    : ranges(_ranges), file(filename, std::ios::binary), stopping(false) {
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open/create trace file: " + filename);
+  }
+  file.write(MAGIC, sizeof(MAGIC));
+  for (unsigned int i = 0; i < 4; i++) {
+    file.put(static_cast<char>(VERSION >> (i * 8)));
+  }
+#ifdef RV32SIM_HAVE_ZLIB
+  file.put(static_cast<char>(ZLIB));
+  p_deflater = std::make_shared<TraceDeflater>(file);
+#else
+  file.put(static_cast<char>(UNCOMPRESSED));
+#endif
+  writer = std::thread(&TraceWriter::drain, this);
+}
+
+TraceWriter::~TraceWriter() { close(); }
+
+void TraceWriter::close() {
+  if (!writer.joinable()) {
+    return;
+  }
+  stopping.store(true, std::memory_order_release);
+  writer.join();
+  file.close();
+}
+
+void TraceWriter::waitAndPush(const TraceRecord &record) {
+  while (!buffer.tryPush(record)) {
+    std::this_thread::yield();
+  }
+}
+
+void TraceWriter::drain() {
+  std::unique_ptr<TraceCodec> p_codec(new TraceCodec());
+  std::unique_ptr<TraceRecord[]> batch(new TraceRecord[BATCH_SIZE]);
+  std::unique_ptr<uint8_t[]> encoded(
+      new uint8_t[BATCH_SIZE * MAX_ENCODED_SIZE]);
+
+  while (true) {
+    // Read the flag first, so that records pushed before close() are
+    // drained before the thread exits
+    bool stop = stopping.load(std::memory_order_acquire);
+    size_t count = buffer.pop(batch.get(), BATCH_SIZE);
+    if (count == 0) {
+      if (stop) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(1000));
+      continue;
+    }
+
+    uint8_t *p_end = encoded.get();
+    for (size_t i = 0; i < count; i++) {
+      p_end = p_codec->encode(batch[i], p_end);
+    }
+    if (p_deflater) {
+      p_deflater->write(encoded.get(), p_end - encoded.get());
+    } else {
+      file.write(reinterpret_cast<const char *>(encoded.get()),
+                 p_end - encoded.get());
+    }
+  }
+  if (p_deflater) {
+    p_deflater->finish();
+  }
+  file.flush();
+}
+
+/*
+=========================
+    TraceReader
+=========================
+*/
+
+TraceReader::TraceReader(const std::string &_filename)
+    : file(_filename, std::ios::binary), filename(_filename),
+      p_codec(std::make_shared<TraceCodec>()) {
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open trace file: " + filename);
+  }
+
+  char magic[sizeof(MAGIC)];
+  unsigned char version[4];
+  if (!file.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      !file.read(reinterpret_cast<char *>(version), sizeof(version))) {
+    throw std::runtime_error("Not a trace file: " + filename);
+  }
+  uint32_t number = version[0] | (version[1] << 8) | (version[2] << 16) |
+                    (static_cast<uint32_t>(version[3]) << 24);
+  if (number != 1 && number != TraceWriter::VERSION) {
+    throw std::runtime_error("Unsupported trace version " +
+                             std::to_string(number) + ": " + filename);
+  }
+
+  // Version 1 files are always uncompressed
+  int compression = number == 1 ? UNCOMPRESSED : file.get();
+  if (compression == ZLIB) {
+#ifdef RV32SIM_HAVE_ZLIB
+    p_inflater = std::make_shared<TraceInflater>(file, filename);
+#else
+    throw std::runtime_error(
+        "Compressed trace file, and rv32sim was built without zlib: " +
+        filename);
+#endif
+  } else if (compression != UNCOMPRESSED) {
+    throw std::runtime_error("Not a trace file: " + filename);
+  }
+}
+
+int TraceReader::readByte() {
+  return p_inflater ? p_inflater->get() : file.get();
+}
+
+uint32_t TraceReader::readVarint() {
+  uint32_t value = 0;
+  for (unsigned int shift = 0; shift < 35; shift += 7) {
+    int byte = readByte();
+    if (byte == EOF) {
+      throw std::runtime_error("Truncated trace file: " + filename);
+    }
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Corrupt trace file: " + filename);
+}
+
+bool TraceReader::next(TraceRecord &record) {
+  int header = readByte();
+  if (header == EOF) {
+    return false;
+  }
+
+  TraceCodec &codec = *p_codec;
+  record = TraceRecord();
+  record.pc = codec.next_pc;
+  if (header & HAS_PC) {
+    record.pc += unzigzag(readVarint());
+  }
+  if (header & HAS_RAW) {
+    record.raw = 0;
+    for (unsigned int i = 0; i < 4; i++) {
+      int byte = readByte();
+      if (byte == EOF) {
+        throw std::runtime_error("Truncated trace file: " + filename);
+      }
+      record.raw |= static_cast<uint32_t>(byte) << (i * 8);
+    }
+  } else {
+    record.raw = codec.rawEntry(record.pc).raw;
+  }
+  if (header & HAS_RD) {
+    int rd = readByte();
+    if (rd == EOF || rd == 0 || rd >= 32) {
+      throw std::runtime_error("Corrupt trace file: " + filename);
+    }
+    record.rd = static_cast<uint8_t>(rd);
+    record.rd_value = codec.registers[rd] + unzigzag(readVarint());
+  }
+  if (header & HAS_MEM) {
+    record.mem_size = 1u << ((header >> SIZE_SHIFT) & 3);
+    record.is_store = (header & IS_STORE) != 0;
+    record.mem_address = codec.mem_address + unzigzag(readVarint());
+    record.mem_value = readVarint();
+  }
+
+  codec.update(record);
+  return true;
+}
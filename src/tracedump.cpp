@@ -0,0 +1,90 @@
+#include "decoder.h"
+#include "elffile.h"
+#include "imagecache.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Prints a trace written by rv32sim --trace as text, one retired instruction
+// per line:
+//   PC  INSTRUCTION  DISASSEMBLY  [xN = VALUE]  [MEM[ADDRESS] -> VALUE]
+// Given the ELF file the trace was taken from, each change of symbol is
+// marked with a <symbol+offset> line.
+
+namespace {
+
+void printSymbol(const ElfFile &elf, uint32_t pc, const ElfSymbol *&p_last,
+                 std::ostream &out) {
+  const ElfSymbol *p_symbol = elf.symbolAt(pc);
+  if (p_symbol == nullptr || p_symbol == p_last) {
+    return;
+  }
+  p_last = p_symbol;
+  out << "<" << p_symbol->name;
+  if (pc != p_symbol->address) {
+    out << "+0x" << std::hex << pc - p_symbol->address << std::dec;
+  }
+  out << ">:\n";
+}
+
+void printRecord(const TraceRecord &record, std::ostream &out) {
+  out << std::hex << std::setfill('0') << std::setw(8) << record.pc << "  "
+      << std::setw(8) << record.raw << "  ";
+  std::string assembly = RISC::disassemble(record.raw, record.pc);
+  if (record.rd != 0 || record.mem_size != 0) {
+    // Line up what the instruction wrote
+    assembly.resize(std::max<size_t>(assembly.size(), 28), ' ');
+  }
+  out << assembly;
+  if (record.rd != 0) {
+    out << "  x" << std::dec << static_cast<unsigned int>(record.rd)
+        << std::hex << " = " << std::setw(8) << record.rd_value;
+  }
+  if (record.mem_size != 0) {
+    out << "  mem" << std::dec << record.mem_size * 8 << std::hex << "["
+        << std::setw(8) << record.mem_address << "] "
+        << (record.is_store ? "<- " : "-> ") << std::setw(record.mem_size * 2)
+        << record.mem_value;
+  }
+  out << "\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2 && argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <trace_file> [elf_file]"
+              << std::endl;
+    return 1;
+  }
+
+  try {
+    std::unique_ptr<ElfFile> p_elf;
+    if (argc == 3) {
+      std::shared_ptr<const MappedFile> p_image =
+          ImageCache::instance().open(argv[2]);
+      if (!p_image->isOpen()) {
+        throw std::runtime_error(std::string("Could not open file: ") +
+                                 argv[2]);
+      }
+      p_elf.reset(new ElfFile(argv[2], p_image));
+    }
+
+    TraceReader reader(argv[1]);
+    TraceRecord record;
+    const ElfSymbol *p_last = nullptr;
+    while (reader.next(record)) {
+      if (p_elf) {
+        printSymbol(*p_elf, record.pc, p_last, std::cout);
+      }
+      printRecord(record, std::cout);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}